@@ -0,0 +1,426 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Frame path benchmark.
+ *
+ * Drives Interface::newFrameReady with synthetic readouts, as the
+ * readout dispatcher does, over a grid of frame sizes, frames per
+ * readout and readouts per callback. The camera is configured and
+ * prepared but never started. Each grid point is reported as one JSON
+ * line: sustained frames/s, GB/s, callback latency percentiles and the
+ * process CPU time per frame (copy workers included).
+ *
+ * The readouts come from a ring bigger than the caches, their pixels
+ * are a test pattern and their metadata (time stamps, frame tracking)
+ * are zero, which the plugin reads as no frame lost.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PrincetonInterface.h"
+#include "PrincetonBufferCtrlObj.h"
+#include "lima/HwDetInfoCtrlObj.h"
+#include "lima/HwRoiCtrlObj.h"
+#include "lima/HwSyncCtrlObj.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+#ifndef PRINCETON_VERSION
+#define PRINCETON_VERSION "unknown"
+#endif
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  struct Options
+  {
+    Options() :
+      rows({64,256,1024}),
+      frames_per_readout({1,4}),
+      readouts_per_callback({1,4,16}),
+      nb_frames(2000),
+      copy_threads(2),
+      ring_mb(256),
+      min_fps(0.),
+      max_p99_us(0.)
+    {}
+
+    std::string		serial;
+    std::vector<int>	rows;
+    std::vector<int>	frames_per_readout;
+    std::vector<int>	readouts_per_callback;
+    int			nb_frames;
+    int			copy_threads;
+    long		ring_mb;
+    double		min_fps;	// regression targets, 0 not checked
+    double		max_p99_us;
+    std::string		output;
+  };
+
+  struct Result
+  {
+    int		width;
+    int		height;
+    int		frame_size;
+    int		frames_per_readout;
+    int		readouts_per_callback;
+    long long	nb_frames;
+    double	frames_per_s;
+    double	gb_per_s;
+    double	latency_p50_us;
+    double	latency_p99_us;
+    double	latency_max_us;
+    double	cpu_us_per_frame;
+    bool	pass;
+  };
+
+  class FrameSink : public HwFrameCallback
+  {
+  public:
+    FrameSink() : nb_frames(0) {}
+    virtual bool newFrameReady(const HwFrameInfoType&)
+    {
+      ++nb_frames;
+      return true;
+    }
+    long long nb_frames;
+  };
+
+  /** @brief page aligned, like a PICam acquisition buffer
+   */
+  class Ring
+  {
+  public:
+    Ring(long long nb_readouts,int readout_stride) :
+      m_memory(size_t(nb_readouts) * readout_stride + 4096),
+      m_nb_readouts(nb_readouts),
+      m_readout_stride(readout_stride)
+    {
+      uintptr_t address = reinterpret_cast<uintptr_t>(m_memory.data());
+      m_data = m_memory.data() + ((4096 - address % 4096) % 4096);
+    }
+
+    void fill(int frame_size,int frame_stride,int frames_per_readout)
+    {
+      for(long long r = 0;r < m_nb_readouts;++r)
+	for(int f = 0;f < frames_per_readout;++f)
+	  {
+	    char* frame = readout(r) + f * frame_stride;
+	    unsigned short* pixels = reinterpret_cast<unsigned short*>(frame);
+	    for(int i = 0;i < frame_size / 2;++i)
+	      pixels[i] = (unsigned short)(100 + i % 4000);
+	  }
+    }
+
+    char* readout(long long nb) {return m_data + nb * m_readout_stride;}
+    long long nbReadouts() const {return m_nb_readouts;}
+  private:
+    std::vector<char>	m_memory;
+    char*		m_data;
+    long long		m_nb_readouts;
+    int			m_readout_stride;
+  };
+
+  double cpu_time()
+  {
+#ifdef _WIN32
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+  }
+
+  double percentile(std::vector<double>& values,double p)
+  {
+    if(values.empty())
+      return 0.;
+    size_t n = std::min(size_t(p * values.size()),values.size() - 1);
+    std::nth_element(values.begin(),values.begin() + n,values.end());
+    return values[n];
+  }
+
+  std::vector<int> parse_list(const std::string& arg)
+  {
+    std::vector<int> values;
+    std::istringstream is(arg);
+    std::string item;
+    while(std::getline(is,item,','))
+      values.push_back(atoi(item.c_str()));
+    return values;
+  }
+
+  void usage(const char* name)
+  {
+    std::cerr << "usage: " << name << " [options]\n"
+	      << "  --serial S          camera serial number (first camera)\n"
+	      << "  --rows R1,R2,...    full width frame heights (64,256,1024)\n"
+	      << "  --fpr F1,F2,...     frames per readout, more than 1 uses\n"
+	      << "                      kinetics windows of sensor height / F (1,4)\n"
+	      << "  --rpc N1,N2,...     readouts per callback (1,4,16)\n"
+	      << "  --frames N          frames per grid point (2000)\n"
+	      << "  --copy-threads N    frame copy workers (2)\n"
+	      << "  --ring-mb N         synthetic readout ring size (256)\n"
+	      << "  --min-fps X         fail if a point is slower\n"
+	      << "  --max-p99-us X      fail if a point has a longer p99 latency\n"
+	      << "  --output FILE       JSON lines output (stdout)\n";
+  }
+
+  bool parse_options(int argc,char* argv[],Options& options)
+  {
+    for(int i = 1;i < argc;++i)
+      {
+	std::string arg = argv[i];
+	if(arg == "-h" || arg == "--help" || i + 1 >= argc)
+	  return false;
+	std::string value = argv[++i];
+	if(arg == "--serial") options.serial = value;
+	else if(arg == "--rows") options.rows = parse_list(value);
+	else if(arg == "--fpr") options.frames_per_readout = parse_list(value);
+	else if(arg == "--rpc") options.readouts_per_callback = parse_list(value);
+	else if(arg == "--frames") options.nb_frames = atoi(value.c_str());
+	else if(arg == "--copy-threads") options.copy_threads = atoi(value.c_str());
+	else if(arg == "--ring-mb") options.ring_mb = atol(value.c_str());
+	else if(arg == "--min-fps") options.min_fps = atof(value.c_str());
+	else if(arg == "--max-p99-us") options.max_p99_us = atof(value.c_str());
+	else if(arg == "--output") options.output = value;
+	else
+	  return false;
+      }
+    return options.nb_frames > 0 && options.ring_mb > 0;
+  }
+
+  /** @brief full width frames of rows, or kinetics windows when
+   *  several frames per readout. Return false if not possible.
+   */
+  bool configure(Interface& hw,int rows,int frames_per_readout,FrameDim& frame_dim)
+  {
+    HwDetInfoCtrlObj* det_info;
+    HwRoiCtrlObj* roi_ctrl;
+    hw.getHwCtrlObj(det_info);
+    hw.getHwCtrlObj(roi_ctrl);
+
+    Size sensor;
+    det_info->getDetectorImageSize(sensor);
+    hw.setReadoutMode(Interface::FullFrame);
+    Size size;
+    if(frames_per_readout > 1)
+      {
+	int window = sensor.getHeight() / frames_per_readout;
+	if(window < 1)
+	  return false;
+	hw.setKineticsWindowHeight(window);
+	hw.setReadoutMode(Interface::Kinetics);
+	det_info->getMaxImageSize(size);
+      }
+    else
+      {
+	if(rows < 1 || rows > sensor.getHeight())
+	  return false;
+	Roi roi(0,0,sensor.getWidth(),rows),hw_roi;
+	roi_ctrl->checkRoi(roi,hw_roi);
+	roi_ctrl->setRoi(hw_roi);
+	size = hw_roi.getSize();
+      }
+    ImageType image_type;
+    det_info->getCurrImageType(image_type);
+    frame_dim = FrameDim(size,image_type);
+    return true;
+  }
+
+  Result run(Interface& hw,const Options& options,const FrameDim& frame_dim,
+	     int readouts_per_callback)
+  {
+    HwBufferCtrlObj* buffer_ctrl;
+    HwSyncCtrlObj* sync;
+    hw.getHwCtrlObj(buffer_ctrl);
+    hw.getHwCtrlObj(sync);
+
+    // Lima buffers as CtControl would set them
+    long ring_bytes = options.ring_mb << 20;
+    int max_nb_buffers;
+    buffer_ctrl->setFrameDim(frame_dim);
+    buffer_ctrl->setNbConcatFrames(1);
+    buffer_ctrl->getMaxNbBuffers(max_nb_buffers);
+    int nb_buffers = int(std::max(ring_bytes / frame_dim.getMemSize(),64L));
+    buffer_ctrl->setNbBuffers(std::min(nb_buffers,max_nb_buffers));
+    FrameSink sink;
+    buffer_ctrl->registerFrameCallback(sink);
+
+    sync->setTrigMode(IntTrig);
+    sync->setNbHwFrames(options.nb_frames);
+    hw.prepareAcq();
+
+    Result result;
+    int frame_stride,readout_stride;
+    hw.getReadoutGeometry(result.frame_size,frame_stride,
+			  result.frames_per_readout,readout_stride);
+    result.width = frame_dim.getSize().getWidth();
+    result.height = frame_dim.getSize().getHeight();
+    result.readouts_per_callback = readouts_per_callback;
+
+    long long nb_readouts = (options.nb_frames + result.frames_per_readout - 1) /
+      result.frames_per_readout;
+    Ring ring(std::max(ring_bytes / readout_stride,2L * readouts_per_callback),
+	      readout_stride);
+    ring.fill(result.frame_size,frame_stride,result.frames_per_readout);
+
+    std::vector<double> latencies;
+    latencies.reserve(size_t(nb_readouts / readouts_per_callback + 1));
+    PicamAcquisitionStatus running = {true,PicamAcquisitionErrorsMask_None,0.};
+    BufferCtrlObj* princeton_buffer = dynamic_cast<BufferCtrlObj*>(buffer_ctrl);
+    if(princeton_buffer)
+      princeton_buffer->getBuffer().setStartTimestamp(Timestamp::now());
+
+    double cpu_start = cpu_time();
+    Clock::time_point start = Clock::now();
+    for(long long done = 0,pos = 0;done < nb_readouts;)
+      {
+	long long nb = std::min<long long>(readouts_per_callback,nb_readouts - done);
+	nb = std::min(nb,ring.nbReadouts() - pos);
+	PicamAvailableData available = {ring.readout(pos),nb};
+	Clock::time_point call_start = Clock::now();
+	hw.newFrameReady(&available,&running);
+	latencies.push_back(std::chrono::duration<double,std::micro>
+			    (Clock::now() - call_start).count());
+	done += nb;
+	pos = (pos + nb) % ring.nbReadouts();
+      }
+    PicamAcquisitionStatus stopped = {false,PicamAcquisitionErrorsMask_None,0.};
+    hw.newFrameReady(NULL,&stopped);
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = cpu_time() - cpu_start;
+    buffer_ctrl->unregisterFrameCallback(sink);
+
+    result.nb_frames = sink.nb_frames;
+    result.frames_per_s = result.nb_frames / elapsed;
+    result.gb_per_s = result.frames_per_s * result.frame_size / 1e9;
+    result.latency_p50_us = percentile(latencies,0.50);
+    result.latency_p99_us = percentile(latencies,0.99);
+    result.latency_max_us = latencies.empty() ? 0. :
+      *std::max_element(latencies.begin(),latencies.end());
+    result.cpu_us_per_frame = result.nb_frames ? cpu / result.nb_frames * 1e6 : 0.;
+    result.pass = (result.nb_frames == options.nb_frames &&
+		   (options.min_fps <= 0. || result.frames_per_s >= options.min_fps) &&
+		   (options.max_p99_us <= 0. ||
+		    result.latency_p99_us <= options.max_p99_us));
+    return result;
+  }
+
+  void write(std::ostream& os,const Options& options,const Result& r)
+  {
+    os << "{\"benchmark\":\"princeton_frame_path\""
+       << ",\"version\":\"" << PRINCETON_VERSION << "\""
+       << ",\"copy_threads\":" << options.copy_threads
+       << ",\"width\":" << r.width
+       << ",\"height\":" << r.height
+       << ",\"frame_size\":" << r.frame_size
+       << ",\"frames_per_readout\":" << r.frames_per_readout
+       << ",\"readouts_per_callback\":" << r.readouts_per_callback
+       << ",\"frames\":" << r.nb_frames
+       << ",\"frames_per_s\":" << r.frames_per_s
+       << ",\"gb_per_s\":" << r.gb_per_s
+       << ",\"latency_p50_us\":" << r.latency_p50_us
+       << ",\"latency_p99_us\":" << r.latency_p99_us
+       << ",\"latency_max_us\":" << r.latency_max_us
+       << ",\"cpu_us_per_frame\":" << r.cpu_us_per_frame
+       << ",\"pass\":" << (r.pass ? "true" : "false")
+       << "}" << std::endl;
+  }
+}
+
+int main(int argc,char* argv[])
+{
+  Options options;
+  if(!parse_options(argc,argv,options))
+    {
+      usage(argv[0]);
+      return 2;
+    }
+
+  std::ofstream file;
+  if(!options.output.empty())
+    {
+      file.open(options.output.c_str());
+      if(!file)
+	{
+	  std::cerr << "Can't open " << options.output << std::endl;
+	  return 2;
+	}
+    }
+  std::ostream& os = options.output.empty() ? std::cout : file;
+
+  bool pass = true;
+  try
+    {
+      Interface hw(options.serial);
+      hw.setCopyThreads(options.copy_threads);
+      hw.setZeroCopy(false);
+      hw.setDataLossPolicy(Interface::RenumberFrames);
+
+      for(auto fpr : options.frames_per_readout)
+	{
+	  // kinetics frames are one window, the rows don't apply
+	  std::vector<int> rows = options.rows;
+	  if(fpr > 1)
+	    rows.assign(1,0);
+	  for(auto nb_rows : rows)
+	    {
+	      FrameDim frame_dim;
+	      if(!configure(hw,nb_rows,fpr,frame_dim))
+		{
+		  std::cerr << "Skipped rows=" << nb_rows << " fpr=" << fpr
+			    << ": not possible on this sensor" << std::endl;
+		  continue;
+		}
+	      for(auto rpc : options.readouts_per_callback)
+		{
+		  if(rpc < 1)
+		    continue;
+		  Result result = run(hw,options,frame_dim,rpc);
+		  write(os,options,result);
+		  pass = pass && result.pass;
+		}
+	    }
+	}
+    }
+  catch(Exception& e)
+    {
+      std::cerr << "Benchmark failed: " << e.getErrMsg() << std::endl;
+      return 2;
+    }
+  return pass ? 0 : 1;
+}
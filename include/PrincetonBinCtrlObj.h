@@ -32,21 +32,26 @@ namespace lima
 {
   namespace Princeton
   {
+    class RoiSolver;
+
     class PRINCETON_EXPORT BinCtrlObj: public HwBinCtrlObj
     {
       DEB_CLASS_NAMESPC(DebModCamera,"BinCtrlObj","Princeton");
     public:
-      BinCtrlObj(PicamHandle cam);
+      BinCtrlObj(PicamHandle cam,RoiSolver&);
       virtual ~BinCtrlObj();
 
       virtual void setBin(const Bin& bin);
       virtual void getBin(Bin& bin);
       virtual void checkBin(Bin& bin);
+
+      /// multi-track readout, no binning on top of tracks
+      void setTrackMode(bool flag) {m_track_mode = flag;}
     private:
       PicamHandle	m_cam;
       Bin		m_bin;
-      std::list<int>	m_possible_xbin;
-      std::list<int>	m_possible_ybin;
+      RoiSolver&	m_solver;
+      bool		m_track_mode;
     };
   }
 }
@@ -0,0 +1,155 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONBUFFERCTRLOBJ_H
+#define PRINCETONBUFFERCTRLOBJ_H
+
+#include <map>
+
+#include <picam.h>
+
+#include <princeton_export.h>
+
+#include "lima/HwBufferMgr.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    class AcqMemory;
+    struct AcqMemoryOptions;
+
+    /** Allocate all Lima frame buffers in one contiguous block.
+     *	Buffers are spaced by a frame stride which may be bigger than
+     *	the frame size, so the block can be given as is to PICam as
+     *	its circular acquisition buffer (one readout per Lima buffer).
+     */
+    class ContiguousBufferAllocMgr : public BufferAllocMgr
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"ContiguousBufferAllocMgr","Princeton");
+    public:
+      ContiguousBufferAllocMgr();
+      virtual ~ContiguousBufferAllocMgr();
+
+      virtual int getMaxNbBuffers(const FrameDim& frame_dim);
+      virtual void allocBuffers(int nb_buffers,const FrameDim& frame_dim);
+      virtual const FrameDim& getFrameDim();
+      virtual void getNbBuffers(int& nb_buffers);
+      virtual void releaseBuffers();
+      virtual void* getBufferPtr(int buffer_nb);
+
+      void setFrameStride(long frame_stride);
+      long getFrameStride() const;
+      void setAllocOptions(const AcqMemoryOptions& options);
+      void* getMemory() const;
+      long getMemorySize() const {return m_frame_stride * m_nb_buffers;}
+    private:
+      long _getFrameStride(const FrameDim& frame_dim) const;
+
+      FrameDim		m_frame_dim;
+      int		m_nb_buffers;
+      long		m_requested_stride;
+      long		m_frame_stride;
+      AcqMemory*	m_memory;
+      AcqMemoryOptions*	m_options;
+    };
+
+    /** Lima frame buffers held by Lima (mapped for processing or
+     *	saving) until it releases them. In zero copy PICam writes in
+     *	these buffers, one still held is overwritten by an overrun.
+     */
+    class BufferReleaseTracker : public HwBufferCtrlObj::Callback
+    {
+    public:
+      virtual void map(void* address);
+      virtual void release(void* address);
+      virtual void releaseAll();
+
+      bool isMapped(void* address) const;
+    private:
+      std::map<void*,int>	m_mapped; // address, reference count
+      mutable Mutex		m_lock;
+    };
+
+    /** Lima buffer control which keeps its frames in a
+     *	ContiguousBufferAllocMgr.
+     *	When zero copy is enabled, buffers are allocated with the camera
+     *	readout stride so that PICam can write readouts in place.
+     */
+    class PRINCETON_EXPORT BufferCtrlObj : public HwBufferCtrlObj
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"BufferCtrlObj","Princeton");
+    public:
+      BufferCtrlObj(PicamHandle cam);
+      virtual ~BufferCtrlObj();
+
+      virtual void setFrameDim(const FrameDim& frame_dim);
+      virtual void getFrameDim(FrameDim& frame_dim);
+
+      virtual void setNbBuffers(int nb_buffers);
+      virtual void getNbBuffers(int& nb_buffers);
+
+      virtual void setNbConcatFrames(int nb_concat_frames);
+      virtual void getNbConcatFrames(int& nb_concat_frames);
+
+      virtual void getMaxNbBuffers(int& max_nb_buffers);
+
+      virtual void *getBufferPtr(int buffer_nb,int concat_frame_nb = 0);
+      virtual void *getFramePtr(int acq_frame_nb);
+
+      virtual void getStartTimestamp(Timestamp& start_ts);
+      virtual void getFrameInfo(int acq_frame_nb,HwFrameInfoType& info);
+
+      virtual void registerFrameCallback(HwFrameCallback& frame_cb);
+      virtual void unregisterFrameCallback(HwFrameCallback& frame_cb);
+
+      virtual Callback* getBufferCallback();
+
+      StdBufferCbMgr& getBuffer() {return m_cb_mgr;}
+
+      void setZeroCopy(bool flag);
+      bool getZeroCopy() const {return m_zero_copy;}
+      /** return true if PICam can use the Lima buffers for
+       *	a readout of readout_stride bytes.
+       */
+      bool canUseInPlace(long readout_stride,int frames_per_readout);
+      void getAcquisitionBuffer(void*& memory,long& memory_size) const;
+      void setAllocOptions(const AcqMemoryOptions& options);
+      /** return true if Lima still holds the buffer of a frame
+       */
+      bool isFrameHeld(void* frame) const {return m_release_tracker.isMapped(frame);}
+    private:
+      void _updateFrameStride();
+
+      PicamHandle		m_cam;
+      bool			m_zero_copy;
+      ContiguousBufferAllocMgr	m_alloc_mgr;
+      StdBufferCbMgr		m_cb_mgr;
+      BufferCtrlMgr		m_mgr;
+      BufferReleaseTracker	m_release_tracker;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONBUFFERCTRLOBJ_H
@@ -32,11 +32,13 @@ namespace lima
 {
   namespace Princeton
   {
+    class ParameterCache;
+
     class PRINCETON_EXPORT DetInfoCtrlObj : public HwDetInfoCtrlObj
     {
       DEB_CLASS_NAMESPC(DebModCamera, "DetInfoCtrlObj", "Princeton");
     public:
-      DetInfoCtrlObj(PicamHandle cam);
+      DetInfoCtrlObj(PicamHandle cam,ParameterCache&);
       virtual ~DetInfoCtrlObj();
 
       virtual void getMaxImageSize(Size& max_image_size);
@@ -52,11 +54,21 @@ namespace lima
 
       virtual void registerMaxImageSizeCallback(HwMaxImageSizeCallback& cb);
       virtual void unregisterMaxImageSizeCallback(HwMaxImageSizeCallback& cb);
+
+      /// readout image size when it's not the sensor (multi-track),
+      /// empty size to go back to the sensor size
+      void setReadoutImageSize(const Size& size);
+      /// image type of the frames given to Lima, Bpp32 when they're
+      /// sums done by the plugin
+      void setReadoutImageType(ImageType image_type);
     private:
       PicamHandle 		m_cam;
+      ParameterCache&		m_parameters;
       HwMaxImageSizeCallbackGen m_mis_cb_gen;
       int 			m_max_columns;
       int 			m_max_rows;
+      Size			m_readout_size;
+      ImageType			m_image_type;
     };
   }
 }
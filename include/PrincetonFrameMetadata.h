@@ -0,0 +1,58 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONFRAMEMETADATA_H
+#define PRINCETONFRAMEMETADATA_H
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Metadata PICam appends to each frame.
+     *	Times are in seconds from the acquisition start (camera clock),
+     *	tracking values are raw counters. Missing values are set to -1.
+     */
+    struct FrameMetadata
+    {
+      FrameMetadata() :
+	exposure_started(-1.),
+	exposure_ended(-1.),
+	frame_tracking(-1),
+	gate_delay(-1),
+	gate_width(-1),
+	host_timestamp(-1.),
+	lost(false)
+      {}
+
+      double	exposure_started;
+      double	exposure_ended;
+      long long	frame_tracking;
+      long long	gate_delay;
+      long long	gate_width;
+      double	host_timestamp;	// frame handled by the plugin, host clock
+      bool	lost;		// blank frame inserted for a lost one
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONFRAMEMETADATA_H
@@ -25,12 +25,17 @@
 #define PRINCETONINTERFACE_H
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <thread>
 
 #include <picam.h>
 #include <picam_advanced.h>
 
 #include <princeton_export.h>
 #include "lima/HwInterface.h"
+#include "PrincetonFrameMetadata.h"
 
 namespace lima
 {
@@ -40,7 +45,24 @@ namespace lima
     class SyncCtrlObj;
     class BinCtrlObj;
     class RoiCtrlObj;
+    class RoiSolver;
     class ShutterCtrlObj;
+    class BufferCtrlObj;
+    class ReadoutQueue;
+    class FrameCopyPool;
+    class BufferSizingPolicy;
+    class AcqBufferPool;
+    struct AcqMemoryOptions;
+    class MetadataParser;
+    class ParameterCache;
+    class Profile;
+    class ReadoutSpeed;
+    class TimingChecker;
+    class FrameProcessor;
+    class SpectrumExtractor;
+    class FrameAccumulator;
+    class FrameCorrection;
+    class LatencyHistogram;
     
     struct Process
     {
@@ -52,12 +74,37 @@ namespace lima
 					  const PicamAvailableData* available,
 					  const PicamAcquisitionStatus* status);
 
+    /** Called from the readout dispatch thread when frames are lost.
+     *	frame_nb is the Lima number of the first gap frame, or of the
+     *	frame following the loss when frames are renumbered.
+     *	nb_frames is -1 when the camera has no frame tracking.
+     */
+    class PRINCETON_EXPORT DataLossCallback
+    {
+    public:
+      virtual ~DataLossCallback() {}
+      virtual void dataLost(int frame_nb,long long nb_frames) = 0;
+    };
+
     class PRINCETON_EXPORT Interface : public HwInterface
     {
       DEB_CLASS_NAMESPC(DebModCamera, "PrincetonInterface", "Princeton");
     
     public:
       enum Status {Ready, Running, Fault};
+      enum HugePages {NoHugePages, HugePages2MB, HugePages1GB};
+      enum TrackLayout {StackedTracks, SpectrumPerTrack};
+      enum DataLossPolicy {FaultOnDataLoss, RenumberFrames, InsertGapFrames};
+      enum ReadoutMode {FullFrame, FrameTransfer, Kinetics, SpectraKinetics};
+      enum AdcQuality {LowNoise = PicamAdcQuality_LowNoise,
+		       HighCapacity = PicamAdcQuality_HighCapacity,
+		       HighSpeed = PicamAdcQuality_HighSpeed,
+		       ElectronMultiplied = PicamAdcQuality_ElectronMultiplied};
+      enum AdcAnalogGain {LowGain = PicamAdcAnalogGain_Low,
+			  MediumGain = PicamAdcAnalogGain_Medium,
+			  HighGain = PicamAdcAnalogGain_High};
+      enum LatencyStage {DeliveryLatency, CopyLatency, NotifyLatency,
+			 TotalLatency};
 
       Interface(const std::string& camera_serial = "");
       virtual ~Interface();
@@ -71,33 +118,298 @@ namespace lima
       virtual int       getNbHwAcquiredFrames();
 
 
+      //- Cached PICam parameters (control object getters)
+      void getParameterCacheHits(long long& nb_hits) const;
+      void getParameterCacheMisses(long long& nb_misses) const;
+      void resetParameterCacheCounters();
+
+      //- Parameter transaction: sets are staged until one validated commit
+      void beginParameterTransaction();
+      void commitParameterTransaction();
+      void getParameterTransaction(bool& flag) const;
+      void getCommitErrors(std::vector<std::string>& errors) const;
+      void getCommitTime(double& last_time,double& mean_time,
+			 double& max_time) const;
+      void getNbCommits(int& nb_commits) const;
+
+      //- Named profiles of the camera parameters and buffer allocation
+      void saveProfile(const std::string& name);
+      void activateProfile(const std::string& name);
+      void deleteProfile(const std::string& name);
+      void getProfileList(std::vector<std::string>& names) const;
+      void writeProfile(const std::string& name,const std::string& filename);
+      void readProfile(const std::string& name,const std::string& filename);
+
+      //- Frame metadata (time stamps, tracking) of the recent frames
+      void getFrameMetadata(int frame_nb,FrameMetadata& metadata) const;
+
+      //- Data loss: fault (default) or keep acquiring, lost frames
+      //- are skipped (renumbered) or replaced by blank gap frames
+      void setDataLossPolicy(DataLossPolicy policy);
+      void getDataLossPolicy(DataLossPolicy& policy) const;
+      void getNbLostFrames(long long& nb_frames) const;
+      void getNbDataLossEvents(int& nb_events) const;
+      void registerDataLossCallback(DataLossCallback& cb);
+      void unregisterDataLossCallback(DataLossCallback& cb);
+
+      //- Readout mode, kinetics packs several frames in each readout
+      void setReadoutMode(ReadoutMode mode);
+      void getReadoutMode(ReadoutMode& mode) const;
+      void setKineticsWindowHeight(int height);
+      void getKineticsWindowHeight(int& height) const;
+
+      //- Readout timing calculated by PICam: per frame readout time (s),
+      //- frame rate (frames/s) and host bandwidth (bytes/s), of the
+      //- current parameters or of a profile
+      void getPredictedTiming(double& readout_time,double& frame_rate,
+			      double& bandwidth);
+      void predictProfileTiming(const std::string& name,double& readout_time,
+				double& frame_rate,double& bandwidth);
+      //- Pre-flight check, also done by prepareAcq
+      void checkAcquisition();
+      void getPreflightWarnings(std::vector<std::string>& warnings) const;
+
+      //- ADC and readout ports, lists are the values the camera supports
+      void setAdcSpeed(double speed);	// MHz
+      void getAdcSpeed(double& speed) const;
+      void getAdcSpeedList(std::vector<double>& speeds) const;
+      void setAdcQuality(AdcQuality quality);
+      void getAdcQuality(AdcQuality& quality) const;
+      void getAdcQualityList(std::vector<int>& qualities) const;
+      void setAdcAnalogGain(AdcAnalogGain gain);
+      void getAdcAnalogGain(AdcAnalogGain& gain) const;
+      void getAdcAnalogGainList(std::vector<int>& gains) const;
+      void setReadoutPortCount(int nb_ports);
+      void getReadoutPortCount(int& nb_ports) const;
+      void getReadoutPortCountList(std::vector<int>& nb_ports) const;
+      //- fastest ADC/port combination, low_noise keeps the LowNoise
+      //- quality, max_adc_speed 0 means no limit
+      void selectFastestReadout(bool low_noise,double max_adc_speed = 0.);
+      //- least noisy combination which reaches frame_rate
+      void selectReadoutForFrameRate(double frame_rate,bool low_noise = false);
+
+      //- Multi-track readout, tracks are (y,height) pairs
+      void setTracks(const std::vector<int>& tracks);
+      void getTracks(std::vector<int>& tracks) const;
+      void setTrackLayout(TrackLayout layout);
+      void getTrackLayout(TrackLayout& layout) const;
+
+      //- Host full vertical binning, ranges are (y,height) pairs of
+      //- sensor rows summed in 32 bits spectra (one per Lima row)
+      void setSpectrumRanges(const std::vector<int>& ranges);
+      void getSpectrumRanges(std::vector<int>& ranges) const;
+
+      //- Accumulation: nb_frames hardware frames summed in one 32 bits
+      //- Lima frame, 1 to disable. Pixels reaching the saturation level
+      //- (0 no masking) in one of the frames are 0xffffffff in the sum.
+      void setAccumulation(int nb_frames);
+      void getAccumulation(int& nb_frames) const;
+      void setAccumulationSaturation(int level);
+      void getAccumulationSaturation(int& level) const;
+
+      //- Correction in the frame copy: dark subtraction, flat-field gain
+      //- and bad pixel replacement. References are readout frames, bad
+      //- pixels are pixel indexes in the readout frame.
+      void setCorrection(bool flag);
+      void getCorrection(bool& flag) const;
+      void setDarkFrame(const std::vector<int>& dark);
+      void getDarkFrame(std::vector<int>& dark) const;
+      void setFlatField(const std::vector<double>& gain);
+      void getFlatField(std::vector<double>& gain) const;
+      void setBadPixels(const std::vector<int>& pixels);
+      void getBadPixels(std::vector<int>& pixels) const;
+      //- dark frame as the mean of nb_frames taken with the shutter closed
+      void captureDark(int nb_frames);
+
+      //- Zero copy: PICam writes readouts directly into Lima buffers
+      void setZeroCopy(bool flag);
+      void getZeroCopy(bool& flag) const;
+
+      //- Frame copy worker pool
+      void setCopyThreads(int nb_threads);
+      void getCopyThreads(int& nb_threads) const;
+      void setCopyCpuList(const std::vector<int>& cpus);
+      void getCopyCpuList(std::vector<int>& cpus) const;
+
+      //- PICam acquisition buffer sizing
+      void setBufferTargetTime(double target_time);
+      void getBufferTargetTime(double& target_time) const;
+      void setBufferMemoryCap(long long memory_cap);
+      void getBufferMemoryCap(long long& memory_cap) const;
+      void setBufferAutoGrow(bool flag);
+      void getBufferAutoGrow(bool& flag) const;
+      void getBufferReadouts(long long& nb_readouts) const;
+      void getBufferOccupancy(double& occupancy) const;
+      void getBufferPeakOccupancy(double& occupancy) const;
+      void getBufferOverruns(long long& nb_overruns) const;
+      void getBufferRecommendedReadouts(long long& nb_readouts) const;
+
+      //- Acquisition buffer allocation
+      void setBufferHugePages(HugePages huge_pages);
+      void getBufferHugePages(HugePages& huge_pages) const;
+      void setBufferLocked(bool flag);
+      void getBufferLocked(bool& flag) const;
+      void setBufferPrefault(bool flag);
+      void getBufferPrefault(bool& flag) const;
+      void setBufferNumaNode(int numa_node);
+      void getBufferNumaNode(int& numa_node) const;
+      void setBufferNumaNodeFromCpu(int cpu);
+      void setBufferNumaNodeFromDevice(const std::string& sysfs_path);
+      void setBufferPoolMaxMemory(long long max_memory);
+      void getBufferPoolMaxMemory(long long& max_memory) const;
+      void getBufferPoolMemory(long long& memory) const;
+      void getBufferPoolNbBuffers(int& nb_buffers) const;
+
+      //- Readout queue between PICam callback and Lima dispatch
+      void getReadoutQueueDepth(int& depth) const;
+      void getReadoutQueueHighWaterMark(int& high_water_mark) const;
+      //- Readout layout (bytes) of the last prepareAcq
+      void getReadoutGeometry(int& frame_size,int& frame_stride,
+			      int& frames_per_readout,int& readout_stride) const;
+
+      //- Acquisition path latencies (s): PICam callback to dispatch and
+      //- whole path per readout callback, frame copy and Lima
+      //- notification per copy batch. Kept until reset.
+      void getLatencyStats(LatencyStage stage,long long& count,double& mean,
+			   double& p50,double& p99,double& max) const;
+      void getLatencyHistogram(LatencyStage stage,std::vector<double>& upper_bounds,
+			       std::vector<int>& counts) const;
+      void resetLatencyStats();
+
+      //- Performance counters, sampled by the acquisition threads so
+      //- reading them never calls PICam: frames given to Lima, their
+      //- rate (frames/s), readout time predicted by the last pre-flight
+      //- check (s) and sensor temperature (C, NaN if not available)
+      //- read when the camera is opened, at prepareAcq and at the end
+      //- of the acquisition
+      void getNbAcquiredFrames(long long& nb_frames) const;
+      void getAchievedFrameRate(double& frame_rate) const;
+      void getAcqReadoutTime(double& readout_time) const;
+      void getSensorTemperature(double& temperature) const;
+
+      //- Acquisition stop: maximum wait of the acquisition end (s) and
+      //- time from the stop request to Ready of the last stop (s)
+      void setStopTimeout(double timeout);
+      void getStopTimeout(double& timeout) const;
+      void getLastStopTime(double& stop_time) const;
+
+      void readoutAvailable(const PicamAvailableData* available,
+			    const PicamAcquisitionStatus* status);
       void newFrameReady(const PicamAvailableData* available,
 			 const PicamAcquisitionStatus* status);
     private:
+      void _release(bool callback_registered);
+      void _setupMetadata();
+      void _sampleSensorTemperature();
+      void _stopAcquisition();
+      void _requestStop();
+      void _controlLoop();
+      void _updateReadoutWindow();
+      void _stageProfile(const Profile&);
+      void _setupFrameProcessing();
+      void _dispatchReadouts();
+      void _processFrames(const PicamAvailableData* available);
+      void _updateStatus(const PicamAcquisitionStatus* status,bool failed);
+      void _addFrame(void* src_framePt,const FrameMetadata&,int& first_frame_nb);
+      void _flushFrames(int first_frame_nb);
+      long long _checkFrameTracking(const FrameMetadata&);
+      void _dataLost(int frame_nb,long long nb_frames);
+
       void _freePixelBuffer();
+      void _setAcquisitionBuffer(void* memory,long memory_size);
+      void _setAllocOptions();
+      Profile& _getProfile(const std::string& name);
+      void _commitParameters(const std::vector<std::string>& errors =
+			     std::vector<std::string>());
 
-      bool			m_sdk_initialized;
-      const PicamCameraID*	m_available_camera;
-      piint			m_available_camera_number;
       PicamHandle		m_cam;
       DetInfoCtrlObj*		m_det_info;
       SyncCtrlObj*		m_sync;
       BinCtrlObj*		m_bin;
       RoiCtrlObj*		m_roi;
+      RoiSolver*		m_roi_solver;
+      ParameterCache*		m_parameters;
+      ReadoutSpeed*		m_readout_speed;
+      TimingChecker*		m_timing;
+      std::vector<std::string>	m_preflight_warnings;
       ShutterCtrlObj*           m_shutter;
+      BufferCtrlObj*		m_buffer_ctrl_obj;
       
-      SoftBufferCtrlObj		m_buffer_ctrl_obj;
       CapList			m_cap_list;
 
       std::string		m_cam_name;
       int			m_acq_frames;
+      int			m_nb_frames;
       Status			m_status;
       PicamAcquisitionBuffer	m_pixel_stream;	// double buffer
+      AcqBufferPool*		m_buffer_pool;
+      AcqMemoryOptions*		m_alloc_options;
+      PicamAcquisitionBuffer	m_acq_buffer;	// buffer given to PICam
+      bool			m_in_place;
+      TrackLayout		m_track_layout;
       piint			m_readout_stride;
       piint 			m_frames_per_readout;
       piint			m_frame_stride;
       piint 			m_frame_size;
       Cond			m_cond;
+      ReadoutQueue*		m_readout_queue;
+      FrameCopyPool*		m_frame_copy;
+      SpectrumExtractor*	m_spectrum;
+      const FrameProcessor*	m_frame_processor; // NULL for a plain copy
+      FrameAccumulator*		m_accumulator;
+      int			m_accumulation;
+      int			m_accumulation_saturation;
+      int			m_frame_in_sum;
+      FrameMetadata		m_sum_metadata;
+      FrameCorrection*		m_correction;
+      bool			m_correction_enabled;
+      int			m_dark_capture; // frames, 0 if not capturing
+      long			m_lima_frame_size;
+      BufferSizingPolicy*	m_buffer_policy;
+      long long			m_buffer_readouts;
+      std::atomic<long long>	m_pending_readouts;
+      std::atomic<long long>	m_peak_pending_readouts;
+      std::atomic<long long>	m_nb_buffer_overruns;
+      long long			m_dispatched_readouts;
+      double			m_dispatch_busy_time;
+      std::thread		m_dispatch_thread;
+      Cond			m_dispatch_cond;
+      std::atomic<bool>		m_dispatcher_waiting;
+      bool			m_quit_dispatcher;
+      LatencyHistogram*		m_latency; // one per LatencyStage
+      long long			m_batch_start; // ns
+      std::atomic<long long>	m_nb_acquired_frames;
+      std::atomic<long long>	m_rate_start; // ns, first frames notified
+      std::atomic<long long>	m_rate_start_frames;
+      std::atomic<long long>	m_rate_end; // ns, last frames notified
+      std::atomic<double>	m_acq_readout_time;
+      bool			m_has_sensor_temperature;
+      std::atomic<double>	m_sensor_temperature;
+      std::thread		m_control_thread;
+      Cond			m_control_cond;
+      std::atomic<bool>		m_stop_requested; // once per acquisition
+      bool			m_stop_pending;	// for the control thread
+      bool			m_quit_control;
+      double			m_stop_timeout;
+      std::atomic<long long>	m_stop_start; // ns, 0 if no stop
+      std::atomic<double>	m_last_stop_time;
+      MetadataParser*		m_metadata_parser;
+      std::vector<FrameMetadata> m_batch_metadata;
+      std::vector<FrameMetadata> m_metadata_history;
+      int			m_last_metadata_frame;
+      mutable Mutex		m_metadata_mutex;
+      DataLossPolicy		m_data_loss_policy;
+      DataLossCallback*		m_data_loss_cb;
+      Mutex			m_data_loss_mutex;
+      long long			m_next_frame_tracking;
+      std::atomic<long long>	m_nb_lost_frames;
+      std::atomic<int>		m_nb_data_loss_events;
+      std::vector<std::string>	m_commit_errors;
+      int			m_nb_commits;
+      double			m_last_commit_time;
+      double			m_total_commit_time;
+      double			m_max_commit_time;
+      std::map<std::string,Profile*> m_profiles;
     };
   
 } // namespace Princeton
@@ -24,6 +24,8 @@
 
 #include <princeton_export.h>
 
+#include <vector>
+
 #include "lima/HwRoiCtrlObj.h"
 #include "PrincetonDetInfoCtrlObj.h"
 #include "PrincetonBinCtrlObj.h"
@@ -33,23 +35,61 @@ namespace lima
 {
   namespace Princeton
   {
+    class RoiSolver;
+    class SyncCtrlObj;
+
     class PRINCETON_EXPORT RoiCtrlObj : public HwRoiCtrlObj
     {
       DEB_CLASS_NAMESPC(DebModCamera,"RoiCtrlObj","Princeton");
     public:
-      RoiCtrlObj(PicamHandle cam,BinCtrlObj&);
+      RoiCtrlObj(PicamHandle cam,DetInfoCtrlObj&,BinCtrlObj&,RoiSolver&,
+		 SyncCtrlObj&);
       virtual ~RoiCtrlObj();
 
       virtual void setRoi(const Roi& set_roi);
       virtual void getRoi(Roi& hw_roi);
       virtual void checkRoi(const Roi& set_roi, Roi& hw_roi);
+
+      /** Multi-track readout, tracks is a list of (y,height) pairs
+       *	on the full sensor width. Each track is fully binned
+       *	vertically (one spectrum per row) if full_vertical_binning,
+       *	otherwise all its rows are read and tracks are stacked.
+       *	An empty list goes back to a single roi.
+       */
+      void setTracks(const std::vector<int>& tracks,bool full_vertical_binning);
+      void getTracks(std::vector<int>& tracks) const {tracks = m_tracks;}
+
+      /** Kinetics readout, each frame is the top window_height rows
+       *	(binned in one row if spectra). 0 goes back to a single roi.
+       */
+      void setKineticsWindow(int window_height,bool spectra);
+
+      /** Host full vertical binning, ranges is a list of (y,height)
+       *	pairs summed in 32 bits spectra by the plugin. The sensor rows
+       *	from the first to the last range are read on the full width.
+       *	An empty list goes back to a single roi.
+       */
+      void setSpectrumRanges(const std::vector<int>& ranges);
+      void getSpectrumRanges(std::vector<int>& ranges) const {ranges = m_spectrum_ranges;}
+      /// first sensor row and number of rows of the readout
+      void getSpectrumRows(int& y,int& height) const;
     private:
+      void _writeTracks();
+      void _writeKineticsWindow();
+      void _writeSpectrumRows();
+      void _writeRois(const PicamRois&);
+
       PicamHandle	m_cam;
       Roi		m_roi;
-      piint		m_rows;
-      piint		m_columns;
-      PicamRoisConstraintRulesMask m_rules;
+      DetInfoCtrlObj&	m_det_info;
       BinCtrlObj&	m_bin;
+      RoiSolver&	m_solver;
+      SyncCtrlObj&	m_sync;
+      std::vector<int>	m_tracks;
+      bool		m_full_vertical_binning;
+      int		m_kinetics_window;
+      bool		m_spectra_kinetics;
+      std::vector<int>	m_spectrum_ranges;
     };
   } // namespace Princeton
 } // namespace lima
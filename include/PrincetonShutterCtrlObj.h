@@ -32,12 +32,14 @@ namespace lima
 {
   namespace Princeton
   {
+    class ParameterCache;
+
     class PRINCETON_EXPORT ShutterCtrlObj : public HwShutterCtrlObj
     {
       DEB_CLASS_NAMESPC(DebModCamera, "PrincetonShutter", "Princeton");
 
     public:
-      ShutterCtrlObj(PicamHandle cam);
+      ShutterCtrlObj(PicamHandle cam,ParameterCache&);
       virtual ~ShutterCtrlObj();
       
       virtual bool checkMode(ShutterMode shut_mode) const;
@@ -55,6 +57,7 @@ namespace lima
 
     private:
       PicamHandle m_cam;
+      ParameterCache& m_parameters;
     };
   }
 }
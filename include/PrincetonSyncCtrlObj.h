@@ -30,12 +30,14 @@ namespace lima
 {
   namespace Princeton
   {
+    class ParameterCache;
+
     class PRINCETON_EXPORT SyncCtrlObj : public HwSyncCtrlObj
     {
       friend class Interface;
       DEB_CLASS_NAMESPC(DebModCamera, "SyncCtrlObj", "Princeton");
     public:
-      SyncCtrlObj(PicamHandle cam);
+      SyncCtrlObj(PicamHandle cam,ParameterCache&);
       virtual ~SyncCtrlObj();
 
       virtual bool checkTrigMode(TrigMode trig_mode);
@@ -54,11 +56,27 @@ namespace lima
 
       virtual void getValidRanges(ValidRangesType& valid_ranges);
 
+      bool checkReadoutMode(Interface::ReadoutMode mode) const;
+      void setReadoutMode(Interface::ReadoutMode mode);
+      void getReadoutMode(Interface::ReadoutMode& mode) const;
+      void setKineticsWindowHeight(int height);
+      void getKineticsWindowHeight(int& height);
+
+      /// shortest latency of the current readout (s)
+      double getMinLatTime();
+      /// to call when a parameter the readout time depends on is set
+      void readoutChanged();
+
     private:
       PicamHandle 	m_cam;
+      ParameterCache&	m_parameters;
       TrigMode		m_trig_mode;
       int		m_acq_nb_frames;
+      double		m_lat_time;
+      double		m_min_lat_time;
+      Interface::ReadoutMode m_readout_mode;
       std::list<TrigMode> m_trigger_capability;
+      std::list<Interface::ReadoutMode> m_readout_mode_capability;
     };
   }
 }
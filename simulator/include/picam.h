@@ -0,0 +1,459 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Subset of the PICam API used by the Lima Princeton plugin, implemented
+ * by the simulated PICam library (picamsim). Types, names and layouts
+ * follow the vendor picam.h; a simulator build never mixes with the
+ * vendor library, so only the subset the plugin uses is declared.
+ */
+#ifndef PICAM_H
+#define PICAM_H
+
+#if defined(_WIN32)
+#  define PIL_CALL __stdcall
+#  ifdef PICAMSIM_EXPORTS
+#    define PICAM_API __declspec(dllexport) PicamError PIL_CALL
+#  else
+#    define PICAM_API __declspec(dllimport) PicamError PIL_CALL
+#  endif
+#else
+#  define PIL_CALL
+#  define PICAM_API __attribute__((visibility("default"))) PicamError PIL_CALL
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------------------*/
+/* Basic types                                                             */
+/*-------------------------------------------------------------------------*/
+typedef int		piint;
+typedef double		piflt;
+typedef int		pibln;
+typedef char		pichar;
+typedef unsigned char	pibyte;
+typedef long long	pi64s;
+
+typedef void* PicamHandle;
+
+/*-------------------------------------------------------------------------*/
+/* Errors and library                                                      */
+/*-------------------------------------------------------------------------*/
+typedef enum PicamError
+{
+  PicamError_None                          =  0,
+  PicamError_LibraryNotInitialized         =  1,
+  PicamError_LibraryAlreadyInitialized     =  5,
+  PicamError_InvalidEnumeratedType         = 39,
+  PicamError_EnumerationValueNotDefined    = 17,
+  PicamError_InvalidCameraID               =  9,
+  PicamError_InvalidHandle                 = 10,
+  PicamError_CameraAlreadyOpened           =  8,
+  PicamError_ParameterHasInvalidValueType  = 13,
+  PicamError_ParameterDoesNotExist         = 12,
+  PicamError_ParameterValueIsReadOnly      = 14,
+  PicamError_InvalidParameterValue         = 15,
+  PicamError_ParameterHasInvalidConstraintType = 16,
+  PicamError_ParametersNotCommitted        = 19,
+  PicamError_InvalidAcquisitionBuffer      = 20,
+  PicamError_AcquisitionInProgress         = 18,
+  PicamError_UnexpectedNullPointer         =  3,
+  PicamError_UnexpectedError               =  4
+} PicamError;
+
+typedef enum PicamEnumeratedType
+{
+  PicamEnumeratedType_Error                 =  1,
+  PicamEnumeratedType_Model                 = 18,
+  PicamEnumeratedType_ComputerInterface     = 19,
+  PicamEnumeratedType_Parameter             =  6
+} PicamEnumeratedType;
+
+PICAM_API Picam_GetVersion(piint* major,piint* minor,piint* distribution,
+			   piint* released);
+PICAM_API Picam_IsLibraryInitialized(pibln* inited);
+PICAM_API Picam_InitializeLibrary(void);
+PICAM_API Picam_UninitializeLibrary(void);
+PICAM_API Picam_DestroyString(const pichar* s);
+PICAM_API Picam_GetEnumerationString(PicamEnumeratedType type,piint value,
+				     const pichar** s);
+
+/*-------------------------------------------------------------------------*/
+/* Camera identification                                                   */
+/*-------------------------------------------------------------------------*/
+typedef enum PicamModel
+{
+  PicamModel_PixisSeries  =   0,
+  PicamModel_Pixis400B    =  18,
+  PicamModel_ProEMSeries  = 600
+} PicamModel;
+
+typedef enum PicamComputerInterface
+{
+  PicamComputerInterface_Usb2            = 1,
+  PicamComputerInterface_1394A           = 2,
+  PicamComputerInterface_GigabitEthernet = 3,
+  PicamComputerInterface_Usb3            = 4
+} PicamComputerInterface;
+
+typedef enum PicamStringSize
+{
+  PicamStringSize_SensorName   =  64,
+  PicamStringSize_SerialNumber =  64
+} PicamStringSize;
+
+typedef struct PicamCameraID
+{
+  PicamModel			model;
+  PicamComputerInterface	computer_interface;
+  pichar			sensor_name[PicamStringSize_SensorName];
+  pichar			serial_number[PicamStringSize_SerialNumber];
+} PicamCameraID;
+
+PICAM_API Picam_DestroyCameraIDs(const PicamCameraID* id_array);
+PICAM_API Picam_GetAvailableCameraIDs(const PicamCameraID** id_array,
+				      piint* id_count);
+PICAM_API Picam_GetCameraID(PicamHandle camera,PicamCameraID* id);
+
+/*-------------------------------------------------------------------------*/
+/* Parameter values                                                        */
+/*-------------------------------------------------------------------------*/
+typedef enum PicamValueType
+{
+  PicamValueType_Integer       = 1,
+  PicamValueType_Boolean       = 3,
+  PicamValueType_Enumeration   = 4,
+  PicamValueType_LargeInteger  = 6,
+  PicamValueType_FloatingPoint = 2,
+  PicamValueType_Rois          = 5,
+  PicamValueType_Pulse         = 7,
+  PicamValueType_Modulations   = 8
+} PicamValueType;
+
+typedef enum PicamConstraintType
+{
+  PicamConstraintType_None        = 1,
+  PicamConstraintType_Range       = 2,
+  PicamConstraintType_Collection  = 3,
+  PicamConstraintType_Rois        = 4,
+  PicamConstraintType_Pulse       = 5,
+  PicamConstraintType_Modulations = 6
+} PicamConstraintType;
+
+#define PI_V(v,c,n) (((PicamConstraintType_##c) << 24) + \
+		     ((PicamValueType_##v) << 16) + (n))
+
+typedef enum PicamParameter
+{
+  PicamParameter_ExposureTime                = PI_V(FloatingPoint,Range,23),
+  PicamParameter_ShutterTimingMode           = PI_V(Enumeration,Collection,24),
+  PicamParameter_ShutterOpeningDelay         = PI_V(FloatingPoint,Range,46),
+  PicamParameter_ShutterClosingDelay         = PI_V(FloatingPoint,Range,25),
+  PicamParameter_ShutterDelayResolution      = PI_V(FloatingPoint,Collection,47),
+  PicamParameter_GateTracking                = PI_V(Enumeration,Collection,104),
+  PicamParameter_GateTrackingBitDepth        = PI_V(Integer,Collection,105),
+  PicamParameter_AdcSpeed                    = PI_V(FloatingPoint,Collection,33),
+  PicamParameter_AdcQuality                  = PI_V(Enumeration,Collection,36),
+  PicamParameter_AdcAnalogGain               = PI_V(Enumeration,Collection,35),
+  PicamParameter_ActiveWidth                 = PI_V(Integer,Range,1),
+  PicamParameter_ActiveHeight                = PI_V(Integer,Range,2),
+  PicamParameter_PixelWidth                  = PI_V(FloatingPoint,Range,9),
+  PicamParameter_PixelHeight                 = PI_V(FloatingPoint,Range,10),
+  PicamParameter_ReadoutControlMode          = PI_V(Enumeration,Collection,26),
+  PicamParameter_ReadoutTimeCalculation      = PI_V(FloatingPoint,None,27),
+  PicamParameter_ReadoutPortCount            = PI_V(Integer,Collection,28),
+  PicamParameter_FrameRateCalculation        = PI_V(FloatingPoint,None,51),
+  PicamParameter_OnlineReadoutRateCalculation = PI_V(FloatingPoint,None,99),
+  PicamParameter_KineticsWindowHeight        = PI_V(Integer,Range,56),
+  PicamParameter_Rois                        = PI_V(Rois,Rois,37),
+  PicamParameter_TriggerSource               = PI_V(Enumeration,Collection,79),
+  PicamParameter_TriggerResponse             = PI_V(Enumeration,Collection,30),
+  PicamParameter_TriggerDetermination        = PI_V(Enumeration,Collection,31),
+  PicamParameter_ReadoutCount                = PI_V(LargeInteger,Range,40),
+  PicamParameter_TimeStamps                  = PI_V(Enumeration,Collection,68),
+  PicamParameter_TimeStampResolution         = PI_V(LargeInteger,Collection,69),
+  PicamParameter_TimeStampBitDepth           = PI_V(Integer,Collection,70),
+  PicamParameter_TrackFrames                 = PI_V(Boolean,Collection,71),
+  PicamParameter_FrameTrackingBitDepth       = PI_V(Integer,Collection,72),
+  PicamParameter_FrameSize                   = PI_V(Integer,None,42),
+  PicamParameter_FrameStride                 = PI_V(Integer,None,43),
+  PicamParameter_FramesPerReadout            = PI_V(Integer,None,44),
+  PicamParameter_ReadoutStride               = PI_V(Integer,None,45),
+  PicamParameter_SensorTemperatureSetPoint   = PI_V(FloatingPoint,Range,14),
+  PicamParameter_SensorTemperatureReading    = PI_V(FloatingPoint,None,15)
+} PicamParameter;
+
+typedef enum PicamShutterTimingMode
+{
+  PicamShutterTimingMode_Normal            = 1,
+  PicamShutterTimingMode_AlwaysClosed      = 2,
+  PicamShutterTimingMode_AlwaysOpen        = 3,
+  PicamShutterTimingMode_OpenBeforeTrigger = 4
+} PicamShutterTimingMode;
+
+typedef enum PicamGateTrackingMask
+{
+  PicamGateTrackingMask_None  = 0x0,
+  PicamGateTrackingMask_Delay = 0x1,
+  PicamGateTrackingMask_Width = 0x2
+} PicamGateTrackingMask;
+
+typedef enum PicamAdcQuality
+{
+  PicamAdcQuality_LowNoise           = 1,
+  PicamAdcQuality_HighCapacity       = 2,
+  PicamAdcQuality_HighSpeed          = 4,
+  PicamAdcQuality_ElectronMultiplied = 3
+} PicamAdcQuality;
+
+typedef enum PicamAdcAnalogGain
+{
+  PicamAdcAnalogGain_Low    = 1,
+  PicamAdcAnalogGain_Medium = 2,
+  PicamAdcAnalogGain_High   = 3
+} PicamAdcAnalogGain;
+
+typedef enum PicamReadoutControlMode
+{
+  PicamReadoutControlMode_FullFrame       = 1,
+  PicamReadoutControlMode_FrameTransfer   = 2,
+  PicamReadoutControlMode_Interline       = 5,
+  PicamReadoutControlMode_Kinetics        = 3,
+  PicamReadoutControlMode_SpectraKinetics = 4,
+  PicamReadoutControlMode_Dif             = 6
+} PicamReadoutControlMode;
+
+typedef enum PicamTriggerSource
+{
+  PicamTriggerSource_External = 1,
+  PicamTriggerSource_Internal = 2
+} PicamTriggerSource;
+
+typedef enum PicamTriggerResponse
+{
+  PicamTriggerResponse_NoResponse               = 1,
+  PicamTriggerResponse_ReadoutPerTrigger        = 2,
+  PicamTriggerResponse_ShiftPerTrigger          = 3,
+  PicamTriggerResponse_ExposeDuringTriggerPulse = 4,
+  PicamTriggerResponse_StartOnSingleTrigger     = 5,
+  PicamTriggerResponse_GatePerTrigger           = 6
+} PicamTriggerResponse;
+
+typedef enum PicamTriggerDetermination
+{
+  PicamTriggerDetermination_PositivePolarity = 1,
+  PicamTriggerDetermination_NegativePolarity = 2,
+  PicamTriggerDetermination_RisingEdge       = 3,
+  PicamTriggerDetermination_FallingEdge      = 4
+} PicamTriggerDetermination;
+
+typedef enum PicamTimeStampsMask
+{
+  PicamTimeStampsMask_None            = 0x0,
+  PicamTimeStampsMask_ExposureStarted = 0x1,
+  PicamTimeStampsMask_ExposureEnded   = 0x2
+} PicamTimeStampsMask;
+
+typedef struct PicamRoi
+{
+  piint x;
+  piint width;
+  piint x_binning;
+  piint y;
+  piint height;
+  piint y_binning;
+} PicamRoi;
+
+typedef struct PicamRois
+{
+  PicamRoi* roi_array;
+  piint     roi_count;
+} PicamRois;
+
+typedef enum PicamValueAccess
+{
+  PicamValueAccess_ReadOnly         = 1,
+  PicamValueAccess_ReadWriteTrivial = 3,
+  PicamValueAccess_ReadWrite        = 2
+} PicamValueAccess;
+
+PICAM_API Picam_DestroyParameters(const PicamParameter* parameter_array);
+PICAM_API Picam_GetParameters(PicamHandle camera,
+			      const PicamParameter** parameter_array,
+			      piint* parameter_count);
+PICAM_API Picam_DoesParameterExist(PicamHandle camera,PicamParameter parameter,
+				   pibln* exists);
+PICAM_API Picam_GetParameterValueType(PicamHandle camera,PicamParameter parameter,
+				      PicamValueType* type);
+PICAM_API Picam_GetParameterValueAccess(PicamHandle camera,PicamParameter parameter,
+					PicamValueAccess* access);
+
+PICAM_API Picam_GetParameterIntegerValue(PicamHandle camera,PicamParameter parameter,
+					 piint* value);
+PICAM_API Picam_SetParameterIntegerValue(PicamHandle camera,PicamParameter parameter,
+					 piint value);
+PICAM_API Picam_CanSetParameterIntegerValue(PicamHandle camera,
+					    PicamParameter parameter,
+					    piint value,pibln* settable);
+PICAM_API Picam_GetParameterLargeIntegerValue(PicamHandle camera,
+					      PicamParameter parameter,
+					      pi64s* value);
+PICAM_API Picam_SetParameterLargeIntegerValue(PicamHandle camera,
+					      PicamParameter parameter,
+					      pi64s value);
+PICAM_API Picam_GetParameterFloatingPointValue(PicamHandle camera,
+					       PicamParameter parameter,
+					       piflt* value);
+PICAM_API Picam_SetParameterFloatingPointValue(PicamHandle camera,
+					       PicamParameter parameter,
+					       piflt value);
+PICAM_API Picam_ReadParameterFloatingPointValue(PicamHandle camera,
+						PicamParameter parameter,
+						piflt* value);
+PICAM_API Picam_SetParameterRoisValue(PicamHandle camera,PicamParameter parameter,
+				      const PicamRois* value);
+
+/*-------------------------------------------------------------------------*/
+/* Parameter constraints                                                   */
+/*-------------------------------------------------------------------------*/
+typedef enum PicamConstraintScope
+{
+  PicamConstraintScope_Independent = 1,
+  PicamConstraintScope_Dependent   = 2
+} PicamConstraintScope;
+
+typedef enum PicamConstraintSeverity
+{
+  PicamConstraintSeverity_Error   = 1,
+  PicamConstraintSeverity_Warning = 2
+} PicamConstraintSeverity;
+
+typedef enum PicamConstraintCategory
+{
+  PicamConstraintCategory_Capable     = 1,
+  PicamConstraintCategory_Required    = 2,
+  PicamConstraintCategory_Recommended = 3
+} PicamConstraintCategory;
+
+typedef struct PicamCollectionConstraint
+{
+  PicamConstraintScope    scope;
+  PicamConstraintSeverity severity;
+  const piflt*            values_array;
+  piint                   values_count;
+} PicamCollectionConstraint;
+
+typedef struct PicamRangeConstraint
+{
+  PicamConstraintScope    scope;
+  PicamConstraintSeverity severity;
+  pibln                   empty_set;
+  piflt                   minimum;
+  piflt                   maximum;
+  piflt                   increment;
+  const piflt*            excluded_values_array;
+  piint                   excluded_values_count;
+  const piflt*            outlying_values_array;
+  piint                   outlying_values_count;
+} PicamRangeConstraint;
+
+typedef enum PicamRoisConstraintRulesMask
+{
+  PicamRoisConstraintRulesMask_None                  = 0x00,
+  PicamRoisConstraintRulesMask_XBinningAlignment     = 0x01,
+  PicamRoisConstraintRulesMask_YBinningAlignment     = 0x02,
+  PicamRoisConstraintRulesMask_HorizontalSymmetry    = 0x04,
+  PicamRoisConstraintRulesMask_VerticalSymmetry      = 0x08,
+  PicamRoisConstraintRulesMask_SymmetryBoundsBinning = 0x10
+} PicamRoisConstraintRulesMask;
+
+typedef struct PicamRoisConstraint
+{
+  PicamConstraintScope         scope;
+  PicamConstraintSeverity      severity;
+  pibln                        empty_set;
+  PicamRoisConstraintRulesMask rules;
+  piint                        maximum_roi_count;
+  PicamRangeConstraint         x_constraint;
+  PicamRangeConstraint         width_constraint;
+  const piint*                 x_binning_limits_array;
+  piint                        x_binning_limits_count;
+  PicamRangeConstraint         y_constraint;
+  PicamRangeConstraint         height_constraint;
+  const piint*                 y_binning_limits_array;
+  piint                        y_binning_limits_count;
+} PicamRoisConstraint;
+
+PICAM_API Picam_DestroyCollectionConstraints(const PicamCollectionConstraint* constraint_array);
+PICAM_API Picam_GetParameterCollectionConstraint(PicamHandle camera,
+						 PicamParameter parameter,
+						 PicamConstraintCategory category,
+						 const PicamCollectionConstraint** constraint);
+PICAM_API Picam_DestroyRangeConstraints(const PicamRangeConstraint* constraint_array);
+PICAM_API Picam_GetParameterRangeConstraint(PicamHandle camera,
+					    PicamParameter parameter,
+					    PicamConstraintCategory category,
+					    const PicamRangeConstraint** constraint);
+PICAM_API Picam_DestroyRoisConstraints(const PicamRoisConstraint* constraint_array);
+PICAM_API Picam_GetParameterRoisConstraint(PicamHandle camera,
+					   PicamParameter parameter,
+					   PicamConstraintCategory category,
+					   const PicamRoisConstraint** constraint);
+
+/*-------------------------------------------------------------------------*/
+/* Commit and acquisition                                                  */
+/*-------------------------------------------------------------------------*/
+PICAM_API Picam_AreParametersCommitted(PicamHandle camera,pibln* committed);
+PICAM_API Picam_CommitParameters(PicamHandle camera,
+				 const PicamParameter** failed_parameter_array,
+				 piint* failed_parameter_count);
+
+typedef struct PicamAvailableData
+{
+  void* initial_readout;
+  pi64s readout_count;
+} PicamAvailableData;
+
+typedef enum PicamAcquisitionErrorsMask
+{
+  PicamAcquisitionErrorsMask_None           = 0x00,
+  PicamAcquisitionErrorsMask_DataLost       = 0x01,
+  PicamAcquisitionErrorsMask_ConnectionLost = 0x02
+} PicamAcquisitionErrorsMask;
+
+typedef struct PicamAcquisitionStatus
+{
+  pibln                      running;
+  PicamAcquisitionErrorsMask errors;
+  piflt                      readout_rate;
+} PicamAcquisitionStatus;
+
+PICAM_API Picam_StartAcquisition(PicamHandle camera);
+PICAM_API Picam_StopAcquisition(PicamHandle camera);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICAM_H */
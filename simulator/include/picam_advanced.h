@@ -0,0 +1,90 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Subset of the PICam advanced API used by the Lima Princeton plugin,
+ * implemented by the simulated PICam library (picamsim).
+ */
+#ifndef PICAM_ADVANCED_H
+#define PICAM_ADVANCED_H
+
+#include "picam.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+PICAM_API PicamAdvanced_OpenCameraDevice(const PicamCameraID* id,
+					 PicamHandle* device);
+PICAM_API PicamAdvanced_CloseCameraDevice(PicamHandle device);
+PICAM_API PicamAdvanced_GetCameraModel(PicamHandle device,PicamHandle* model);
+PICAM_API PicamAdvanced_CommitParametersToCameraDevice(PicamHandle model);
+
+typedef PicamError (PIL_CALL* PicamIntegerValueChangedCallback)
+  (PicamHandle camera,PicamParameter parameter,piint value);
+typedef PicamError (PIL_CALL* PicamLargeIntegerValueChangedCallback)
+  (PicamHandle camera,PicamParameter parameter,pi64s value);
+typedef PicamError (PIL_CALL* PicamFloatingPointValueChangedCallback)
+  (PicamHandle camera,PicamParameter parameter,piflt value);
+
+PICAM_API PicamAdvanced_RegisterForIntegerValueChanged(PicamHandle camera,
+						       PicamParameter parameter,
+						       PicamIntegerValueChangedCallback changed);
+PICAM_API PicamAdvanced_UnregisterForIntegerValueChanged(PicamHandle camera,
+							 PicamParameter parameter,
+							 PicamIntegerValueChangedCallback changed);
+PICAM_API PicamAdvanced_RegisterForLargeIntegerValueChanged(PicamHandle camera,
+							    PicamParameter parameter,
+							    PicamLargeIntegerValueChangedCallback changed);
+PICAM_API PicamAdvanced_UnregisterForLargeIntegerValueChanged(PicamHandle camera,
+							      PicamParameter parameter,
+							      PicamLargeIntegerValueChangedCallback changed);
+PICAM_API PicamAdvanced_RegisterForFloatingPointValueChanged(PicamHandle camera,
+							     PicamParameter parameter,
+							     PicamFloatingPointValueChangedCallback changed);
+PICAM_API PicamAdvanced_UnregisterForFloatingPointValueChanged(PicamHandle camera,
+							       PicamParameter parameter,
+							       PicamFloatingPointValueChangedCallback changed);
+
+typedef struct PicamAcquisitionBuffer
+{
+  void* memory;
+  pi64s memory_size;
+} PicamAcquisitionBuffer;
+
+PICAM_API PicamAdvanced_SetAcquisitionBuffer(PicamHandle device,
+					     const PicamAcquisitionBuffer* buffer);
+
+typedef PicamError (PIL_CALL* PicamAcquisitionUpdatedCallback)
+  (PicamHandle device,const PicamAvailableData* available,
+   const PicamAcquisitionStatus* status);
+
+PICAM_API PicamAdvanced_RegisterForAcquisitionUpdated(PicamHandle device,
+						      PicamAcquisitionUpdatedCallback updated);
+PICAM_API PicamAdvanced_UnregisterForAcquisitionUpdated(PicamHandle device,
+							PicamAcquisitionUpdatedCallback updated);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICAM_ADVANCED_H */
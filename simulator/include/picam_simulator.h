@@ -0,0 +1,72 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Configuration of the simulated PICam library (picamsim).
+ *
+ * The configuration is read from the PICAM_SIM_* environment variables
+ * the first time the library is used, it can then be changed with
+ * PicamSimulator_SetConfig:
+ *  - the sensor geometry and the number of cameras apply to the
+ *    cameras opened afterwards,
+ *  - the frame rate and the error injection apply to the next
+ *    acquisition.
+ */
+#ifndef PICAM_SIMULATOR_H
+#define PICAM_SIMULATOR_H
+
+#include "picam.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PicamSimulatorConfig
+{
+  piint nb_cameras;		/* PICAM_SIM_CAMERAS */
+  piint width;			/* PICAM_SIM_WIDTH */
+  piint height;			/* PICAM_SIM_HEIGHT */
+  /* frames per second, 0 follows the exposure and the readout time
+   * (PICAM_SIM_FRAME_RATE) */
+  piflt frame_rate;
+  /* readouts given by each acquisition updated callback
+   * (PICAM_SIM_READOUTS_PER_CALLBACK) */
+  piint readouts_per_callback;
+  /* drop one readout every drop_every readouts and report a data
+   * loss, 0 never (PICAM_SIM_DROP_EVERY) */
+  pi64s drop_every;
+  /* lose the connection after fail_after readouts, 0 never
+   * (PICAM_SIM_FAIL_AFTER) */
+  pi64s fail_after;
+  /* write a test pattern in the pixels, otherwise only the frame
+   * number and the metadata are written (PICAM_SIM_FILL_PIXELS) */
+  pibln fill_pixels;
+} PicamSimulatorConfig;
+
+PICAM_API PicamSimulator_GetConfig(PicamSimulatorConfig* config);
+PICAM_API PicamSimulator_SetConfig(const PicamSimulatorConfig* config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICAM_SIMULATOR_H */
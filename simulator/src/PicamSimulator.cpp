@@ -0,0 +1,1602 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Simulated PICam library: the subset of PICam and PicamAdvanced used
+ * by the plugin, with a generator thread producing synthetic readouts.
+ */
+#include "picam_advanced.h"
+#include "picam_simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  const piint VERSION_MAJOR = 5;
+  const piint VERSION_MINOR = 7;
+  const piint VERSION_DISTRIBUTION = 0;
+  const piint VERSION_RELEASED = 0;
+
+  const int MAX_ROI_COUNT = 16;
+  // vertical shift time of one row (s)
+  const double ROW_SHIFT_TIME = 2e-6;
+  const pi64s TIMESTAMP_RESOLUTION = 1000000;
+  // internal buffer size when the client doesn't give one
+  const int MIN_INTERNAL_READOUTS = 16;
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Parameter
+  {
+    piflt value;
+    PicamValueAccess access;
+    std::vector<piflt> collection;	// Collection constraint
+    piflt minimum,maximum,increment;	// Range constraint
+  };
+
+  struct Camera
+  {
+    PicamCameraID id;
+    std::mutex lock;
+    std::map<PicamParameter,Parameter> parameters;
+    std::vector<PicamRoi> rois;
+    bool committed;
+
+    std::multimap<PicamParameter,PicamIntegerValueChangedCallback> integer_cbs;
+    std::multimap<PicamParameter,PicamLargeIntegerValueChangedCallback> large_integer_cbs;
+    std::multimap<PicamParameter,PicamFloatingPointValueChangedCallback> floating_point_cbs;
+    std::vector<PicamAcquisitionUpdatedCallback> acquisition_cbs;
+
+    PicamAcquisitionBuffer buffer;
+    std::vector<pibyte> internal_buffer;
+    std::thread generator;
+    std::condition_variable stop_cond;
+    bool stop_request;
+    std::atomic<bool> running;
+  };
+
+  typedef std::vector<std::pair<PicamParameter,piflt> > Changes;
+
+  std::mutex g_lock;
+  bool g_initialized = false;
+  bool g_config_loaded = false;
+  PicamSimulatorConfig g_config;
+  std::set<Camera*> g_cameras;
+
+  inline PicamValueType value_type(PicamParameter parameter)
+  {
+    return PicamValueType((parameter >> 16) & 0xff);
+  }
+
+  inline PicamConstraintType constraint_type(PicamParameter parameter)
+  {
+    return PicamConstraintType((parameter >> 24) & 0xff);
+  }
+
+  inline bool is_integer_type(PicamValueType type)
+  {
+    return (type == PicamValueType_Integer ||
+	    type == PicamValueType_Boolean ||
+	    type == PicamValueType_Enumeration);
+  }
+
+  long long env_value(const char* name,long long default_value)
+  {
+    const char* value = getenv(name);
+    return value && *value ? atoll(value) : default_value;
+  }
+
+  /** @brief must be called with g_lock
+   */
+  void load_config()
+  {
+    if(g_config_loaded)
+      return;
+    g_config.nb_cameras = piint(env_value("PICAM_SIM_CAMERAS",1));
+    g_config.width = piint(env_value("PICAM_SIM_WIDTH",1340));
+    g_config.height = piint(env_value("PICAM_SIM_HEIGHT",400));
+    const char* frame_rate = getenv("PICAM_SIM_FRAME_RATE");
+    g_config.frame_rate = frame_rate && *frame_rate ? atof(frame_rate) : 0.;
+    g_config.readouts_per_callback =
+      piint(env_value("PICAM_SIM_READOUTS_PER_CALLBACK",1));
+    g_config.drop_every = env_value("PICAM_SIM_DROP_EVERY",0);
+    g_config.fail_after = env_value("PICAM_SIM_FAIL_AFTER",0);
+    g_config.fill_pixels = pibln(env_value("PICAM_SIM_FILL_PIXELS",1) != 0);
+    g_config_loaded = true;
+  }
+
+  PicamSimulatorConfig get_config()
+  {
+    std::lock_guard<std::mutex> lock(g_lock);
+    load_config();
+    return g_config;
+  }
+
+  bool is_initialized()
+  {
+    std::lock_guard<std::mutex> lock(g_lock);
+    return g_initialized;
+  }
+
+  Camera* get_camera(PicamHandle handle)
+  {
+    std::lock_guard<std::mutex> lock(g_lock);
+    Camera* camera = static_cast<Camera*>(handle);
+    return g_initialized && g_cameras.count(camera) ? camera : NULL;
+  }
+
+  void make_serial(int index,pichar* serial)
+  {
+    snprintf(serial,PicamStringSize_SerialNumber,"SIM%04d",index + 1);
+  }
+
+  void make_id(int index,PicamCameraID& id)
+  {
+    memset(&id,0,sizeof(id));
+    id.model = PicamModel_Pixis400B;
+    id.computer_interface = PicamComputerInterface_Usb2;
+    snprintf(id.sensor_name,PicamStringSize_SensorName,"Simulated CCD");
+    make_serial(index,id.serial_number);
+  }
+
+  /*-----------------------------------------------------------------------*/
+  /* Parameters                                                            */
+  /*-----------------------------------------------------------------------*/
+  void add_range(Camera& camera,PicamParameter parameter,piflt value,
+		 piflt minimum,piflt maximum,piflt increment,
+		 PicamValueAccess access = PicamValueAccess_ReadWrite)
+  {
+    Parameter& p = camera.parameters[parameter];
+    p.value = value;
+    p.access = access;
+    p.minimum = minimum;
+    p.maximum = maximum;
+    p.increment = increment;
+  }
+
+  void add_collection(Camera& camera,PicamParameter parameter,piflt value,
+		      const std::vector<piflt>& collection)
+  {
+    Parameter& p = camera.parameters[parameter];
+    p.value = value;
+    p.access = collection.size() > 1 ? PicamValueAccess_ReadWrite :
+      PicamValueAccess_ReadOnly;
+    p.collection = collection;
+    p.minimum = p.maximum = p.increment = 0.;
+  }
+
+  void add_calculation(Camera& camera,PicamParameter parameter)
+  {
+    add_range(camera,parameter,0.,0.,0.,0.,PicamValueAccess_ReadOnly);
+  }
+
+  piflt value(const Camera& camera,PicamParameter parameter)
+  {
+    return camera.parameters.find(parameter)->second.value;
+  }
+
+  struct Geometry
+  {
+    int frame_pixels;
+    int frame_size;
+    int metadata_size;
+    int frame_stride;
+    int frames_per_readout;
+    int readout_stride;
+    double exposure_time;	// s
+    double readout_time;	// s, all the frames of a readout
+    double frame_rate;		// frames/s
+  };
+
+  void compute_geometry(const Camera& camera,const PicamSimulatorConfig& config,
+			Geometry& geometry)
+  {
+    int height = int(value(camera,PicamParameter_ActiveHeight));
+    int mode = int(value(camera,PicamParameter_ReadoutControlMode));
+    bool kinetics = mode == PicamReadoutControlMode_Kinetics;
+
+    geometry.frames_per_readout = 1;
+    geometry.frame_pixels = 0;
+    if(kinetics)
+      {
+	int window = int(value(camera,PicamParameter_KineticsWindowHeight));
+	const PicamRoi& roi = camera.rois.front();
+	geometry.frames_per_readout = std::max(height / window,1);
+	geometry.frame_pixels = (roi.width / roi.x_binning) *
+	  std::max(window / roi.y_binning,1);
+      }
+    else
+      for(auto roi = camera.rois.begin();roi != camera.rois.end();++roi)
+	geometry.frame_pixels += (roi->width / roi->x_binning) *
+	  (roi->height / roi->y_binning);
+
+    int timestamps = int(value(camera,PicamParameter_TimeStamps));
+    geometry.metadata_size = 0;
+    if(timestamps & PicamTimeStampsMask_ExposureStarted)
+      geometry.metadata_size += int(value(camera,PicamParameter_TimeStampBitDepth)) / 8;
+    if(timestamps & PicamTimeStampsMask_ExposureEnded)
+      geometry.metadata_size += int(value(camera,PicamParameter_TimeStampBitDepth)) / 8;
+    if(value(camera,PicamParameter_TrackFrames) != 0.)
+      geometry.metadata_size += int(value(camera,PicamParameter_FrameTrackingBitDepth)) / 8;
+
+    geometry.frame_size = geometry.frame_pixels * 2;
+    geometry.frame_stride = geometry.frame_size + geometry.metadata_size;
+    geometry.readout_stride = geometry.frame_stride * geometry.frames_per_readout;
+
+    // every row is shifted, only the binned pixels are digitized
+    double pixel_time = 1. / (value(camera,PicamParameter_AdcSpeed) * 1e6 *
+			      value(camera,PicamParameter_ReadoutPortCount));
+    geometry.readout_time = height * ROW_SHIFT_TIME +
+      double(geometry.frame_pixels) * geometry.frames_per_readout * pixel_time;
+    geometry.exposure_time = value(camera,PicamParameter_ExposureTime) / 1e3;
+
+    if(config.frame_rate > 0.)
+      geometry.frame_rate = config.frame_rate;
+    else
+      {
+	double period;
+	if(mode == PicamReadoutControlMode_FrameTransfer)
+	  period = std::max(geometry.exposure_time,geometry.readout_time);
+	else
+	  period = geometry.exposure_time * geometry.frames_per_readout +
+	    geometry.readout_time;
+	geometry.frame_rate = geometry.frames_per_readout / period;
+      }
+  }
+
+  /** @brief recompute the read-only calculations, the changed ones are
+   *  appended to changes. Must be called with the camera lock.
+   */
+  void update_calculations(Camera& camera,const PicamSimulatorConfig& config,
+			   Changes& changes)
+  {
+    Geometry geometry;
+    compute_geometry(camera,config,geometry);
+    const std::pair<PicamParameter,piflt> calculations[] =
+      {{PicamParameter_FrameSize,piflt(geometry.frame_size)},
+       {PicamParameter_FrameStride,piflt(geometry.frame_stride)},
+       {PicamParameter_FramesPerReadout,piflt(geometry.frames_per_readout)},
+       {PicamParameter_ReadoutStride,piflt(geometry.readout_stride)},
+       {PicamParameter_ReadoutTimeCalculation,geometry.readout_time * 1e3},
+       {PicamParameter_FrameRateCalculation,geometry.frame_rate},
+       {PicamParameter_OnlineReadoutRateCalculation,
+	geometry.frame_rate / geometry.frames_per_readout}};
+    for(auto i = std::begin(calculations);i != std::end(calculations);++i)
+      {
+	Parameter& p = camera.parameters[i->first];
+	if(p.value != i->second)
+	  {
+	    p.value = i->second;
+	    changes.push_back(*i);
+	  }
+      }
+  }
+
+  void init_parameters(Camera& camera,const PicamSimulatorConfig& config)
+  {
+    int width = std::max(config.width,1),height = std::max(config.height,1);
+    add_range(camera,PicamParameter_ActiveWidth,width,width,width,1,
+	      PicamValueAccess_ReadOnly);
+    add_range(camera,PicamParameter_ActiveHeight,height,height,height,1,
+	      PicamValueAccess_ReadOnly);
+    add_range(camera,PicamParameter_PixelWidth,20.,20.,20.,0.,
+	      PicamValueAccess_ReadOnly);
+    add_range(camera,PicamParameter_PixelHeight,20.,20.,20.,0.,
+	      PicamValueAccess_ReadOnly);
+
+    add_collection(camera,PicamParameter_AdcSpeed,2.,{0.1,2.});
+    add_collection(camera,PicamParameter_AdcQuality,PicamAdcQuality_LowNoise,
+		   {PicamAdcQuality_LowNoise,PicamAdcQuality_HighCapacity});
+    add_collection(camera,PicamParameter_AdcAnalogGain,PicamAdcAnalogGain_Medium,
+		   {PicamAdcAnalogGain_Low,PicamAdcAnalogGain_Medium,
+		       PicamAdcAnalogGain_High});
+    add_collection(camera,PicamParameter_ReadoutPortCount,1,{1,2});
+
+    add_range(camera,PicamParameter_ExposureTime,100.,0.,1e7,1e-3);
+    add_collection(camera,PicamParameter_ShutterTimingMode,
+		   PicamShutterTimingMode_Normal,
+		   {PicamShutterTimingMode_Normal,
+		       PicamShutterTimingMode_AlwaysClosed,
+		       PicamShutterTimingMode_AlwaysOpen});
+    add_range(camera,PicamParameter_ShutterOpeningDelay,0.,0.,1e5,1.);
+    add_range(camera,PicamParameter_ShutterClosingDelay,0.,0.,1e5,1.);
+    add_collection(camera,PicamParameter_ShutterDelayResolution,1000.,{1000.});
+
+    add_collection(camera,PicamParameter_ReadoutControlMode,
+		   PicamReadoutControlMode_FullFrame,
+		   {PicamReadoutControlMode_FullFrame,
+		       PicamReadoutControlMode_FrameTransfer,
+		       PicamReadoutControlMode_Kinetics});
+    add_range(camera,PicamParameter_KineticsWindowHeight,
+	      std::max(height / 4,1),1,height,1);
+
+    add_collection(camera,PicamParameter_TriggerSource,
+		   PicamTriggerSource_Internal,
+		   {PicamTriggerSource_External,PicamTriggerSource_Internal});
+    add_collection(camera,PicamParameter_TriggerResponse,
+		   PicamTriggerResponse_NoResponse,
+		   {PicamTriggerResponse_NoResponse,
+		       PicamTriggerResponse_ReadoutPerTrigger,
+		       PicamTriggerResponse_ExposeDuringTriggerPulse,
+		       PicamTriggerResponse_StartOnSingleTrigger});
+    add_collection(camera,PicamParameter_TriggerDetermination,
+		   PicamTriggerDetermination_PositivePolarity,
+		   {PicamTriggerDetermination_PositivePolarity,
+		       PicamTriggerDetermination_NegativePolarity,
+		       PicamTriggerDetermination_RisingEdge,
+		       PicamTriggerDetermination_FallingEdge});
+
+    add_range(camera,PicamParameter_ReadoutCount,1.,0.,1e15,1.);
+
+    add_collection(camera,PicamParameter_TimeStamps,PicamTimeStampsMask_None,
+		   {PicamTimeStampsMask_None,
+		       PicamTimeStampsMask_ExposureStarted,
+		       PicamTimeStampsMask_ExposureEnded,
+		       PicamTimeStampsMask_ExposureStarted |
+		       PicamTimeStampsMask_ExposureEnded});
+    add_collection(camera,PicamParameter_TimeStampResolution,
+		   piflt(TIMESTAMP_RESOLUTION),{piflt(TIMESTAMP_RESOLUTION)});
+    add_collection(camera,PicamParameter_TimeStampBitDepth,64,{64});
+    add_collection(camera,PicamParameter_TrackFrames,0,{0,1});
+    add_collection(camera,PicamParameter_FrameTrackingBitDepth,64,{64});
+
+    // the simulated sensor is always at its set point
+    add_range(camera,PicamParameter_SensorTemperatureSetPoint,-70.,-100.,25.,1.);
+    add_calculation(camera,PicamParameter_SensorTemperatureReading);
+
+    const PicamParameter calculations[] =
+      {PicamParameter_FrameSize,PicamParameter_FrameStride,
+       PicamParameter_FramesPerReadout,PicamParameter_ReadoutStride,
+       PicamParameter_ReadoutTimeCalculation,
+       PicamParameter_FrameRateCalculation,
+       PicamParameter_OnlineReadoutRateCalculation};
+    for(auto parameter : calculations)
+      add_calculation(camera,parameter);
+
+    PicamRoi full = {0,width,1,0,height,1};
+    camera.rois.assign(1,full);
+
+    Changes changes;
+    update_calculations(camera,config,changes);
+    camera.committed = true;
+  }
+
+  PicamError check_value(const Parameter& p,PicamParameter parameter,piflt value)
+  {
+    switch(constraint_type(parameter))
+      {
+      case PicamConstraintType_Collection:
+	for(auto i = p.collection.begin();i != p.collection.end();++i)
+	  if(std::fabs(*i - value) <= 1e-9 * std::max(std::fabs(*i),1.))
+	    return PicamError_None;
+	return PicamError_InvalidParameterValue;
+      case PicamConstraintType_Range:
+	if(value < p.minimum || value > p.maximum)
+	  return PicamError_InvalidParameterValue;
+	return PicamError_None;
+      default:
+	return PicamError_None;
+      }
+  }
+
+  /** @brief get a parameter of the expected value type,
+   *  must be called with the camera lock.
+   */
+  PicamError find_parameter(Camera& camera,PicamParameter parameter,
+			    bool integer,PicamValueType type,Parameter*& p)
+  {
+    auto i = camera.parameters.find(parameter);
+    if(i == camera.parameters.end())
+      return PicamError_ParameterDoesNotExist;
+    PicamValueType parameter_type = value_type(parameter);
+    if(integer ? !is_integer_type(parameter_type) : parameter_type != type)
+      return PicamError_ParameterHasInvalidValueType;
+    p = &i->second;
+    return PicamError_None;
+  }
+
+  void notify(Camera& camera,const Changes& changes)
+  {
+    std::vector<std::pair<PicamIntegerValueChangedCallback,
+			  std::pair<PicamParameter,piflt> > > integer_cbs;
+    std::vector<std::pair<PicamLargeIntegerValueChangedCallback,
+			  std::pair<PicamParameter,piflt> > > large_integer_cbs;
+    std::vector<std::pair<PicamFloatingPointValueChangedCallback,
+			  std::pair<PicamParameter,piflt> > > floating_point_cbs;
+    {
+      std::lock_guard<std::mutex> lock(camera.lock);
+      for(auto change = changes.begin();change != changes.end();++change)
+	{
+	  auto integer = camera.integer_cbs.equal_range(change->first);
+	  for(auto i = integer.first;i != integer.second;++i)
+	    integer_cbs.push_back(std::make_pair(i->second,*change));
+	  auto large_integer = camera.large_integer_cbs.equal_range(change->first);
+	  for(auto i = large_integer.first;i != large_integer.second;++i)
+	    large_integer_cbs.push_back(std::make_pair(i->second,*change));
+	  auto floating_point = camera.floating_point_cbs.equal_range(change->first);
+	  for(auto i = floating_point.first;i != floating_point.second;++i)
+	    floating_point_cbs.push_back(std::make_pair(i->second,*change));
+	}
+    }
+    // called without the lock, the client may read other parameters
+    for(auto i = integer_cbs.begin();i != integer_cbs.end();++i)
+      i->first(&camera,i->second.first,piint(i->second.second));
+    for(auto i = large_integer_cbs.begin();i != large_integer_cbs.end();++i)
+      i->first(&camera,i->second.first,pi64s(i->second.second));
+    for(auto i = floating_point_cbs.begin();i != floating_point_cbs.end();++i)
+      i->first(&camera,i->second.first,i->second.second);
+  }
+
+  PicamError get_value(PicamHandle handle,PicamParameter parameter,bool integer,
+		       PicamValueType type,piflt& value)
+  {
+    Camera* camera = get_camera(handle);
+    if(!camera)
+      return is_initialized() ? PicamError_InvalidHandle :
+	PicamError_LibraryNotInitialized;
+    std::lock_guard<std::mutex> lock(camera->lock);
+    Parameter* p;
+    PicamError error = find_parameter(*camera,parameter,integer,type,p);
+    if(error == PicamError_None)
+      value = p->value;
+    return error;
+  }
+
+  PicamError set_value(PicamHandle handle,PicamParameter parameter,bool integer,
+		       PicamValueType type,piflt value)
+  {
+    Camera* camera = get_camera(handle);
+    if(!camera)
+      return is_initialized() ? PicamError_InvalidHandle :
+	PicamError_LibraryNotInitialized;
+    PicamSimulatorConfig config = get_config();
+    Changes changes;
+    {
+      std::lock_guard<std::mutex> lock(camera->lock);
+      Parameter* p;
+      PicamError error = find_parameter(*camera,parameter,integer,type,p);
+      if(error != PicamError_None)
+	return error;
+      if(p->access == PicamValueAccess_ReadOnly)
+	return PicamError_ParameterValueIsReadOnly;
+      if(camera->running)
+	return PicamError_AcquisitionInProgress;
+      error = check_value(*p,parameter,value);
+      if(error != PicamError_None)
+	return error;
+      if(p->value == value)
+	return PicamError_None;
+      p->value = value;
+      camera->committed = false;
+      changes.push_back(std::make_pair(parameter,value));
+      update_calculations(*camera,config,changes);
+    }
+    notify(*camera,changes);
+    return PicamError_None;
+  }
+
+  template<class Callback>
+  PicamError register_callback(PicamHandle handle,PicamParameter parameter,
+			       bool integer,PicamValueType type,Callback callback,
+			       std::multimap<PicamParameter,Callback> Camera::*callbacks,
+			       bool add)
+  {
+    Camera* camera = get_camera(handle);
+    if(!camera)
+      return is_initialized() ? PicamError_InvalidHandle :
+	PicamError_LibraryNotInitialized;
+    if(!callback)
+      return PicamError_UnexpectedNullPointer;
+    std::lock_guard<std::mutex> lock(camera->lock);
+    Parameter* p;
+    PicamError error = find_parameter(*camera,parameter,integer,type,p);
+    if(error != PicamError_None)
+      return error;
+    std::multimap<PicamParameter,Callback>& registered = camera->*callbacks;
+    auto range = registered.equal_range(parameter);
+    for(auto i = range.first;i != range.second;++i)
+      if(i->second == callback)
+	{
+	  if(!add)
+	    registered.erase(i);
+	  return PicamError_None;
+	}
+    if(!add)
+      return PicamError_InvalidParameterValue;
+    registered.insert(std::make_pair(parameter,callback));
+    return PicamError_None;
+  }
+
+  /** @brief constraints are one allocation with their arrays,
+   *  destroyed with free.
+   */
+  template<class Constraint>
+  Constraint* alloc_constraint(size_t extra_size)
+  {
+    void* memory = calloc(1,sizeof(Constraint) + extra_size);
+    return static_cast<Constraint*>(memory);
+  }
+
+  void fill_range(const Parameter& p,PicamRangeConstraint& range)
+  {
+    range.scope = PicamConstraintScope_Independent;
+    range.severity = PicamConstraintSeverity_Error;
+    range.empty_set = false;
+    range.minimum = p.minimum;
+    range.maximum = p.maximum;
+    range.increment = p.increment;
+    range.excluded_values_array = NULL;
+    range.excluded_values_count = 0;
+    range.outlying_values_array = NULL;
+    range.outlying_values_count = 0;
+  }
+
+  PicamError validate_rois(const Camera& camera,const PicamRois& rois)
+  {
+    int width = int(value(camera,PicamParameter_ActiveWidth));
+    int height = int(value(camera,PicamParameter_ActiveHeight));
+    if(rois.roi_count < 1 || rois.roi_count > MAX_ROI_COUNT || !rois.roi_array)
+      return PicamError_InvalidParameterValue;
+    for(int i = 0;i < rois.roi_count;++i)
+      {
+	const PicamRoi& roi = rois.roi_array[i];
+	if(roi.x < 0 || roi.width < 1 || roi.x + roi.width > width ||
+	   roi.y < 0 || roi.height < 1 || roi.y + roi.height > height ||
+	   roi.x_binning < 1 || roi.width % roi.x_binning ||
+	   roi.y_binning < 1 || roi.height % roi.y_binning)
+	  return PicamError_InvalidParameterValue;
+      }
+    return PicamError_None;
+  }
+
+  /** @brief the values are checked when set, only the dependencies
+   *  between parameters are checked here.
+   */
+  void validate_parameters(const Camera& camera,
+			   std::vector<PicamParameter>& failed)
+  {
+    int mode = int(value(camera,PicamParameter_ReadoutControlMode));
+    if(mode == PicamReadoutControlMode_Kinetics)
+      {
+	int window = int(value(camera,PicamParameter_KineticsWindowHeight));
+	const PicamRoi& roi = camera.rois.front();
+	if(camera.rois.size() != 1 || window % roi.y_binning)
+	  failed.push_back(PicamParameter_Rois);
+      }
+  }
+
+  /*-----------------------------------------------------------------------*/
+  /* Acquisition                                                           */
+  /*-----------------------------------------------------------------------*/
+  void write_counter(pibyte* data,unsigned long long value)
+  {
+    for(int i = 0;i < 8;++i,value >>= 8)
+      data[i] = pibyte(value & 0xff);
+  }
+
+  struct Acquisition
+  {
+    Geometry geometry;
+    PicamSimulatorConfig config;
+    pi64s readout_count;	// 0 until stopped
+    int timestamps;
+    bool track_frames;
+    pibyte* buffer;
+    pi64s buffer_readouts;
+    std::vector<pibyte> pattern; // one readout
+  };
+
+  void generate(Camera* camera,Acquisition acq)
+  {
+    const Geometry& geometry = acq.geometry;
+    double frame_period = 1. / geometry.frame_rate;
+    Clock::duration readout_period =
+      std::chrono::duration_cast<Clock::duration>
+      (std::chrono::duration<double>(frame_period * geometry.frames_per_readout));
+    int batch_size = std::max(acq.config.readouts_per_callback,1);
+    double readout_rate = geometry.frame_rate / geometry.frames_per_readout;
+
+    Clock::time_point start = Clock::now();
+    pi64s nb_readouts = 0;	// generated or dropped
+    pi64s buffer_pos = 0;
+    int errors = PicamAcquisitionErrorsMask_None;
+    bool connection_lost = false;
+
+    while(!acq.readout_count || nb_readouts < acq.readout_count)
+      {
+	pi64s batch = batch_size;
+	if(acq.readout_count)
+	  batch = std::min(batch,acq.readout_count - nb_readouts);
+	// a callback gives contiguous readouts
+	batch = std::min(batch,acq.buffer_readouts - buffer_pos);
+	{
+	  std::unique_lock<std::mutex> lock(camera->lock);
+	  Clock::time_point due = start + readout_period * (nb_readouts + batch);
+	  camera->stop_cond.wait_until(lock,due,[camera] {return camera->stop_request;});
+	  if(camera->stop_request)
+	    break;
+	}
+
+	pibyte* first_readout = acq.buffer + buffer_pos * geometry.readout_stride;
+	pi64s nb_written = 0;
+	for(pi64s i = 0;i < batch;++i,++nb_readouts)
+	  {
+	    if(acq.config.fail_after && nb_readouts >= acq.config.fail_after)
+	      {
+		connection_lost = true;
+		break;
+	      }
+	    if(acq.config.drop_every && !((nb_readouts + 1) % acq.config.drop_every))
+	      {
+		errors |= PicamAcquisitionErrorsMask_DataLost;
+		continue;
+	      }
+	    pibyte* readout = first_readout + nb_written * geometry.readout_stride;
+	    if(acq.config.fill_pixels)
+	      memcpy(readout,acq.pattern.data(),geometry.readout_stride);
+	    for(int f = 0;f < geometry.frames_per_readout;++f)
+	      {
+		pi64s frame_nb = nb_readouts * geometry.frames_per_readout + f;
+		pibyte* frame = readout + f * geometry.frame_stride;
+		// the frame number in the first pixel
+		frame[0] = pibyte(frame_nb & 0xff);
+		frame[1] = pibyte((frame_nb >> 8) & 0xff);
+
+		pibyte* metadata = frame + geometry.frame_size;
+		double exposure_start = frame_nb * frame_period;
+		if(acq.timestamps & PicamTimeStampsMask_ExposureStarted)
+		  {
+		    write_counter(metadata,(unsigned long long)
+				  (exposure_start * TIMESTAMP_RESOLUTION));
+		    metadata += 8;
+		  }
+		if(acq.timestamps & PicamTimeStampsMask_ExposureEnded)
+		  {
+		    write_counter(metadata,(unsigned long long)
+				  ((exposure_start + geometry.exposure_time) *
+				   TIMESTAMP_RESOLUTION));
+		    metadata += 8;
+		  }
+		if(acq.track_frames)
+		  write_counter(metadata,frame_nb + 1);
+	      }
+	    ++nb_written;
+	  }
+
+	bool last = connection_lost ||
+	  (acq.readout_count && nb_readouts >= acq.readout_count);
+	if(connection_lost)
+	  errors |= PicamAcquisitionErrorsMask_ConnectionLost;
+	if(last)
+	  camera->running = false;
+
+	PicamAvailableData available = {nb_written ? first_readout : NULL,nb_written};
+	PicamAcquisitionStatus status = {!last,PicamAcquisitionErrorsMask(errors),
+					 readout_rate};
+	std::vector<PicamAcquisitionUpdatedCallback> callbacks;
+	{
+	  std::lock_guard<std::mutex> lock(camera->lock);
+	  callbacks = camera->acquisition_cbs;
+	}
+	for(auto cb = callbacks.begin();cb != callbacks.end();++cb)
+	  (*cb)(camera,&available,&status);
+	errors = PicamAcquisitionErrorsMask_None;
+	if(last)
+	  return;
+
+	buffer_pos = (buffer_pos + nb_written) % acq.buffer_readouts;
+      }
+
+    // stopped (or no readout at all)
+    camera->running = false;
+    PicamAcquisitionStatus status = {false,PicamAcquisitionErrorsMask(errors),
+				     readout_rate};
+    std::vector<PicamAcquisitionUpdatedCallback> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(camera->lock);
+      callbacks = camera->acquisition_cbs;
+    }
+    for(auto cb = callbacks.begin();cb != callbacks.end();++cb)
+      (*cb)(camera,NULL,&status);
+  }
+
+  void join_generator(Camera& camera)
+  {
+    if(!camera.generator.joinable())
+      return;
+    if(camera.generator.get_id() == std::this_thread::get_id())
+      camera.generator.detach();
+    else
+      camera.generator.join();
+  }
+
+  /*-----------------------------------------------------------------------*/
+  /* Enumeration strings                                                   */
+  /*-----------------------------------------------------------------------*/
+  struct EnumString
+  {
+    piint value;
+    const char* string;
+  };
+
+#define ENUM_STRING(prefix,name) {prefix##_##name,#name}
+
+  const EnumString error_strings[] =
+    {ENUM_STRING(PicamError,None),
+     ENUM_STRING(PicamError,LibraryNotInitialized),
+     ENUM_STRING(PicamError,LibraryAlreadyInitialized),
+     ENUM_STRING(PicamError,InvalidEnumeratedType),
+     ENUM_STRING(PicamError,EnumerationValueNotDefined),
+     ENUM_STRING(PicamError,InvalidCameraID),
+     ENUM_STRING(PicamError,InvalidHandle),
+     ENUM_STRING(PicamError,CameraAlreadyOpened),
+     ENUM_STRING(PicamError,ParameterHasInvalidValueType),
+     ENUM_STRING(PicamError,ParameterDoesNotExist),
+     ENUM_STRING(PicamError,ParameterValueIsReadOnly),
+     ENUM_STRING(PicamError,InvalidParameterValue),
+     ENUM_STRING(PicamError,ParameterHasInvalidConstraintType),
+     ENUM_STRING(PicamError,ParametersNotCommitted),
+     ENUM_STRING(PicamError,InvalidAcquisitionBuffer),
+     ENUM_STRING(PicamError,AcquisitionInProgress),
+     ENUM_STRING(PicamError,UnexpectedNullPointer),
+     ENUM_STRING(PicamError,UnexpectedError),
+     {0,NULL}};
+
+  const EnumString model_strings[] =
+    {{PicamModel_PixisSeries,"PIXIS Series"},
+     {PicamModel_Pixis400B,"PIXIS: 400B (simulated)"},
+     {PicamModel_ProEMSeries,"ProEM Series"},
+     {0,NULL}};
+
+  const EnumString computer_interface_strings[] =
+    {{PicamComputerInterface_Usb2,"USB 2.0"},
+     {PicamComputerInterface_1394A,"IEEE 1394A"},
+     {PicamComputerInterface_GigabitEthernet,"Gigabit Ethernet"},
+     {PicamComputerInterface_Usb3,"USB 3.0"},
+     {0,NULL}};
+
+  const EnumString parameter_strings[] =
+    {ENUM_STRING(PicamParameter,ExposureTime),
+     ENUM_STRING(PicamParameter,ShutterTimingMode),
+     ENUM_STRING(PicamParameter,ShutterOpeningDelay),
+     ENUM_STRING(PicamParameter,ShutterClosingDelay),
+     ENUM_STRING(PicamParameter,ShutterDelayResolution),
+     ENUM_STRING(PicamParameter,GateTracking),
+     ENUM_STRING(PicamParameter,GateTrackingBitDepth),
+     ENUM_STRING(PicamParameter,AdcSpeed),
+     ENUM_STRING(PicamParameter,AdcQuality),
+     ENUM_STRING(PicamParameter,AdcAnalogGain),
+     ENUM_STRING(PicamParameter,ActiveWidth),
+     ENUM_STRING(PicamParameter,ActiveHeight),
+     ENUM_STRING(PicamParameter,PixelWidth),
+     ENUM_STRING(PicamParameter,PixelHeight),
+     ENUM_STRING(PicamParameter,ReadoutControlMode),
+     ENUM_STRING(PicamParameter,ReadoutTimeCalculation),
+     ENUM_STRING(PicamParameter,ReadoutPortCount),
+     ENUM_STRING(PicamParameter,FrameRateCalculation),
+     ENUM_STRING(PicamParameter,OnlineReadoutRateCalculation),
+     ENUM_STRING(PicamParameter,KineticsWindowHeight),
+     ENUM_STRING(PicamParameter,Rois),
+     ENUM_STRING(PicamParameter,TriggerSource),
+     ENUM_STRING(PicamParameter,TriggerResponse),
+     ENUM_STRING(PicamParameter,TriggerDetermination),
+     ENUM_STRING(PicamParameter,ReadoutCount),
+     ENUM_STRING(PicamParameter,TimeStamps),
+     ENUM_STRING(PicamParameter,TimeStampResolution),
+     ENUM_STRING(PicamParameter,TimeStampBitDepth),
+     ENUM_STRING(PicamParameter,TrackFrames),
+     ENUM_STRING(PicamParameter,FrameTrackingBitDepth),
+     ENUM_STRING(PicamParameter,FrameSize),
+     ENUM_STRING(PicamParameter,FrameStride),
+     ENUM_STRING(PicamParameter,FramesPerReadout),
+     ENUM_STRING(PicamParameter,ReadoutStride),
+     ENUM_STRING(PicamParameter,SensorTemperatureSetPoint),
+     ENUM_STRING(PicamParameter,SensorTemperatureReading),
+     {0,NULL}};
+
+#undef ENUM_STRING
+
+  const char* find_string(const EnumString* strings,piint value)
+  {
+    for(;strings->string;++strings)
+      if(strings->value == value)
+	return strings->string;
+    return NULL;
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+/* Library                                                                 */
+/*-------------------------------------------------------------------------*/
+PicamError PIL_CALL Picam_GetVersion(piint* major,piint* minor,
+				     piint* distribution,piint* released)
+{
+  if(major) *major = VERSION_MAJOR;
+  if(minor) *minor = VERSION_MINOR;
+  if(distribution) *distribution = VERSION_DISTRIBUTION;
+  if(released) *released = VERSION_RELEASED;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_IsLibraryInitialized(pibln* inited)
+{
+  if(!inited)
+    return PicamError_UnexpectedNullPointer;
+  *inited = is_initialized();
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_InitializeLibrary(void)
+{
+  std::lock_guard<std::mutex> lock(g_lock);
+  if(g_initialized)
+    return PicamError_LibraryAlreadyInitialized;
+  load_config();
+  g_initialized = true;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_UninitializeLibrary(void)
+{
+  std::set<Camera*> cameras;
+  {
+    std::lock_guard<std::mutex> lock(g_lock);
+    if(!g_initialized)
+      return PicamError_LibraryNotInitialized;
+    cameras.swap(g_cameras);
+    g_initialized = false;
+  }
+  for(auto camera : cameras)
+    {
+      {
+	std::lock_guard<std::mutex> lock(camera->lock);
+	camera->stop_request = true;
+      }
+      camera->stop_cond.notify_all();
+      join_generator(*camera);
+      delete camera;
+    }
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_DestroyString(const pichar* s)
+{
+  delete[] s;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetEnumerationString(PicamEnumeratedType type,piint value,
+					       const pichar** s)
+{
+  if(!s)
+    return PicamError_UnexpectedNullPointer;
+  const EnumString* strings;
+  switch(type)
+    {
+    case PicamEnumeratedType_Error: strings = error_strings; break;
+    case PicamEnumeratedType_Model: strings = model_strings; break;
+    case PicamEnumeratedType_ComputerInterface:
+      strings = computer_interface_strings; break;
+    case PicamEnumeratedType_Parameter: strings = parameter_strings; break;
+    default:
+      return PicamError_InvalidEnumeratedType;
+    }
+  const char* string = find_string(strings,value);
+  if(!string)
+    return PicamError_EnumerationValueNotDefined;
+  pichar* copy = new pichar[strlen(string) + 1];
+  strcpy(copy,string);
+  *s = copy;
+  return PicamError_None;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Camera identification                                                   */
+/*-------------------------------------------------------------------------*/
+PicamError PIL_CALL Picam_DestroyCameraIDs(const PicamCameraID* id_array)
+{
+  delete[] id_array;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetAvailableCameraIDs(const PicamCameraID** id_array,
+						piint* id_count)
+{
+  if(!id_array || !id_count)
+    return PicamError_UnexpectedNullPointer;
+  if(!is_initialized())
+    return PicamError_LibraryNotInitialized;
+  int nb_cameras = std::max(get_config().nb_cameras,0);
+  PicamCameraID* ids = new PicamCameraID[nb_cameras];
+  for(int i = 0;i < nb_cameras;++i)
+    make_id(i,ids[i]);
+  *id_array = ids;
+  *id_count = nb_cameras;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetCameraID(PicamHandle handle,PicamCameraID* id)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!id)
+    return PicamError_UnexpectedNullPointer;
+  *id = camera->id;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamAdvanced_OpenCameraDevice(const PicamCameraID* id,
+						   PicamHandle* device)
+{
+  if(!id || !device)
+    return PicamError_UnexpectedNullPointer;
+  PicamSimulatorConfig config = get_config();
+  std::lock_guard<std::mutex> lock(g_lock);
+  if(!g_initialized)
+    return PicamError_LibraryNotInitialized;
+
+  int index = -1;
+  for(int i = 0;i < config.nb_cameras && index < 0;++i)
+    {
+      pichar serial[PicamStringSize_SerialNumber];
+      make_serial(i,serial);
+      if(!strcmp(serial,id->serial_number))
+	index = i;
+    }
+  if(index < 0)
+    return PicamError_InvalidCameraID;
+  for(auto camera : g_cameras)
+    if(!strcmp(camera->id.serial_number,id->serial_number))
+      return PicamError_CameraAlreadyOpened;
+
+  Camera* camera = new Camera();
+  make_id(index,camera->id);
+  camera->buffer.memory = NULL;
+  camera->buffer.memory_size = 0;
+  camera->stop_request = false;
+  camera->running = false;
+  init_parameters(*camera,config);
+  g_cameras.insert(camera);
+  *device = camera;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamAdvanced_CloseCameraDevice(PicamHandle device)
+{
+  Camera* camera = get_camera(device);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  {
+    std::lock_guard<std::mutex> lock(g_lock);
+    g_cameras.erase(camera);
+  }
+  {
+    std::lock_guard<std::mutex> lock(camera->lock);
+    camera->stop_request = true;
+  }
+  camera->stop_cond.notify_all();
+  join_generator(*camera);
+  delete camera;
+  return PicamError_None;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Parameters                                                              */
+/*-------------------------------------------------------------------------*/
+PicamError PIL_CALL Picam_DestroyParameters(const PicamParameter* parameter_array)
+{
+  delete[] parameter_array;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameters(PicamHandle handle,
+					const PicamParameter** parameter_array,
+					piint* parameter_count)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!parameter_array || !parameter_count)
+    return PicamError_UnexpectedNullPointer;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  PicamParameter* parameters = new PicamParameter[camera->parameters.size() + 1];
+  piint count = 0;
+  for(auto i = camera->parameters.begin();i != camera->parameters.end();++i)
+    parameters[count++] = i->first;
+  parameters[count++] = PicamParameter_Rois;
+  *parameter_array = parameters;
+  *parameter_count = count;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_DoesParameterExist(PicamHandle handle,
+					     PicamParameter parameter,
+					     pibln* exists)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!exists)
+    return PicamError_UnexpectedNullPointer;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  *exists = (parameter == PicamParameter_Rois ||
+	     camera->parameters.count(parameter));
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterValueType(PicamHandle handle,
+						PicamParameter parameter,
+						PicamValueType* type)
+{
+  pibln exists;
+  PicamError error = Picam_DoesParameterExist(handle,parameter,&exists);
+  if(error != PicamError_None)
+    return error;
+  if(!exists)
+    return PicamError_ParameterDoesNotExist;
+  if(!type)
+    return PicamError_UnexpectedNullPointer;
+  *type = value_type(parameter);
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterValueAccess(PicamHandle handle,
+						  PicamParameter parameter,
+						  PicamValueAccess* access)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!access)
+    return PicamError_UnexpectedNullPointer;
+  if(parameter == PicamParameter_Rois)
+    {
+      *access = PicamValueAccess_ReadWrite;
+      return PicamError_None;
+    }
+  std::lock_guard<std::mutex> lock(camera->lock);
+  auto i = camera->parameters.find(parameter);
+  if(i == camera->parameters.end())
+    return PicamError_ParameterDoesNotExist;
+  *access = i->second.access;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterIntegerValue(PicamHandle handle,
+						   PicamParameter parameter,
+						   piint* value)
+{
+  if(!value)
+    return PicamError_UnexpectedNullPointer;
+  piflt v;
+  PicamError error = get_value(handle,parameter,true,PicamValueType_Integer,v);
+  if(error == PicamError_None)
+    *value = piint(v);
+  return error;
+}
+
+PicamError PIL_CALL Picam_SetParameterIntegerValue(PicamHandle handle,
+						   PicamParameter parameter,
+						   piint value)
+{
+  return set_value(handle,parameter,true,PicamValueType_Integer,value);
+}
+
+PicamError PIL_CALL Picam_CanSetParameterIntegerValue(PicamHandle handle,
+						      PicamParameter parameter,
+						      piint value,pibln* settable)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!settable)
+    return PicamError_UnexpectedNullPointer;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  Parameter* p;
+  PicamError error = find_parameter(*camera,parameter,true,
+				    PicamValueType_Integer,p);
+  if(error != PicamError_None)
+    return error;
+  *settable = (p->access != PicamValueAccess_ReadOnly &&
+	       check_value(*p,parameter,value) == PicamError_None);
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterLargeIntegerValue(PicamHandle handle,
+							PicamParameter parameter,
+							pi64s* value)
+{
+  if(!value)
+    return PicamError_UnexpectedNullPointer;
+  piflt v;
+  PicamError error = get_value(handle,parameter,false,
+			       PicamValueType_LargeInteger,v);
+  if(error == PicamError_None)
+    *value = pi64s(v);
+  return error;
+}
+
+PicamError PIL_CALL Picam_SetParameterLargeIntegerValue(PicamHandle handle,
+							PicamParameter parameter,
+							pi64s value)
+{
+  return set_value(handle,parameter,false,PicamValueType_LargeInteger,
+		   piflt(value));
+}
+
+PicamError PIL_CALL Picam_GetParameterFloatingPointValue(PicamHandle handle,
+							 PicamParameter parameter,
+							 piflt* value)
+{
+  if(!value)
+    return PicamError_UnexpectedNullPointer;
+  return get_value(handle,parameter,false,PicamValueType_FloatingPoint,*value);
+}
+
+PicamError PIL_CALL Picam_SetParameterFloatingPointValue(PicamHandle handle,
+							 PicamParameter parameter,
+							 piflt value)
+{
+  return set_value(handle,parameter,false,PicamValueType_FloatingPoint,value);
+}
+
+PicamError PIL_CALL Picam_ReadParameterFloatingPointValue(PicamHandle handle,
+							  PicamParameter parameter,
+							  piflt* value)
+{
+  if(!value)
+    return PicamError_UnexpectedNullPointer;
+  if(parameter == PicamParameter_SensorTemperatureReading)
+    parameter = PicamParameter_SensorTemperatureSetPoint;
+  return get_value(handle,parameter,false,PicamValueType_FloatingPoint,*value);
+}
+
+PicamError PIL_CALL Picam_SetParameterRoisValue(PicamHandle handle,
+						PicamParameter parameter,
+						const PicamRois* value)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!value)
+    return PicamError_UnexpectedNullPointer;
+  if(parameter != PicamParameter_Rois)
+    return value_type(parameter) == PicamValueType_Rois ?
+      PicamError_ParameterDoesNotExist : PicamError_ParameterHasInvalidValueType;
+  PicamSimulatorConfig config = get_config();
+  Changes changes;
+  {
+    std::lock_guard<std::mutex> lock(camera->lock);
+    if(camera->running)
+      return PicamError_AcquisitionInProgress;
+    PicamError error = validate_rois(*camera,*value);
+    if(error != PicamError_None)
+      return error;
+    camera->rois.assign(value->roi_array,value->roi_array + value->roi_count);
+    camera->committed = false;
+    update_calculations(*camera,config,changes);
+  }
+  notify(*camera,changes);
+  return PicamError_None;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Parameter constraints                                                   */
+/*-------------------------------------------------------------------------*/
+PicamError PIL_CALL Picam_DestroyCollectionConstraints(const PicamCollectionConstraint* constraint_array)
+{
+  free(const_cast<PicamCollectionConstraint*>(constraint_array));
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterCollectionConstraint(PicamHandle handle,
+							   PicamParameter parameter,
+							   PicamConstraintCategory,
+							   const PicamCollectionConstraint** constraint)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!constraint)
+    return PicamError_UnexpectedNullPointer;
+  if(constraint_type(parameter) != PicamConstraintType_Collection)
+    return PicamError_ParameterHasInvalidConstraintType;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  auto i = camera->parameters.find(parameter);
+  if(i == camera->parameters.end())
+    return PicamError_ParameterDoesNotExist;
+  const std::vector<piflt>& values = i->second.collection;
+  PicamCollectionConstraint* c =
+    alloc_constraint<PicamCollectionConstraint>(values.size() * sizeof(piflt));
+  piflt* values_array = reinterpret_cast<piflt*>(c + 1);
+  std::copy(values.begin(),values.end(),values_array);
+  c->scope = PicamConstraintScope_Independent;
+  c->severity = PicamConstraintSeverity_Error;
+  c->values_array = values_array;
+  c->values_count = piint(values.size());
+  *constraint = c;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_DestroyRangeConstraints(const PicamRangeConstraint* constraint_array)
+{
+  free(const_cast<PicamRangeConstraint*>(constraint_array));
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterRangeConstraint(PicamHandle handle,
+						      PicamParameter parameter,
+						      PicamConstraintCategory,
+						      const PicamRangeConstraint** constraint)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!constraint)
+    return PicamError_UnexpectedNullPointer;
+  if(constraint_type(parameter) != PicamConstraintType_Range)
+    return PicamError_ParameterHasInvalidConstraintType;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  auto i = camera->parameters.find(parameter);
+  if(i == camera->parameters.end())
+    return PicamError_ParameterDoesNotExist;
+  PicamRangeConstraint* c = alloc_constraint<PicamRangeConstraint>(0);
+  fill_range(i->second,*c);
+  *constraint = c;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_DestroyRoisConstraints(const PicamRoisConstraint* constraint_array)
+{
+  free(const_cast<PicamRoisConstraint*>(constraint_array));
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_GetParameterRoisConstraint(PicamHandle handle,
+						     PicamParameter parameter,
+						     PicamConstraintCategory,
+						     const PicamRoisConstraint** constraint)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!constraint)
+    return PicamError_UnexpectedNullPointer;
+  if(parameter != PicamParameter_Rois)
+    return PicamError_ParameterHasInvalidConstraintType;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  int width = int(value(*camera,PicamParameter_ActiveWidth));
+  int height = int(value(*camera,PicamParameter_ActiveHeight));
+  PicamRoisConstraint* c = alloc_constraint<PicamRoisConstraint>(0);
+  c->scope = PicamConstraintScope_Independent;
+  c->severity = PicamConstraintSeverity_Error;
+  c->empty_set = false;
+  c->rules = PicamRoisConstraintRulesMask_None;
+  c->maximum_roi_count = MAX_ROI_COUNT;
+
+  Parameter axis;
+  axis.increment = 1.;
+  axis.minimum = 0.,axis.maximum = width - 1;
+  fill_range(axis,c->x_constraint);
+  axis.minimum = 1.,axis.maximum = width;
+  fill_range(axis,c->width_constraint);
+  axis.minimum = 0.,axis.maximum = height - 1;
+  fill_range(axis,c->y_constraint);
+  axis.minimum = 1.,axis.maximum = height;
+  fill_range(axis,c->height_constraint);
+  // no binning limits, any binning dividing the roi size
+  c->x_binning_limits_array = c->y_binning_limits_array = NULL;
+  c->x_binning_limits_count = c->y_binning_limits_count = 0;
+  *constraint = c;
+  return PicamError_None;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Commit and acquisition                                                  */
+/*-------------------------------------------------------------------------*/
+PicamError PIL_CALL Picam_AreParametersCommitted(PicamHandle handle,pibln* committed)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!committed)
+    return PicamError_UnexpectedNullPointer;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  *committed = camera->committed;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_CommitParameters(PicamHandle handle,
+					   const PicamParameter** failed_parameter_array,
+					   piint* failed_parameter_count)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!failed_parameter_array || !failed_parameter_count)
+    return PicamError_UnexpectedNullPointer;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  if(camera->running)
+    return PicamError_AcquisitionInProgress;
+
+  std::vector<PicamParameter> failed;
+  validate_parameters(*camera,failed);
+  if(failed.empty())
+    {
+      camera->committed = true;
+      *failed_parameter_array = NULL;
+      *failed_parameter_count = 0;
+    }
+  else
+    {
+      PicamParameter* failed_array = new PicamParameter[failed.size()];
+      std::copy(failed.begin(),failed.end(),failed_array);
+      *failed_parameter_array = failed_array;
+      *failed_parameter_count = piint(failed.size());
+    }
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_StartAcquisition(PicamHandle handle)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+
+  {
+    std::lock_guard<std::mutex> lock(camera->lock);
+    if(camera->running)
+      return PicamError_AcquisitionInProgress;
+  }
+  // the previous generator has sent its last callback, it is joined
+  // without the lock it may still take
+  join_generator(*camera);
+
+  Acquisition acq;
+  acq.config = get_config();
+  std::lock_guard<std::mutex> lock(camera->lock);
+  if(camera->running)
+    return PicamError_AcquisitionInProgress;
+  if(!camera->committed)
+    return PicamError_ParametersNotCommitted;
+  compute_geometry(*camera,acq.config,acq.geometry);
+  acq.readout_count = pi64s(value(*camera,PicamParameter_ReadoutCount));
+  acq.timestamps = int(value(*camera,PicamParameter_TimeStamps));
+  acq.track_frames = value(*camera,PicamParameter_TrackFrames) != 0.;
+
+  const Geometry& geometry = acq.geometry;
+  if(camera->buffer.memory)
+    {
+      acq.buffer = static_cast<pibyte*>(camera->buffer.memory);
+      acq.buffer_readouts = camera->buffer.memory_size / geometry.readout_stride;
+    }
+  else
+    {
+      acq.buffer_readouts = std::max(2 * acq.config.readouts_per_callback,
+				     MIN_INTERNAL_READOUTS);
+      camera->internal_buffer.resize(size_t(acq.buffer_readouts) *
+				     geometry.readout_stride);
+      acq.buffer = camera->internal_buffer.data();
+    }
+  if(acq.buffer_readouts < 1)
+    return PicamError_InvalidAcquisitionBuffer;
+
+  // a gradient per frame, the first pixel is the frame number
+  acq.pattern.assign(geometry.readout_stride,0);
+  for(int f = 0;f < geometry.frames_per_readout;++f)
+    {
+      pibyte* frame = acq.pattern.data() + f * geometry.frame_stride;
+      for(int i = 0;i < geometry.frame_pixels;++i)
+	{
+	  int pixel = 100 + (i % 4000);
+	  frame[2 * i] = pibyte(pixel & 0xff);
+	  frame[2 * i + 1] = pibyte(pixel >> 8);
+	}
+    }
+
+  camera->stop_request = false;
+  camera->running = true;
+  camera->generator = std::thread(generate,camera,std::move(acq));
+  return PicamError_None;
+}
+
+PicamError PIL_CALL Picam_StopAcquisition(PicamHandle handle)
+{
+  Camera* camera = get_camera(handle);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  {
+    std::lock_guard<std::mutex> lock(camera->lock);
+    if(!camera->running)
+      return PicamError_None;
+    camera->stop_request = true;
+  }
+  camera->stop_cond.notify_all();
+  return PicamError_None;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Advanced                                                                */
+/*-------------------------------------------------------------------------*/
+/** @brief the simulated device holds its parameters, it is its own model
+ */
+PicamError PIL_CALL PicamAdvanced_GetCameraModel(PicamHandle device,
+						 PicamHandle* model)
+{
+  if(!get_camera(device))
+    return PicamError_InvalidHandle;
+  if(!model)
+    return PicamError_UnexpectedNullPointer;
+  *model = device;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamAdvanced_CommitParametersToCameraDevice(PicamHandle model)
+{
+  Camera* camera = get_camera(model);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  if(camera->running)
+    return PicamError_AcquisitionInProgress;
+
+  std::vector<PicamParameter> failed;
+  validate_parameters(*camera,failed);
+  if(!failed.empty())
+    return PicamError_InvalidParameterValue;
+  camera->committed = true;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamAdvanced_RegisterForIntegerValueChanged(PicamHandle camera,
+								 PicamParameter parameter,
+								 PicamIntegerValueChangedCallback changed)
+{
+  return register_callback(camera,parameter,true,PicamValueType_Integer,
+			   changed,&Camera::integer_cbs,true);
+}
+
+PicamError PIL_CALL PicamAdvanced_UnregisterForIntegerValueChanged(PicamHandle camera,
+								   PicamParameter parameter,
+								   PicamIntegerValueChangedCallback changed)
+{
+  return register_callback(camera,parameter,true,PicamValueType_Integer,
+			   changed,&Camera::integer_cbs,false);
+}
+
+PicamError PIL_CALL PicamAdvanced_RegisterForLargeIntegerValueChanged(PicamHandle camera,
+								      PicamParameter parameter,
+								      PicamLargeIntegerValueChangedCallback changed)
+{
+  return register_callback(camera,parameter,false,PicamValueType_LargeInteger,
+			   changed,&Camera::large_integer_cbs,true);
+}
+
+PicamError PIL_CALL PicamAdvanced_UnregisterForLargeIntegerValueChanged(PicamHandle camera,
+									PicamParameter parameter,
+									PicamLargeIntegerValueChangedCallback changed)
+{
+  return register_callback(camera,parameter,false,PicamValueType_LargeInteger,
+			   changed,&Camera::large_integer_cbs,false);
+}
+
+PicamError PIL_CALL PicamAdvanced_RegisterForFloatingPointValueChanged(PicamHandle camera,
+								       PicamParameter parameter,
+								       PicamFloatingPointValueChangedCallback changed)
+{
+  return register_callback(camera,parameter,false,PicamValueType_FloatingPoint,
+			   changed,&Camera::floating_point_cbs,true);
+}
+
+PicamError PIL_CALL PicamAdvanced_UnregisterForFloatingPointValueChanged(PicamHandle camera,
+									 PicamParameter parameter,
+									 PicamFloatingPointValueChangedCallback changed)
+{
+  return register_callback(camera,parameter,false,PicamValueType_FloatingPoint,
+			   changed,&Camera::floating_point_cbs,false);
+}
+
+PicamError PIL_CALL PicamAdvanced_SetAcquisitionBuffer(PicamHandle device,
+						       const PicamAcquisitionBuffer* buffer)
+{
+  Camera* camera = get_camera(device);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  if(camera->running)
+    return PicamError_AcquisitionInProgress;
+  if(buffer && buffer->memory && buffer->memory_size <= 0)
+    return PicamError_InvalidAcquisitionBuffer;
+  // no buffer, the library allocates one
+  if(buffer && buffer->memory)
+    camera->buffer = *buffer;
+  else
+    camera->buffer.memory = NULL,camera->buffer.memory_size = 0;
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamAdvanced_RegisterForAcquisitionUpdated(PicamHandle device,
+								PicamAcquisitionUpdatedCallback updated)
+{
+  Camera* camera = get_camera(device);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  if(!updated)
+    return PicamError_UnexpectedNullPointer;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  camera->acquisition_cbs.push_back(updated);
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamAdvanced_UnregisterForAcquisitionUpdated(PicamHandle device,
+								  PicamAcquisitionUpdatedCallback updated)
+{
+  Camera* camera = get_camera(device);
+  if(!camera)
+    return PicamError_InvalidHandle;
+  std::lock_guard<std::mutex> lock(camera->lock);
+  auto& callbacks = camera->acquisition_cbs;
+  auto i = std::find(callbacks.begin(),callbacks.end(),updated);
+  if(i == callbacks.end())
+    return PicamError_InvalidParameterValue;
+  callbacks.erase(i);
+  return PicamError_None;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Simulator configuration                                                 */
+/*-------------------------------------------------------------------------*/
+PicamError PIL_CALL PicamSimulator_GetConfig(PicamSimulatorConfig* config)
+{
+  if(!config)
+    return PicamError_UnexpectedNullPointer;
+  *config = get_config();
+  return PicamError_None;
+}
+
+PicamError PIL_CALL PicamSimulator_SetConfig(const PicamSimulatorConfig* config)
+{
+  if(!config)
+    return PicamError_UnexpectedNullPointer;
+  if(config->nb_cameras < 0 || config->width < 1 || config->height < 1 ||
+     config->frame_rate < 0. || config->readouts_per_callback < 1 ||
+     config->drop_every < 0 || config->fail_after < 0)
+    return PicamError_InvalidParameterValue;
+  std::lock_guard<std::mutex> lock(g_lock);
+  g_config = *config;
+  g_config_loaded = true;
+  return PicamError_None;
+}
@@ -0,0 +1,78 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "lima/Exceptions.h"
+#include "PrincetonAccumulator.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+AccumulationStage::AccumulationStage(bool first) :
+  m_first(first),
+  m_nb_pixels(0),
+  m_saturation(0),
+  m_kernels(getPixelKernels())
+{
+}
+
+void AccumulationStage::setup(size_t nb_pixels,int saturation)
+{
+  m_nb_pixels = nb_pixels;
+  m_saturation = uint16_t(saturation);
+}
+
+void AccumulationStage::processPixels(void* dst,const void* src,
+				      size_t first,size_t nb_pixels) const
+{
+  uint32_t* sum = (uint32_t*)dst + first;
+  const uint16_t* frame = (const uint16_t*)src + first;
+  if(m_saturation)
+    {
+      if(m_first)
+	m_kernels.widen_store_masked(sum,frame,nb_pixels,m_saturation);
+      else
+	m_kernels.widen_add_masked(sum,frame,nb_pixels,m_saturation);
+    }
+  else if(m_first)
+    m_kernels.widen_store(sum,frame,nb_pixels);
+  else
+    m_kernels.widen_add(sum,frame,nb_pixels);
+}
+
+FrameAccumulator::FrameAccumulator() :
+  m_first(true),
+  m_next(false)
+{
+  DEB_CONSTRUCTOR();
+  DEB_TRACE() << "Accumulation kernel: " << getPixelKernels().name;
+}
+
+void FrameAccumulator::setup(size_t nb_pixels,int saturation)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(nb_pixels,saturation);
+  if(saturation < 0 || saturation > 0xffff)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(saturation);
+  m_first.setup(nb_pixels,saturation);
+  m_next.setup(nb_pixels,saturation);
+}
@@ -0,0 +1,77 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONACCUMULATOR_H
+#define PRINCETONACCUMULATOR_H
+
+#include "lima/Debug.h"
+#include "PrincetonFrameCopy.h"
+#include "PrincetonPixelKernels.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** One step of a 32 bits frame sum: the first frame of the sum is
+     *	widened in the destination, the next ones are added to it.
+     */
+    class AccumulationStage : public FrameProcessor
+    {
+    public:
+      explicit AccumulationStage(bool first);
+
+      void setup(size_t nb_pixels,int saturation);
+
+      virtual void process(void* dst,const void* src) const
+      {processPixels(dst,src,0,m_nb_pixels);}
+      virtual bool isPixelWise() const {return true;}
+      virtual void processPixels(void* dst,const void* src,
+				 size_t first,size_t nb_pixels) const;
+    private:
+      bool			m_first;
+      size_t			m_nb_pixels;
+      uint16_t			m_saturation; // 0 without masking
+      const PixelKernels&	m_kernels;
+    };
+
+    /** Sums nb_frames hardware frames of 16 bits in one 32 bits frame.
+     *	With saturation masking, a pixel which reached the saturation
+     *	level in one of the frames is SATURATED_SUM in the sum.
+     */
+    class FrameAccumulator
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"FrameAccumulator","Princeton");
+    public:
+      FrameAccumulator();
+
+      void setup(size_t nb_pixels,int saturation);
+      const FrameProcessor* getStage(int frame_in_sum) const
+      {return frame_in_sum ? &m_next : &m_first;}
+    private:
+      AccumulationStage	m_first;
+      AccumulationStage	m_next;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONACCUMULATOR_H
@@ -22,32 +22,30 @@
 
 #include "PrincetonBinCtrlObj.h"
 #include "PrincetonException.h"
+#include "PrincetonRoiSolver.h"
 
 using namespace lima;
 using namespace lima::Princeton;
 
-BinCtrlObj::BinCtrlObj(PicamHandle cam):
-  m_cam(cam)
+BinCtrlObj::BinCtrlObj(PicamHandle cam,RoiSolver& solver):
+  m_cam(cam),
+  m_solver(solver),
+  m_track_mode(false)
 {
   DEB_CONSTRUCTOR();
-  const PicamRoisConstraint  *constraint;
-  CHECK_PICAM(Picam_GetParameterRoisConstraint(m_cam, 
-					       PicamParameter_Rois, 
-					       PicamConstraintCategory_Required, 
-					       &constraint));
-  for( piint i = 0; i < constraint->x_binning_limits_count; ++i )
-    m_possible_xbin.push_back(constraint->x_binning_limits_array[i]);
-  for( piint i = 0; i < constraint->y_binning_limits_count; ++i )
-    m_possible_ybin.push_back(constraint->y_binning_limits_array[i]);
-  Picam_DestroyRoisConstraints(constraint);
 }
 
 BinCtrlObj::~BinCtrlObj()
 {
 }
 
+/** @brief binning is written to the camera with the roi
+ *  by RoiCtrlObj::setRoi, which Lima always calls after setBin.
+ */
 void BinCtrlObj::setBin(const Bin& bin)
 {
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(bin);
   m_bin = bin;
 }
 void BinCtrlObj::getBin(Bin& bin)
@@ -56,25 +54,8 @@ void BinCtrlObj::getBin(Bin& bin)
 }
 void BinCtrlObj::checkBin(Bin& bin)
 {
-  int x_bin = 1;
-  int y_bin = 1;
-  int request_xbin = bin.getX();
-  int request_ybin = bin.getY();
-
-  if(!m_possible_xbin.empty())
-    {
-      for(auto poss_xbin = m_possible_xbin.begin();
-	  poss_xbin != m_possible_xbin.end() && request_ybin >= *poss_xbin;
-	  ++poss_xbin)
-	x_bin = *poss_xbin;
-    }
-
-    if(!m_possible_ybin.empty())
-    {
-      for(auto poss_ybin = m_possible_ybin.begin();
-	  poss_ybin != m_possible_ybin.end() && request_ybin >= *poss_ybin;
-	  ++poss_ybin)
-	y_bin = *poss_ybin;
-    }
-    bin = Bin(x_bin,y_bin);
+  if(m_track_mode)
+    bin = Bin(1,1);
+  else
+    m_solver.checkBin(bin);
 }
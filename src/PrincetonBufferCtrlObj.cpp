@@ -0,0 +1,301 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "PrincetonBufferCtrlObj.h"
+#include "PrincetonException.h"
+#include "PrincetonMemory.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+ContiguousBufferAllocMgr::ContiguousBufferAllocMgr() :
+  m_nb_buffers(0),
+  m_requested_stride(0),
+  m_frame_stride(0),
+  m_memory(new AcqMemory()),
+  m_options(new AcqMemoryOptions())
+{
+}
+
+ContiguousBufferAllocMgr::~ContiguousBufferAllocMgr()
+{
+  releaseBuffers();
+  delete m_memory;
+  delete m_options;
+}
+
+int ContiguousBufferAllocMgr::getMaxNbBuffers(const FrameDim& frame_dim)
+{
+  DEB_MEMBER_FUNCT();
+  long frame_stride = _getFrameStride(frame_dim);
+  long long max_mem = (long long)GetDefMaxNbBuffers(frame_dim) * frame_dim.getMemSize();
+  int max_nb_buffers = frame_stride ? int(max_mem / frame_stride) : 0;
+  DEB_RETURN() << DEB_VAR1(max_nb_buffers);
+  return max_nb_buffers;
+}
+
+void ContiguousBufferAllocMgr::allocBuffers(int nb_buffers,const FrameDim& frame_dim)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(nb_buffers,frame_dim);
+
+  long frame_stride = _getFrameStride(frame_dim);
+  if(m_memory->getMemory() && nb_buffers == m_nb_buffers &&
+     frame_dim == m_frame_dim && frame_stride == m_frame_stride)
+    return;
+
+  releaseBuffers();
+  long long memory_size = (long long)frame_stride * nb_buffers;
+  if(memory_size <= 0)
+    THROW_HW_ERROR(InvalidValue) << "Invalid buffer size: "
+				 << DEB_VAR2(nb_buffers,frame_stride);
+  m_memory->allocate(memory_size,*m_options);
+
+  m_nb_buffers = nb_buffers;
+  m_frame_dim = frame_dim;
+  m_frame_stride = frame_stride;
+}
+
+const FrameDim& ContiguousBufferAllocMgr::getFrameDim()
+{
+  return m_frame_dim;
+}
+
+void ContiguousBufferAllocMgr::getNbBuffers(int& nb_buffers)
+{
+  nb_buffers = m_nb_buffers;
+}
+
+void ContiguousBufferAllocMgr::releaseBuffers()
+{
+  m_memory->release();
+  m_nb_buffers = 0;
+  m_frame_stride = 0;
+}
+
+void* ContiguousBufferAllocMgr::getBufferPtr(int buffer_nb)
+{
+  DEB_MEMBER_FUNCT();
+  if(buffer_nb < 0 || buffer_nb >= m_nb_buffers)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR2(buffer_nb,m_nb_buffers);
+  return (char*)m_memory->getMemory() + m_frame_stride * buffer_nb;
+}
+
+void ContiguousBufferAllocMgr::setFrameStride(long frame_stride)
+{
+  m_requested_stride = frame_stride;
+}
+
+/** @brief new options are used at the next allocation
+ */
+void ContiguousBufferAllocMgr::setAllocOptions(const AcqMemoryOptions& options)
+{
+  *m_options = options;
+  // force reallocation
+  m_frame_dim = FrameDim();
+}
+
+void* ContiguousBufferAllocMgr::getMemory() const
+{
+  return m_memory->getMemory();
+}
+
+long ContiguousBufferAllocMgr::getFrameStride() const
+{
+  return m_frame_stride;
+}
+
+long ContiguousBufferAllocMgr::_getFrameStride(const FrameDim& frame_dim) const
+{
+  long frame_size = frame_dim.getMemSize();
+  return m_requested_stride > frame_size ? m_requested_stride : frame_size;
+}
+
+void BufferReleaseTracker::map(void* address)
+{
+  AutoMutex lock(m_lock);
+  ++m_mapped[address];
+}
+
+void BufferReleaseTracker::release(void* address)
+{
+  AutoMutex lock(m_lock);
+  auto i = m_mapped.find(address);
+  if(i != m_mapped.end() && !--i->second)
+    m_mapped.erase(i);
+}
+
+void BufferReleaseTracker::releaseAll()
+{
+  AutoMutex lock(m_lock);
+  m_mapped.clear();
+}
+
+bool BufferReleaseTracker::isMapped(void* address) const
+{
+  AutoMutex lock(m_lock);
+  return m_mapped.find(address) != m_mapped.end();
+}
+
+BufferCtrlObj::BufferCtrlObj(PicamHandle cam) :
+  m_cam(cam),
+  m_zero_copy(false),
+  m_cb_mgr(m_alloc_mgr),
+  m_mgr(m_cb_mgr)
+{
+  DEB_CONSTRUCTOR();
+}
+
+BufferCtrlObj::~BufferCtrlObj()
+{
+  DEB_DESTRUCTOR();
+}
+
+void BufferCtrlObj::setFrameDim(const FrameDim& frame_dim)
+{
+  _updateFrameStride();
+  m_mgr.setFrameDim(frame_dim);
+}
+
+void BufferCtrlObj::getFrameDim(FrameDim& frame_dim)
+{
+  m_mgr.getFrameDim(frame_dim);
+}
+
+void BufferCtrlObj::setNbBuffers(int nb_buffers)
+{
+  _updateFrameStride();
+  m_mgr.setNbBuffers(nb_buffers);
+}
+
+void BufferCtrlObj::getNbBuffers(int& nb_buffers)
+{
+  m_mgr.getNbBuffers(nb_buffers);
+}
+
+void BufferCtrlObj::setNbConcatFrames(int nb_concat_frames)
+{
+  m_mgr.setNbConcatFrames(nb_concat_frames);
+}
+
+void BufferCtrlObj::getNbConcatFrames(int& nb_concat_frames)
+{
+  m_mgr.getNbConcatFrames(nb_concat_frames);
+}
+
+void BufferCtrlObj::getMaxNbBuffers(int& max_nb_buffers)
+{
+  _updateFrameStride();
+  m_mgr.getMaxNbBuffers(max_nb_buffers);
+}
+
+void* BufferCtrlObj::getBufferPtr(int buffer_nb,int concat_frame_nb)
+{
+  return m_mgr.getBufferPtr(buffer_nb,concat_frame_nb);
+}
+
+void* BufferCtrlObj::getFramePtr(int acq_frame_nb)
+{
+  return m_mgr.getFramePtr(acq_frame_nb);
+}
+
+void BufferCtrlObj::getStartTimestamp(Timestamp& start_ts)
+{
+  m_mgr.getStartTimestamp(start_ts);
+}
+
+void BufferCtrlObj::getFrameInfo(int acq_frame_nb,HwFrameInfoType& info)
+{
+  m_mgr.getFrameInfo(acq_frame_nb,info);
+}
+
+void BufferCtrlObj::registerFrameCallback(HwFrameCallback& frame_cb)
+{
+  m_mgr.registerFrameCallback(frame_cb);
+}
+
+void BufferCtrlObj::unregisterFrameCallback(HwFrameCallback& frame_cb)
+{
+  m_mgr.unregisterFrameCallback(frame_cb);
+}
+
+/** @brief Lima maps a buffer while it uses its frame
+ */
+HwBufferCtrlObj::Callback* BufferCtrlObj::getBufferCallback()
+{
+  return &m_release_tracker;
+}
+
+void BufferCtrlObj::setZeroCopy(bool flag)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(flag);
+  m_zero_copy = flag;
+  if(!m_zero_copy)
+    m_alloc_mgr.setFrameStride(0);
+}
+
+bool BufferCtrlObj::canUseInPlace(long readout_stride,int frames_per_readout)
+{
+  DEB_MEMBER_FUNCT();
+  int nb_buffers,nb_concat_frames;
+  m_mgr.getNbBuffers(nb_buffers);
+  m_mgr.getNbConcatFrames(nb_concat_frames);
+
+  bool in_place = (m_zero_copy && m_alloc_mgr.getMemory() &&
+		   frames_per_readout == 1 && nb_concat_frames == 1 &&
+		   nb_buffers >= 2 &&
+		   m_alloc_mgr.getFrameStride() == readout_stride);
+  DEB_RETURN() << DEB_VAR1(in_place);
+  return in_place;
+}
+
+void BufferCtrlObj::getAcquisitionBuffer(void*& memory,long& memory_size) const
+{
+  memory = m_alloc_mgr.getMemory();
+  memory_size = m_alloc_mgr.getMemorySize();
+}
+
+void BufferCtrlObj::setAllocOptions(const AcqMemoryOptions& options)
+{
+  m_alloc_mgr.setAllocOptions(options);
+}
+
+/** @brief ask PICam for the readout stride so that Lima buffers
+ *  are allocated with the layout of the camera readouts.
+ *  Only a single frame per readout can be mapped on Lima buffers.
+ */
+void BufferCtrlObj::_updateFrameStride()
+{
+  DEB_MEMBER_FUNCT();
+  if(!m_zero_copy) return;
+
+  piint readout_stride,frames_per_readout;
+  CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,PicamParameter_ReadoutStride,
+					     &readout_stride));
+  CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,PicamParameter_FramesPerReadout,
+					     &frames_per_readout));
+  long frame_stride = frames_per_readout == 1 ? readout_stride : 0;
+  DEB_TRACE() << DEB_VAR3(readout_stride,frames_per_readout,frame_stride);
+  m_alloc_mgr.setFrameStride(frame_stride);
+}
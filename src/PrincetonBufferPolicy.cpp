@@ -0,0 +1,146 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include <cmath>
+
+#include "lima/Exceptions.h"
+#include "PrincetonBufferPolicy.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+static const double DEFAULT_TARGET_TIME = 3.;		// seconds
+static const long long DEFAULT_MEMORY_CAP = 2LL << 30;	// 2 GB
+static const long long MIN_READOUTS = 2;
+// occupancy ratio considered as close to an overrun
+static const double OVERRUN_THRESHOLD = .8;
+static const double MAX_GROW_FACTOR = 64.;
+
+BufferSizingPolicy::BufferSizingPolicy() :
+  m_target_time(DEFAULT_TARGET_TIME),
+  m_memory_cap(DEFAULT_MEMORY_CAP),
+  m_auto_grow(true),
+  m_grow_factor(1.),
+  m_readout_rate(0.),
+  m_readout_stride(0),
+  m_peak_occupancy(0.),
+  m_drain_rate(0.),
+  m_recommended_readouts(0),
+  m_nb_overruns(0)
+{
+}
+
+void BufferSizingPolicy::setTargetTime(double target_time)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(target_time);
+  if(target_time <= 0.)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(target_time);
+  m_target_time = target_time;
+  m_grow_factor = 1.;
+}
+
+void BufferSizingPolicy::setMemoryCap(long long memory_cap)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(memory_cap);
+  if(memory_cap <= 0)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(memory_cap);
+  m_memory_cap = memory_cap;
+}
+
+long long BufferSizingPolicy::computeReadouts(double readout_rate,
+					      long long readout_stride)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(readout_rate,readout_stride);
+
+  // Growth learnt on another configuration doesn't apply
+  if(readout_stride != m_readout_stride ||
+     std::fabs(readout_rate - m_readout_rate) > 1e-3 * readout_rate)
+    m_grow_factor = 1.;
+  m_readout_rate = readout_rate;
+  m_readout_stride = readout_stride;
+
+  double readouts = std::ceil(m_target_time * readout_rate * m_grow_factor);
+  // A consumer slower than the camera fills the buffer, give it room
+  if(m_drain_rate > 0. && m_drain_rate < readout_rate)
+    {
+      DEB_WARNING() << "Consumer drain rate (" << m_drain_rate
+		    << " readout/s) is below camera readout rate ("
+		    << readout_rate << " readout/s)";
+      readouts *= readout_rate / m_drain_rate;
+    }
+
+  long long max_readouts = std::max(m_memory_cap / std::max(readout_stride,1LL),
+				    MIN_READOUTS);
+  long long nb_readouts = std::min(std::max((long long)readouts,MIN_READOUTS),
+				   max_readouts);
+  if(nb_readouts == max_readouts && readouts > max_readouts)
+    DEB_WARNING() << "Acquisition buffer limited by memory cap to "
+		  << nb_readouts << " readouts ("
+		  << nb_readouts / std::max(readout_rate,1e-9) << " s)";
+
+  DEB_RETURN() << DEB_VAR1(nb_readouts);
+  return nb_readouts;
+}
+
+void BufferSizingPolicy::acquisitionDone(long long buffer_readouts,
+					 long long peak_readouts,
+					 long long nb_readouts,
+					 double busy_time,
+					 long long nb_overruns)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR5(buffer_readouts,peak_readouts,nb_readouts,busy_time,
+			  nb_overruns);
+
+  if(buffer_readouts <= 0) return;
+
+  m_nb_overruns = nb_overruns;
+  if(nb_overruns)
+    DEB_ERROR() << "Acquisition buffer overrun " << nb_overruns
+		<< " time(s), readouts were overwritten before being read";
+  m_peak_occupancy = double(peak_readouts) / buffer_readouts;
+  if(nb_readouts > 0 && busy_time > 0.)
+    m_drain_rate = nb_readouts / busy_time;
+
+  m_recommended_readouts = buffer_readouts;
+  if(m_peak_occupancy >= OVERRUN_THRESHOLD)
+    {
+      m_recommended_readouts = (long long)std::ceil(peak_readouts / OVERRUN_THRESHOLD * 2.);
+      if(m_auto_grow && m_grow_factor < MAX_GROW_FACTOR)
+	{
+	  m_grow_factor *= 2.;
+	  DEB_WARNING() << "Acquisition buffer peak occupancy " << m_peak_occupancy * 100.
+			<< "%, grow buffer for next acquisition ("
+			<< DEB_VAR1(m_grow_factor) << ")";
+	}
+      else
+	DEB_WARNING() << "Acquisition buffer peak occupancy " << m_peak_occupancy * 100.
+		      << "%, recommended buffer: " << m_recommended_readouts
+		      << " readouts";
+    }
+  DEB_TRACE() << DEB_VAR3(m_peak_occupancy,m_drain_rate,m_recommended_readouts);
+}
@@ -0,0 +1,80 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONBUFFERPOLICY_H
+#define PRINCETONBUFFERPOLICY_H
+
+#include "lima/Debug.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Size the PICam circular buffer (in readouts).
+     *	The buffer holds target_time seconds of readouts at the online
+     *	readout rate, bounded by a memory cap. After each acquisition the
+     *	peak occupancy is checked and, when it came close to an overrun,
+     *	the buffer is grown for the next acquisition (auto grow) or a
+     *	bigger size is recommended.
+     */
+    class BufferSizingPolicy
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"BufferSizingPolicy","Princeton");
+    public:
+      BufferSizingPolicy();
+
+      void setTargetTime(double target_time);
+      double getTargetTime() const {return m_target_time;}
+      void setMemoryCap(long long memory_cap);
+      long long getMemoryCap() const {return m_memory_cap;}
+      void setAutoGrow(bool flag) {m_auto_grow = flag;}
+      bool getAutoGrow() const {return m_auto_grow;}
+
+      /// number of readouts of the next acquisition buffer
+      long long computeReadouts(double readout_rate,long long readout_stride);
+
+      /// consumer statistics of one acquisition
+      void acquisitionDone(long long buffer_readouts,long long peak_readouts,
+			   long long nb_readouts,double busy_time,
+			   long long nb_overruns);
+
+      double getPeakOccupancy() const {return m_peak_occupancy;}
+      double getDrainRate() const {return m_drain_rate;}
+      long long getNbOverruns() const {return m_nb_overruns;}
+      long long getRecommendedReadouts() const {return m_recommended_readouts;}
+    private:
+      double	m_target_time;
+      long long	m_memory_cap;
+      bool	m_auto_grow;
+      double	m_grow_factor;
+      double	m_readout_rate;
+      long long	m_readout_stride;
+      double	m_peak_occupancy;
+      double	m_drain_rate;
+      long long	m_recommended_readouts;
+      long long	m_nb_overruns;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONBUFFERPOLICY_H
@@ -0,0 +1,130 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "lima/Exceptions.h"
+#include "PrincetonBufferPool.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+static const long long DEFAULT_MAX_MEMORY = 4LL << 30; // 4 GB
+
+AcqBufferPool::AcqBufferPool() :
+  m_pinned(NULL),
+  m_max_memory(DEFAULT_MAX_MEMORY),
+  m_memory(0)
+{
+}
+
+AcqBufferPool::~AcqBufferPool()
+{
+  m_pinned = NULL;
+  clear();
+}
+
+/** @brief get a buffer of size bytes, allocated with options
+ *  if not already in the pool.
+ */
+AcqMemory* AcqBufferPool::get(size_t size,const AcqMemoryOptions& options)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(size);
+
+  for(auto i = m_buffers.begin();i != m_buffers.end();++i)
+    if((*i)->getSize() == size)
+      {
+	AcqMemory* buffer = *i;
+	m_buffers.splice(m_buffers.begin(),m_buffers,i);
+	DEB_TRACE() << "Reuse pooled buffer";
+	return buffer;
+      }
+
+  AcqMemory* buffer = new AcqMemory();
+  try
+    {
+      buffer->allocate(size,options);
+    }
+  catch(...)
+    {
+      delete buffer;
+      throw;
+    }
+  m_buffers.push_front(buffer);
+  m_memory += size;
+  _evict();
+  return buffer;
+}
+
+bool AcqBufferPool::contains(size_t size) const
+{
+  for(auto i = m_buffers.begin();i != m_buffers.end();++i)
+    if((*i)->getSize() == size)
+      return true;
+  return false;
+}
+
+/** @brief free all the buffers but the pinned one
+ */
+void AcqBufferPool::clear()
+{
+  for(auto i = m_buffers.begin();i != m_buffers.end();)
+    {
+      if(*i == m_pinned)
+	{
+	  ++i;
+	  continue;
+	}
+      m_memory -= (*i)->getSize();
+      delete *i;
+      i = m_buffers.erase(i);
+    }
+}
+
+void AcqBufferPool::setMaxMemory(long long max_memory)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(max_memory);
+  if(max_memory < 0)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(max_memory);
+  m_max_memory = max_memory;
+  _evict();
+}
+
+void AcqBufferPool::_evict()
+{
+  DEB_MEMBER_FUNCT();
+  if(m_buffers.empty())
+    return;
+  // the most recently used and the pinned buffers are kept
+  auto i = m_buffers.end();
+  while(m_memory > m_max_memory && --i != m_buffers.begin())
+    {
+      AcqMemory* buffer = *i;
+      if(buffer == m_pinned)
+	continue;
+      DEB_TRACE() << "Evict pooled buffer of " << buffer->getSize() << " bytes";
+      m_memory -= buffer->getSize();
+      i = m_buffers.erase(i);
+      delete buffer;
+    }
+}
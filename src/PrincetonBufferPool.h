@@ -0,0 +1,72 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONBUFFERPOOL_H
+#define PRINCETONBUFFERPOOL_H
+
+#include <list>
+
+#include "PrincetonMemory.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Pool of acquisition buffers keyed by their size.
+     *	Switching back to a readout configuration already used gets the
+     *	same (already faulted and registered) buffer. Least recently
+     *	used buffers are freed when the pool goes over its memory bound,
+     *	the buffer in use is never freed. The buffer given to PICam is
+     *	pinned: it is neither evicted nor cleared until unpinned.
+     */
+    class AcqBufferPool
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"AcqBufferPool","Princeton");
+    public:
+      AcqBufferPool();
+      ~AcqBufferPool();
+
+      AcqMemory* get(size_t size,const AcqMemoryOptions& options);
+      void clear();
+      bool contains(size_t size) const;
+
+      /// buffer registered with PICam, NULL for none
+      void pin(AcqMemory* buffer) {m_pinned = buffer;}
+      AcqMemory* getPinned() const {return m_pinned;}
+
+      void setMaxMemory(long long max_memory);
+      long long getMaxMemory() const {return m_max_memory;}
+      long long getMemory() const {return m_memory;}
+      int getNbBuffers() const {return int(m_buffers.size());}
+    private:
+      void _evict();
+
+      std::list<AcqMemory*>	m_buffers; // most recently used first
+      AcqMemory*		m_pinned;
+      long long			m_max_memory;
+      long long			m_memory;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONBUFFERPOOL_H
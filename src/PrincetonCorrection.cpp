@@ -0,0 +1,182 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include <cstring>
+
+#include "lima/Exceptions.h"
+#include "PrincetonCorrection.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+FrameCorrection::FrameCorrection() :
+  m_dark_map(NULL),
+  m_width(0),
+  m_nb_pixels(0),
+  m_nb_dark_frames(0),
+  m_kernels(getPixelKernels())
+{
+  DEB_CONSTRUCTOR();
+  DEB_TRACE() << "Correction kernel: " << m_kernels.name;
+}
+
+void FrameCorrection::setBadPixels(const std::vector<int>& pixels)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(pixels.size());
+  std::vector<size_t> bad_pixels;
+  for(auto pixel = pixels.begin();pixel != pixels.end();++pixel)
+    {
+      if(*pixel < 0)
+	THROW_HW_ERROR(InvalidValue) << "Invalid bad pixel " << DEB_VAR1(*pixel);
+      bad_pixels.push_back(size_t(*pixel));
+    }
+  std::sort(bad_pixels.begin(),bad_pixels.end());
+  bad_pixels.erase(std::unique(bad_pixels.begin(),bad_pixels.end()),
+		   bad_pixels.end());
+  m_bad_pixels.swap(bad_pixels);
+}
+
+void FrameCorrection::getBadPixels(std::vector<int>& pixels) const
+{
+  pixels.assign(m_bad_pixels.begin(),m_bad_pixels.end());
+}
+
+void FrameCorrection::prepare(int width,size_t nb_pixels)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(width,nb_pixels);
+  if(!m_dark.empty() && m_dark.size() != nb_pixels)
+    THROW_HW_ERROR(Error) << "Dark frame doesn't match the readout frame: "
+			  << DEB_VAR2(m_dark.size(),nb_pixels);
+  if(!m_gain.empty() && m_gain.size() != nb_pixels)
+    THROW_HW_ERROR(Error) << "Flat field doesn't match the readout frame: "
+			  << DEB_VAR2(m_gain.size(),nb_pixels);
+  if(!m_bad_pixels.empty() && m_bad_pixels.back() >= nb_pixels)
+    THROW_HW_ERROR(Error) << "Bad pixel out of the readout frame: "
+			  << DEB_VAR2(m_bad_pixels.back(),nb_pixels);
+
+  if(!m_gain.empty() && m_dark.empty())
+    {
+      m_no_dark.assign(nb_pixels,0);
+      m_dark_map = m_no_dark.data();
+    }
+  else
+    {
+      m_no_dark.clear();
+      m_dark_map = m_dark.data();
+    }
+  // without whole rows, neighbours are only taken in the pixel order
+  m_width = width > 0 && !(nb_pixels % width) ? size_t(width) : nb_pixels;
+  m_nb_pixels = nb_pixels;
+}
+
+void FrameCorrection::startDark(size_t nb_pixels)
+{
+  m_dark_sum.assign(nb_pixels,0);
+  m_nb_dark_frames = 0;
+}
+
+void FrameCorrection::addDark(const void* src)
+{
+  m_kernels.widen_add(m_dark_sum.data(),(const uint16_t*)src,m_dark_sum.size());
+  ++m_nb_dark_frames;
+}
+
+void FrameCorrection::endDark()
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(m_nb_dark_frames);
+  if(!m_nb_dark_frames)
+    THROW_HW_ERROR(Error) << "No dark frame captured";
+
+  std::vector<uint16_t> dark(m_dark_sum.size());
+  uint32_t half = uint32_t(m_nb_dark_frames / 2);
+  for(size_t i = 0;i < dark.size();++i)
+    dark[i] = uint16_t((m_dark_sum[i] + half) / m_nb_dark_frames);
+  m_dark.swap(dark);
+  std::vector<uint32_t>().swap(m_dark_sum);
+}
+
+void FrameCorrection::_correct(uint16_t* dst,const uint16_t* src,size_t first,
+			       size_t nb_pixels) const
+{
+  if(!m_gain.empty())
+    m_kernels.correct_flat(dst,src + first,m_dark_map + first,
+			   m_gain.data() + first,nb_pixels);
+  else if(!m_dark.empty())
+    m_kernels.subtract_dark(dst,src + first,m_dark_map + first,nb_pixels);
+  else
+    memcpy(dst,src + first,nb_pixels * sizeof(uint16_t));
+}
+
+bool FrameCorrection::_isBad(size_t pixel) const
+{
+  return std::binary_search(m_bad_pixels.begin(),m_bad_pixels.end(),pixel);
+}
+
+/** @brief neighbours are corrected again from the source, the
+ *  result doesn't depend on the order of the chunks.
+ */
+uint16_t FrameCorrection::_replacement(const uint16_t* src,size_t pixel) const
+{
+  size_t x = pixel % m_width;
+  size_t neighbours[4];
+  int nb = 0;
+  if(x > 0 && !_isBad(pixel - 1))
+    neighbours[nb++] = pixel - 1;
+  if(x + 1 < m_width && !_isBad(pixel + 1))
+    neighbours[nb++] = pixel + 1;
+  if(!nb)
+    {
+      if(pixel >= m_width && !_isBad(pixel - m_width))
+	neighbours[nb++] = pixel - m_width;
+      if(pixel + m_width < m_nb_pixels && !_isBad(pixel + m_width))
+	neighbours[nb++] = pixel + m_width;
+    }
+  if(!nb)
+    return 0;
+
+  unsigned int sum = 0;
+  for(int i = 0;i < nb;++i)
+    {
+      uint16_t value;
+      _correct(&value,src,neighbours[i],1);
+      sum += value;
+    }
+  return uint16_t((sum + nb / 2) / nb);
+}
+
+void FrameCorrection::processPixels(void* dst,const void* src,
+				    size_t first,size_t nb_pixels) const
+{
+  uint16_t* frame = (uint16_t*)dst;
+  const uint16_t* readout = (const uint16_t*)src;
+  _correct(frame + first,readout,first,nb_pixels);
+
+  size_t last = first + nb_pixels;
+  for(auto bad = std::lower_bound(m_bad_pixels.begin(),m_bad_pixels.end(),first);
+      bad != m_bad_pixels.end() && *bad < last;++bad)
+    frame[*bad] = _replacement(readout,*bad);
+}
@@ -0,0 +1,91 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONCORRECTION_H
+#define PRINCETONCORRECTION_H
+
+#include <vector>
+
+#include "lima/Debug.h"
+#include "PrincetonFrameCopy.h"
+#include "PrincetonPixelKernels.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Dark subtraction, flat-field gain and bad pixel replacement
+     *	done in the copy of the 16 bits readout frames, in one pass.
+     *	References are readout frames (after hardware ROI and binning),
+     *	bad pixels are replaced by the mean of their good neighbours in
+     *	the row, else in the column.
+     */
+    class FrameCorrection : public FrameProcessor
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"FrameCorrection","Princeton");
+    public:
+      FrameCorrection();
+
+      void setDark(const std::vector<uint16_t>& dark) {m_dark = dark;}
+      const std::vector<uint16_t>& getDark() const {return m_dark;}
+      void setGain(const std::vector<float>& gain) {m_gain = gain;}
+      const std::vector<float>& getGain() const {return m_gain;}
+      void setBadPixels(const std::vector<int>& pixels);
+      void getBadPixels(std::vector<int>& pixels) const;
+      bool hasReference() const
+      {return !m_dark.empty() || !m_gain.empty() || !m_bad_pixels.empty();}
+
+      /// check the references against the readout frame
+      void prepare(int width,size_t nb_pixels);
+
+      //- dark reference as the mean of readout frames
+      void startDark(size_t nb_pixels);
+      void addDark(const void* src);
+      void endDark();
+
+      virtual void process(void* dst,const void* src) const
+      {processPixels(dst,src,0,m_nb_pixels);}
+      virtual bool isPixelWise() const {return true;}
+      virtual void processPixels(void* dst,const void* src,
+				 size_t first,size_t nb_pixels) const;
+    private:
+      void _correct(uint16_t* dst,const uint16_t* src,size_t first,
+		    size_t nb_pixels) const;
+      bool _isBad(size_t pixel) const;
+      uint16_t _replacement(const uint16_t* src,size_t pixel) const;
+
+      std::vector<uint16_t>	m_dark;
+      std::vector<float>	m_gain;
+      std::vector<size_t>	m_bad_pixels; // sorted
+      std::vector<uint16_t>	m_no_dark;    // zeros, gain without dark
+      const uint16_t*		m_dark_map;
+      size_t			m_width;
+      size_t			m_nb_pixels;
+      std::vector<uint32_t>	m_dark_sum;
+      int			m_nb_dark_frames;
+      const PixelKernels&	m_kernels;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONCORRECTION_H
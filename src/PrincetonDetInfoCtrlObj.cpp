@@ -23,27 +23,23 @@
 //###########################################################################
 
 #include "PrincetonDetInfoCtrlObj.h"
+#include "PrincetonParameterCache.h"
 #include "PrincetonException.h"
 
 using namespace lima;
 using namespace lima::Princeton;
 
-DetInfoCtrlObj::DetInfoCtrlObj(PicamHandle cam) : m_cam(cam)
+DetInfoCtrlObj::DetInfoCtrlObj(PicamHandle cam,ParameterCache& parameters) :
+  m_cam(cam),
+  m_parameters(parameters),
+  m_image_type(Bpp16)
 {
   DEB_CONSTRUCTOR();
 
   // Detector width
-  piint width;
-  CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,
-					     PicamParameter_ActiveWidth,
-					     &width));
-  m_max_columns = width;
+  m_max_columns = m_parameters.getIntegerValue(PicamParameter_ActiveWidth);
   // Detector height
-  piint height;
-  CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,
-					     PicamParameter_ActiveHeight,
-					     &height));
-  m_max_rows = height;
+  m_max_rows = m_parameters.getIntegerValue(PicamParameter_ActiveHeight);
 }
 
 DetInfoCtrlObj::~DetInfoCtrlObj()
@@ -52,25 +48,29 @@ DetInfoCtrlObj::~DetInfoCtrlObj()
 
 void DetInfoCtrlObj::getMaxImageSize(Size& max_image_size)
 {
-  max_image_size = Size(m_max_columns,m_max_rows);
+  if(m_readout_size.isEmpty())
+    max_image_size = Size(m_max_columns,m_max_rows);
+  else
+    max_image_size = m_readout_size;
 }
 
 void DetInfoCtrlObj::getDetectorImageSize(Size& det_image_size)
 {
-  getMaxImageSize(det_image_size);
+  det_image_size = Size(m_max_columns,m_max_rows);
 }
 
 void DetInfoCtrlObj::getDefImageType(ImageType& det_image_type)
 {
   /* Most Princeton camera are 16bits Mono
      but some can handle other format... Not managed.
+     Frames summed by the plugin are 32bits.
   */
-  det_image_type = Bpp16;
+  det_image_type = m_image_type;
 }
 
 void DetInfoCtrlObj::getCurrImageType(ImageType& curr_image_type)
 {
-  curr_image_type = Bpp16;
+  curr_image_type = m_image_type;
 }
 
 void DetInfoCtrlObj::setCurrImageType(ImageType curr_image_type)
@@ -78,22 +78,16 @@ void DetInfoCtrlObj::setCurrImageType(ImageType curr_image_type)
   DEB_MEMBER_FUNCT();
   DEB_PARAM() << DEB_VAR1(curr_image_type);
 
-  if(curr_image_type != Bpp16)
-    THROW_HW_ERROR(Error) << "Only support 16bits image";
+  if(curr_image_type != m_image_type)
+    THROW_HW_ERROR(Error) << "Only support " << DEB_VAR1(m_image_type) << " image";
 }
 
 void DetInfoCtrlObj::getPixelSize(double& x_size,double &y_size)
 {
   DEB_MEMBER_FUNCT();
   
-  piflt width;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_PixelWidth,
-						   &width));
-  piflt height;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_PixelHeight,
-						   &height));
+  piflt width = m_parameters.getFloatingPointValue(PicamParameter_PixelWidth);
+  piflt height = m_parameters.getFloatingPointValue(PicamParameter_PixelHeight);
   
   x_size = width * 1e-6;
   y_size = height * 1e-6;
@@ -126,3 +120,29 @@ void DetInfoCtrlObj::unregisterMaxImageSizeCallback(HwMaxImageSizeCallback& cb)
 {
   m_mis_cb_gen.unregisterMaxImageSizeCallback(cb);
 }
+
+void DetInfoCtrlObj::setReadoutImageSize(const Size& size)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(size);
+  if(size == m_readout_size)
+    return;
+
+  m_readout_size = size;
+  Size max_image_size;
+  getMaxImageSize(max_image_size);
+  m_mis_cb_gen.maxImageSizeChanged(max_image_size,m_image_type);
+}
+
+void DetInfoCtrlObj::setReadoutImageType(ImageType image_type)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(image_type);
+  if(image_type == m_image_type)
+    return;
+
+  m_image_type = image_type;
+  Size max_image_size;
+  getMaxImageSize(max_image_size);
+  m_mis_cb_gen.maxImageSizeChanged(max_image_size,m_image_type);
+}
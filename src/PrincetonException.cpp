@@ -22,7 +22,6 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
 
-#include <map>
 #include "PrincetonException.h"
 
 std::string _GetEnumString(PicamEnumeratedType type, piint value )
@@ -55,21 +54,8 @@ std::string get_human_computer_interface(PicamComputerInterface interface)
   return msg.empty() ? std::string("Unkown interface") : msg;
 }
 
-std::map<PicamHandle,void*> handle2_user_data;
-void register_user_pointer(PicamHandle handle,void* user_data)
+std::string get_parameter_name(PicamParameter parameter)
 {
-  handle2_user_data.insert({handle,user_data});
-}
-
-void unregister_user_pointer(PicamHandle handle)
-{
-  auto search = handle2_user_data.find(handle);
-  if(search != handle2_user_data.end())
-    handle2_user_data.erase(search);
-}
-
-void* get_user_pointer(PicamHandle handle)
-{
-  auto search = handle2_user_data.find(handle);
-  return search != handle2_user_data.end() ? search->second : NULL;
+  std::string msg = _GetEnumString(PicamEnumeratedType_Parameter,parameter);
+  return msg.empty() ? std::string("Unkown parameter") : msg;
 }
@@ -38,10 +38,7 @@ struct Error2Msg
 std::string get_error_message(PicamError error);
 std::string get_human_cam_model(PicamModel);
 std::string get_human_computer_interface(PicamComputerInterface);
-
-void register_user_pointer(PicamHandle,void*);
-void unregister_user_pointer(PicamHandle);
-void* get_user_pointer(PicamHandle);
+std::string get_parameter_name(PicamParameter);
 
 #define CHECK_PICAM(status)				\
 if(status != PicamError_None) {					\
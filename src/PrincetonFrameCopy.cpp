@@ -0,0 +1,355 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "lima/Exceptions.h"
+#include "PrincetonFrameCopy.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PRINCETON_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+using namespace lima;
+using namespace lima::Princeton;
+
+// Below this size, data stays in cache and a plain memcpy is faster
+static const size_t STREAMING_THRESHOLD = 256 * 1024;
+// Size of the pieces shared between copy workers
+static const size_t CHUNK_SIZE = 1024 * 1024;
+
+static void _memcpy(void* dst,const void* src,size_t size)
+{
+  memcpy(dst,src,size);
+}
+
+#ifdef PRINCETON_X86
+TARGET_SSE2
+static void _stream_copy_sse2(void* dst,const void* src,size_t size)
+{
+  if(size < STREAMING_THRESHOLD)
+    return _memcpy(dst,src,size);
+
+  char* d = (char*)dst;
+  const char* s = (const char*)src;
+  size_t head = (16 - (uintptr_t(d) & 15)) & 15;
+  memcpy(d,s,head);
+  d += head,s += head,size -= head;
+
+  for(size_t nb = size / 64;nb;--nb,d += 64,s += 64)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)s);
+      __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+      __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+      __m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+      _mm_stream_si128((__m128i*)d,a);
+      _mm_stream_si128((__m128i*)(d + 16),b);
+      _mm_stream_si128((__m128i*)(d + 32),c);
+      _mm_stream_si128((__m128i*)(d + 48),e);
+    }
+  _mm_sfence();
+  memcpy(d,s,size & 63);
+}
+
+TARGET_AVX2
+static void _stream_copy_avx2(void* dst,const void* src,size_t size)
+{
+  if(size < STREAMING_THRESHOLD)
+    return _memcpy(dst,src,size);
+
+  char* d = (char*)dst;
+  const char* s = (const char*)src;
+  size_t head = (32 - (uintptr_t(d) & 31)) & 31;
+  memcpy(d,s,head);
+  d += head,s += head,size -= head;
+
+  for(size_t nb = size / 128;nb;--nb,d += 128,s += 128)
+    {
+      __m256i a = _mm256_loadu_si256((const __m256i*)s);
+      __m256i b = _mm256_loadu_si256((const __m256i*)(s + 32));
+      __m256i c = _mm256_loadu_si256((const __m256i*)(s + 64));
+      __m256i e = _mm256_loadu_si256((const __m256i*)(s + 96));
+      _mm256_stream_si256((__m256i*)d,a);
+      _mm256_stream_si256((__m256i*)(d + 32),b);
+      _mm256_stream_si256((__m256i*)(d + 64),c);
+      _mm256_stream_si256((__m256i*)(d + 96),e);
+    }
+  _mm_sfence();
+  memcpy(d,s,size & 127);
+}
+
+#endif
+
+bool Princeton::cpuHasAvx2()
+{
+#if !defined(PRINCETON_X86)
+  return false;
+#elif defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info,1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if(!osxsave || !avx) return false;
+  if((_xgetbv(0) & 0x6) != 0x6) return false; // OS saves YMM registers
+  __cpuidex(info,7,0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return false;
+#endif
+}
+
+bool Princeton::cpuHasSse2()
+{
+#if !defined(PRINCETON_X86)
+  return false;
+#elif defined(__x86_64__) || defined(_M_X64)
+  return true;
+#elif defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info,1);
+  return (info[3] & (1 << 26)) != 0;
+#else
+  return false;
+#endif
+}
+
+namespace
+{
+  struct CopyKernel
+  {
+    CopyFunction	function;
+    const char*		name;
+  };
+
+  CopyKernel _selectCopyKernel()
+  {
+#ifdef PRINCETON_X86
+    if(cpuHasAvx2())
+      return {_stream_copy_avx2,"avx2"};
+    if(cpuHasSse2())
+      return {_stream_copy_sse2,"sse2"};
+#endif
+    return {_memcpy,"memcpy"};
+  }
+
+  const CopyKernel& _getCopyKernel()
+  {
+    static const CopyKernel kernel = _selectCopyKernel();
+    return kernel;
+  }
+}
+
+CopyFunction Princeton::getStreamingCopyFunction()
+{
+  return _getCopyKernel().function;
+}
+
+const char* Princeton::getStreamingCopyName()
+{
+  return _getCopyKernel().name;
+}
+
+FrameCopyPool::FrameCopyPool() :
+  m_copy(getStreamingCopyFunction()),
+  m_quit(false),
+  m_generation(0),
+  m_nb_busy(0),
+  m_next_chunk(0)
+{
+  DEB_CONSTRUCTOR();
+  DEB_TRACE() << "Frame copy kernel: " << getStreamingCopyName();
+}
+
+FrameCopyPool::~FrameCopyPool()
+{
+  DEB_DESTRUCTOR();
+  _stopThreads();
+}
+
+void FrameCopyPool::setNbThreads(int nb_threads)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_threads);
+  if(nb_threads < 0)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_threads);
+
+  _stopThreads();
+  _startThreads(nb_threads);
+}
+
+void FrameCopyPool::setCpuList(const std::vector<int>& cpus)
+{
+  DEB_MEMBER_FUNCT();
+  m_cpus = cpus;
+  int nb_threads = getNbThreads();
+  _stopThreads();
+  _startThreads(nb_threads);
+}
+
+void FrameCopyPool::copy(const std::vector<CopyTask>& tasks)
+{
+  size_t total_size = 0;
+  for(auto task = tasks.begin();task != tasks.end();++task)
+    total_size += task->size;
+
+  // Not worth waking up workers
+  if(m_threads.empty() || total_size <= CHUNK_SIZE)
+    {
+      for(auto task = tasks.begin();task != tasks.end();++task)
+	_run(*task);
+      return;
+    }
+
+  AutoMutex lock(m_cond.mutex());
+  m_chunks.clear();
+  for(auto task = tasks.begin();task != tasks.end();++task)
+    {
+      // a processed frame is one chunk, unless pixel-wise
+      if(task->processor && !task->processor->isPixelWise())
+	{
+	  m_chunks.push_back(*task);
+	  continue;
+	}
+      for(size_t offset = 0;offset < task->size;offset += CHUNK_SIZE)
+	{
+	  size_t size = std::min(CHUNK_SIZE,task->size - offset);
+	  CopyTask chunk;
+	  if(task->processor)
+	    chunk = {task->dst,task->src,size,task->processor,offset};
+	  else
+	    chunk = {(char*)task->dst + offset,
+		     (const char*)task->src + offset,size,NULL,0};
+	  m_chunks.push_back(chunk);
+	}
+    }
+  m_next_chunk = 0;
+  m_nb_busy = int(m_threads.size());
+  ++m_generation;
+  m_cond.broadcast();
+
+  {
+    AutoMutexUnlock u(lock);
+    _copyChunks();
+  }
+  while(m_nb_busy)
+    m_cond.wait();
+}
+
+void FrameCopyPool::_copyChunks()
+{
+  while(true)
+    {
+      CopyTask chunk;
+      {
+	AutoMutex lock(m_cond.mutex());
+	if(m_next_chunk >= m_chunks.size())
+	  break;
+	chunk = m_chunks[m_next_chunk++];
+      }
+      _run(chunk);
+    }
+}
+
+void FrameCopyPool::_startThreads(int nb_threads)
+{
+  m_quit = false;
+  for(int i = 0;i < nb_threads;++i)
+    m_threads.push_back(std::thread(&FrameCopyPool::_workerFunction,this,i,
+				    m_generation));
+}
+
+void FrameCopyPool::_stopThreads()
+{
+  {
+    AutoMutex lock(m_cond.mutex());
+    m_quit = true;
+    m_cond.broadcast();
+  }
+  for(auto thread = m_threads.begin();thread != m_threads.end();++thread)
+    thread->join();
+  m_threads.clear();
+}
+
+/** @brief generation is the one when the worker was created, a batch
+ *  started before the worker runs is not missed.
+ */
+void FrameCopyPool::_workerFunction(int worker_id,unsigned int generation)
+{
+  DEB_MEMBER_FUNCT();
+  if(!m_cpus.empty())
+    {
+      int cpu = m_cpus[worker_id % m_cpus.size()];
+#ifdef __linux__
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(cpu,&cpu_set);
+      if(pthread_setaffinity_np(pthread_self(),sizeof(cpu_set),&cpu_set))
+	DEB_WARNING() << "Can't pin copy worker " << worker_id << " on " << DEB_VAR1(cpu);
+#elif defined(_WIN32)
+      if(!SetThreadAffinityMask(GetCurrentThread(),DWORD_PTR(1) << cpu))
+	DEB_WARNING() << "Can't pin copy worker " << worker_id << " on " << DEB_VAR1(cpu);
+#endif
+    }
+
+  AutoMutex lock(m_cond.mutex());
+  while(true)
+    {
+      while(!m_quit && generation == m_generation)
+	m_cond.wait();
+      if(m_quit) break;
+      generation = m_generation;
+      {
+	AutoMutexUnlock u(lock);
+	_copyChunks();
+      }
+      if(!--m_nb_busy)
+	m_cond.broadcast();
+    }
+}
@@ -0,0 +1,136 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONFRAMECOPY_H
+#define PRINCETONFRAMECOPY_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    typedef void (*CopyFunction)(void* dst,const void* src,size_t size);
+
+    /// run time CPU features (false when not on x86)
+    bool cpuHasAvx2();
+    bool cpuHasSse2();
+
+    /** @brief return the fastest streaming (non-temporal) copy kernel
+     *	supported by the running CPU, plain memcpy if none.
+     */
+    CopyFunction getStreamingCopyFunction();
+    const char* getStreamingCopyName();
+
+    /** Processing which replaces the plain copy of a frame
+     *	(the Lima frame isn't the readout frame). It's called from the
+     *	copy workers, one whole frame per call, or one range of the 16 bits
+     *	source pixels per call for pixel-wise processing.
+     */
+    class FrameProcessor
+    {
+    public:
+      virtual ~FrameProcessor() {}
+      virtual void process(void* dst,const void* src) const = 0;
+
+      virtual bool isPixelWise() const {return false;}
+      virtual void processPixels(void* /*dst*/,const void* /*src*/,
+				 size_t /*first*/,size_t /*nb_pixels*/) const {}
+    };
+
+    struct CopyTask
+    {
+      void*			dst;
+      const void*		src;
+      size_t			size;
+      const FrameProcessor*	processor; // NULL for a copy
+      size_t			offset;	   // in src, for pixel-wise chunks
+    };
+
+    /** Small pool of worker threads copying a batch of frames.
+     *	Frames are split in chunks and shared between the workers and
+     *	the calling thread; copy() returns when the whole batch is done.
+     */
+    class FrameCopyPool
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"FrameCopyPool","Princeton");
+    public:
+      FrameCopyPool();
+      ~FrameCopyPool();
+
+      void setNbThreads(int nb_threads);
+      int getNbThreads() const {return int(m_threads.size());}
+      void setCpuList(const std::vector<int>& cpus);
+      void getCpuList(std::vector<int>& cpus) const {cpus = m_cpus;}
+
+      void copy(const std::vector<CopyTask>& tasks);
+
+      //- batch interface, flush() copies all added tasks.
+      //- Consecutive tasks on the same destination (accumulation) are
+      //- done one after the other.
+      void add(void* dst,const void* src,size_t size,
+	       const FrameProcessor* processor = NULL)
+      {
+	if(!m_tasks.empty() && m_tasks.back().dst == dst)
+	  flush();
+	CopyTask task = {dst,src,size,processor,0};
+	m_tasks.push_back(task);
+      }
+      int getNbPendingTasks() const {return int(m_tasks.size());}
+      void flush() {copy(m_tasks);m_tasks.clear();}
+    private:
+      void _startThreads(int nb_threads);
+      void _stopThreads();
+      void _workerFunction(int worker_id,unsigned int generation);
+      void _copyChunks();
+      void _run(const CopyTask& task)
+      {
+	if(!task.processor)
+	  m_copy(task.dst,task.src,task.size);
+	else if(task.processor->isPixelWise())
+	  task.processor->processPixels(task.dst,task.src,task.offset / 2,
+					task.size / 2);
+	else
+	  task.processor->process(task.dst,task.src);
+      }
+
+      CopyFunction		m_copy;
+      std::vector<std::thread>	m_threads;
+      std::vector<int>		m_cpus;
+      Cond			m_cond;
+      bool			m_quit;
+      unsigned int		m_generation;
+      int			m_nb_busy;
+      std::vector<CopyTask>	m_chunks;
+      size_t			m_next_chunk;
+      std::vector<CopyTask>	m_tasks;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONFRAMECOPY_H
@@ -22,175 +22,318 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 #include "PrincetonInterface.h"
 #include "PrincetonDetInfoCtrlObj.h"
 #include "PrincetonSyncCtrlObj.h"
 #include "PrincetonBinCtrlObj.h"
 #include "PrincetonRoiCtrlObj.h"
+#include "PrincetonRoiSolver.h"
 #include "PrincetonShutterCtrlObj.h"
+#include "PrincetonBufferCtrlObj.h"
+#include "PrincetonReadoutQueue.h"
+#include "PrincetonFrameCopy.h"
+#include "PrincetonBufferPolicy.h"
+#include "PrincetonBufferPool.h"
+#include "PrincetonMetadataParser.h"
+#include "PrincetonParameterCache.h"
+#include "PrincetonProfile.h"
+#include "PrincetonLibrary.h"
+#include "PrincetonReadoutSpeed.h"
+#include "PrincetonTiming.h"
+#include "PrincetonSpectrum.h"
+#include "PrincetonAccumulator.h"
+#include "PrincetonCorrection.h"
+#include "PrincetonLatency.h"
 #include "PrincetonException.h"
 
 using namespace lima;
 using namespace lima::Princeton;
 
-#include "processlib/SinkTask.h"
-#include "processlib/TaskMgr.h"
- 
-// _StopAcq
-class _StopAcq : public SinkTaskBase
-{
-public:
-  _StopAcq(Interface &anInterface) : m_interface(anInterface) {}
-  virtual ~_StopAcq() {}
-  virtual void process(Data&)
-  {
-    m_interface.stopAcq();
-  }
-private:
-  Interface& m_interface;
-};
+// Maximum number of frames copied before Lima is notified
+static const int MAX_COPY_BATCH = 16;
+static const int DEFAULT_COPY_THREADS = 2;
+// Number of frames whose metadata is kept
+static const int METADATA_HISTORY = 1024;
+// Dark capture timeout on top of the predicted acquisition time (s)
+static const double DARK_CAPTURE_MARGIN = 10.;
+static const int NB_LATENCY_STAGES = Interface::TotalLatency + 1;
+// Maximum wait of the acquisition end after a stop (s)
+static const double DEFAULT_STOP_TIMEOUT = 5.;
+
 //Callback
 PicamError Princeton::AcquisitionUpdatedCallback(PicamHandle cam,
 						 const PicamAvailableData* available,
 						 const PicamAcquisitionStatus* status)
 {
-  Interface *interface = (Interface*)get_user_pointer(cam);
+  Interface *interface = Library::get().getInterface(cam);
   if(!interface)
     {
       std::cerr << "Something weird happen ;)" << std::endl;
       return PicamError_UnexpectedError;
     }
 
-  interface->newFrameReady(available,status);
+  interface->readoutAvailable(available,status);
 
   return PicamError_None;
 }
 
 Interface::Interface(const std::string& camera_serial) :
-  m_sdk_initialized(false),
-  m_available_camera(NULL),
-  m_available_camera_number(0),
   m_cam(NULL),
   m_status(Ready),
   m_det_info(NULL),
   m_sync(NULL), 
   m_bin(NULL),
   m_roi(NULL),
-  m_shutter(NULL)
+  m_roi_solver(NULL),
+  m_parameters(NULL),
+  m_readout_speed(NULL),
+  m_timing(NULL),
+  m_shutter(NULL),
+  m_buffer_ctrl_obj(NULL),
+  m_nb_frames(0),
+  m_buffer_pool(new AcqBufferPool()),
+  m_alloc_options(new AcqMemoryOptions()),
+  m_in_place(false),
+  m_track_layout(SpectrumPerTrack),
+  m_readout_stride(0),
+  m_frames_per_readout(0),
+  m_frame_stride(0),
+  m_frame_size(0),
+  m_readout_queue(new ReadoutQueue()),
+  m_frame_copy(new FrameCopyPool()),
+  m_spectrum(new SpectrumExtractor()),
+  m_frame_processor(NULL),
+  m_accumulator(new FrameAccumulator()),
+  m_accumulation(1),
+  m_accumulation_saturation(0),
+  m_frame_in_sum(0),
+  m_correction(new FrameCorrection()),
+  m_correction_enabled(false),
+  m_dark_capture(0),
+  m_lima_frame_size(0),
+  m_buffer_policy(new BufferSizingPolicy()),
+  m_buffer_readouts(0),
+  m_pending_readouts(0),
+  m_peak_pending_readouts(0),
+  m_nb_buffer_overruns(0),
+  m_dispatched_readouts(0),
+  m_dispatch_busy_time(0.),
+  m_dispatcher_waiting(false),
+  m_quit_dispatcher(false),
+  m_latency(new LatencyHistogram[NB_LATENCY_STAGES]),
+  m_batch_start(0),
+  m_nb_acquired_frames(0),
+  m_rate_start(0),
+  m_rate_start_frames(0),
+  m_rate_end(0),
+  m_acq_readout_time(0.),
+  m_has_sensor_temperature(false),
+  m_sensor_temperature(std::numeric_limits<double>::quiet_NaN()),
+  m_stop_requested(false),
+  m_stop_pending(false),
+  m_quit_control(false),
+  m_stop_timeout(DEFAULT_STOP_TIMEOUT),
+  m_stop_start(0),
+  m_last_stop_time(0.),
+  m_metadata_parser(new MetadataParser()),
+  m_batch_metadata(MAX_COPY_BATCH),
+  m_metadata_history(METADATA_HISTORY),
+  m_last_metadata_frame(-1),
+  m_data_loss_policy(FaultOnDataLoss),
+  m_data_loss_cb(NULL),
+  m_next_frame_tracking(-1),
+  m_nb_lost_frames(0),
+  m_nb_data_loss_events(0),
+  m_nb_commits(0),
+  m_last_commit_time(0.),
+  m_total_commit_time(0.),
+  m_max_commit_time(0.)
 {
   DEB_CONSTRUCTOR();
   m_pixel_stream = {NULL,0};
-  piint major, minor, distribution, released;
-  CHECK_PICAM(Picam_GetVersion(&major, &minor, &distribution, &released));
-
-  DEB_ALWAYS() << "PICam version " << major << "." << minor << "." << distribution
-	       << " (" << released << ")";
-  pibln inited;
-  CHECK_PICAM(Picam_IsLibraryInitialized(&inited));
+  m_acq_buffer = {NULL,0};
+  Library& library = Library::get();
+  library.acquire();
+  bool callback_registered = false;
+  try
+    {
+      PicamCameraID cam_id;
+      pibln exists;
+      library.openCamera(camera_serial,m_cam,cam_id);
+      std::string model = get_human_cam_model(cam_id.model);
+      std::string computer_interface = get_human_computer_interface(cam_id.computer_interface);
+      const char* sensor_name = cam_id.sensor_name;
+      const char* serial_number = cam_id.serial_number;
+      DEB_ALWAYS() << "Connected to camera "
+		   << DEB_VAR4(model,computer_interface,sensor_name,serial_number);
+      _setupMetadata();
+      CHECK_PICAM(Picam_DoesParameterExist(m_cam,
+					   PicamParameter_SensorTemperatureReading,
+					   &exists));
+      m_has_sensor_temperature = exists;
+      _sampleSensorTemperature();
+      library.registerInterface(m_cam,this);
 
-  if(inited)
-    THROW_HW_ERROR(Error) << "Something weird happen, the library is already initialized";
+      CHECK_PICAM(PicamAdvanced_RegisterForAcquisitionUpdated(m_cam,Princeton::AcquisitionUpdatedCallback));
+      callback_registered = true;
+  
+      m_parameters = new ParameterCache(m_cam);
 
-  DEB_ALWAYS() << "Initialize PICam library";
-  CHECK_PICAM(Picam_InitializeLibrary());
-  m_sdk_initialized = true;
+      // HW Caps
+      m_det_info = new DetInfoCtrlObj(m_cam,*m_parameters);
+      m_sync = new SyncCtrlObj(m_cam,*m_parameters);
+      m_roi_solver = new RoiSolver(m_cam);
+      m_bin = new BinCtrlObj(m_cam,*m_roi_solver);
+      m_roi = new RoiCtrlObj(m_cam,*m_det_info,*m_bin,*m_roi_solver,*m_sync);
+      m_shutter = new ShutterCtrlObj(m_cam,*m_parameters);
+      m_readout_speed = new ReadoutSpeed(m_cam,*m_parameters);
+      m_timing = new TimingChecker(*m_parameters);
+      m_buffer_ctrl_obj = new BufferCtrlObj(m_cam);
   
-  CHECK_PICAM(Picam_GetAvailableCameraIDs(&m_available_camera,
-					  &m_available_camera_number));
-  if (m_available_camera_number == 0)
-    THROW_HW_ERROR(Error) << "No cameras found in the system\n";
-
-  // Try to find the camera.
-  // if camera_serial is empty, open the first found.
-  bool found = false;
-  for(int i = 0;i < m_available_camera_number;++i)
-    {
-      const PicamCameraID* cam_id = &m_available_camera[i];
-      
-      if(camera_serial.empty() || camera_serial == cam_id->serial_number)
-	{
-	  CHECK_PICAM(PicamAdvanced_OpenCameraDevice(cam_id, &m_cam));
-	  std::string model = get_human_cam_model(cam_id->model);
-	  std::string computer_interface = get_human_computer_interface(cam_id->computer_interface);
-	  const char* sensor_name = cam_id->sensor_name;
-	  const char* serial_number = cam_id->serial_number;
-
-	  DEB_ALWAYS() << "Connected to camera "
-		       << DEB_VAR4(model,computer_interface,sensor_name,serial_number);
-	  break;
-	}
-    }
+      // Cap list
+      m_cap_list.push_back(HwCap(m_det_info));
+      m_cap_list.push_back(HwCap(m_sync));
+      m_cap_list.push_back(HwCap(m_bin));
+      m_cap_list.push_back(HwCap(m_roi));
+      m_cap_list.push_back(HwCap(m_shutter));
+      m_cap_list.push_back(HwCap(m_buffer_ctrl_obj));
 
-  if(!m_cam)
+      _updateReadoutWindow();
+      m_frame_copy->setNbThreads(DEFAULT_COPY_THREADS);
+      m_dispatch_thread = std::thread(&Interface::_dispatchReadouts,this);
+      m_control_thread = std::thread(&Interface::_controlLoop,this);
+    }
+  catch(...)
     {
-      DEB_ALWAYS() << "Cameras found:";
-      for(int i = 0;i < m_available_camera_number;++i)
-	{
-	  const PicamCameraID* cam_id = &m_available_camera[i];
-	  std::string model = get_human_cam_model(cam_id->model);
-	  DEB_ALWAYS() << DEB_VAR1(model);
-
-	  std::string computer_interface = get_human_computer_interface(cam_id->computer_interface);
-	  DEB_ALWAYS() << DEB_VAR1(computer_interface);
-
-	  const char* sensor_name = cam_id->sensor_name;
-	  const char* serial_number = cam_id->serial_number;
-	  DEB_ALWAYS() << DEB_VAR2(sensor_name,serial_number);
-	  DEB_ALWAYS() << "##############################";
-	}
-      THROW_HW_ERROR(Error) << "Camera with "
-			    << DEB_VAR1(camera_serial) << " is not found!";
+      _release(callback_registered);
+      throw;
     }
-
-  //enable metadata
-  piint ts_mask = PicamTimeStampsMask_ExposureStarted | PicamTimeStampsMask_ExposureEnded;
-  CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TimeStamps,ts_mask));
-  
-  register_user_pointer(m_cam,this);
-  CHECK_PICAM(PicamAdvanced_RegisterForAcquisitionUpdated(m_cam,Princeton::AcquisitionUpdatedCallback));
-  
-  // HW Caps
-  m_det_info = new DetInfoCtrlObj(m_cam);
-  m_sync = new SyncCtrlObj(m_cam);
-  m_bin = new BinCtrlObj(m_cam);
-  m_roi = new RoiCtrlObj(m_cam,*m_bin);
-  m_shutter = new ShutterCtrlObj(m_cam);
-  
-  // Cap list
-  m_cap_list.push_back(HwCap(m_det_info));
-  m_cap_list.push_back(HwCap(m_sync));
-  //m_cap_list.push_back(HwCap(m_bin));
-  //m_cap_list.push_back(HwCap(m_roi));
-  m_cap_list.push_back(HwCap(m_shutter));
-  m_cap_list.push_back(HwCap(&m_buffer_ctrl_obj));
 }
 
 Interface::~Interface()
 {
   DEB_DESTRUCTOR();
+  // no acquisition may outlive the interface
+  try
+    {
+      stopAcq();
+    }
+  catch(Exception& e)
+    {
+      DEB_ERROR() << "Acquisition stop failed: " << e.getErrMsg();
+    }
+  // in fault PICam may still be acquiring
+  if(m_status == Fault)
+    Picam_StopAcquisition(m_cam);
+  _release(true);
+}
+
+/** @brief tear down, also after a failed construction: PICam callbacks
+ *  are unregistered before anything they use is deleted, the camera is
+ *  closed before its acquisition buffers are freed.
+ */
+void Interface::_release(bool callback_registered)
+{
+  DEB_MEMBER_FUNCT();
+  Library& library = Library::get();
+  if(m_cam)
+    {
+      if(callback_registered)
+	PicamAdvanced_UnregisterForAcquisitionUpdated(m_cam,Princeton::AcquisitionUpdatedCallback);
+      library.unregisterInterface(m_cam);
+    }
+
+  if(m_control_thread.joinable())
+    {
+      {
+	AutoMutex lock(m_control_cond.mutex());
+	m_quit_control = true;
+	m_control_cond.broadcast();
+      }
+      m_control_thread.join();
+    }
+  if(m_dispatch_thread.joinable())
+    {
+      {
+	AutoMutex lock(m_dispatch_cond.mutex());
+	m_quit_dispatcher = true;
+	m_dispatch_cond.signal();
+      }
+      m_dispatch_thread.join();
+    }
+  delete m_readout_queue;
+  delete m_frame_copy;
+  delete m_spectrum;
+  delete m_accumulator;
+  delete m_correction;
+  delete m_buffer_policy;
+  delete m_metadata_parser;
+  delete[] m_latency;
 
   delete m_det_info;
   delete m_sync;
   delete m_bin;
   delete m_roi;
+  delete m_roi_solver;
   delete m_shutter;
-  
-  unregister_user_pointer(m_cam);
+  delete m_readout_speed;
+  delete m_timing;
+  delete m_parameters;
+  for(auto i = m_profiles.begin();i != m_profiles.end();++i)
+    delete i->second;
   
   if(m_cam)
-    PicamAdvanced_CloseCameraDevice(m_cam);
-
-  if(m_available_camera)
-    Picam_DestroyCameraIDs(m_available_camera);
-  
-  if(m_sdk_initialized)
-    Picam_UninitializeLibrary();
+    library.closeCamera(m_cam);
+  library.release();
 
   _freePixelBuffer();
+  delete m_buffer_pool;
+  delete m_alloc_options;
+  delete m_buffer_ctrl_obj;
+}
+
+/** @brief time stamps, and frame tracking (to detect lost frames)
+ *  when available, are appended to each frame
+ */
+void Interface::_setupMetadata()
+{
+  DEB_MEMBER_FUNCT();
+  piint ts_mask = PicamTimeStampsMask_ExposureStarted | PicamTimeStampsMask_ExposureEnded;
+  CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TimeStamps,ts_mask));
+  pibln track_frames;
+  CHECK_PICAM(Picam_DoesParameterExist(m_cam,PicamParameter_TrackFrames,
+				       &track_frames));
+  if(track_frames)
+    CHECK_PICAM(Picam_CanSetParameterIntegerValue(m_cam,PicamParameter_TrackFrames,
+						  true,&track_frames));
+  if(track_frames)
+    CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TrackFrames,true));
 }
 
+/** @brief read from the camera, never while reading the counters; an
+ *  error is only logged, the previous value is kept.
+ */
+void Interface::_sampleSensorTemperature()
+{
+  DEB_MEMBER_FUNCT();
+  if(!m_has_sensor_temperature)
+    return;
+  piflt temperature;
+  PicamError error =
+    Picam_ReadParameterFloatingPointValue(m_cam,
+					  PicamParameter_SensorTemperatureReading,
+					  &temperature);
+  if(error == PicamError_None)
+    m_sensor_temperature = temperature;
+  else
+    DEB_WARNING() << "Can't read sensor temperature: "
+		  << get_error_message(error);
+}
 
 void Interface::getCapList(CapList &cap_list) const
 {
@@ -207,45 +350,14 @@ void Interface::prepareAcq()
 {
   DEB_MEMBER_FUNCT();
   m_acq_frames = -1;
-  // - get the current readout rate
-  // - note this accounts for rate increases in online scenarios
-  piflt onlineReadoutRate;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_OnlineReadoutRateCalculation,
-						   &onlineReadoutRate));
-
-  // - get the current readout stride
-  piint readoutStride;
-  CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,
-					     PicamParameter_ReadoutStride,
-					     &readoutStride));
-  // - calculate the buffer size
-  pi64s readouts = std::ceil(std::max(3.*onlineReadoutRate,2.));
-  long exp_bytes = readoutStride * readouts;
-  if(exp_bytes != m_pixel_stream.memory_size)
-    {
-      _freePixelBuffer();
-#ifdef __unix
-      if(posix_memalign(&m_pixel_stream.memory,16,exp_bytes))
-#else  /* window */
-	m_pixel_stream.memory = _aligned_malloc(exp_bytes,16);
-      if(!m_pixel_stream.memory)
-#endif
-	THROW_HW_ERROR(Error) << "Can't allocate double buffer";
-  
-      m_pixel_stream.memory_size=exp_bytes;
-      CHECK_PICAM(PicamAdvanced_SetAcquisitionBuffer(m_cam,&m_pixel_stream));
-    }
+
+  if(m_parameters->inTransaction())
+    THROW_HW_ERROR(Error) << "Parameter transaction is not committed";
 
   pibln committed;
   CHECK_PICAM(Picam_AreParametersCommitted(m_cam,&committed));
   if(!committed)
-    {
-      PicamHandle model;
-      CHECK_PICAM(PicamAdvanced_GetCameraModel(m_cam,&model));
-
-      CHECK_PICAM(PicamAdvanced_CommitParametersToCameraDevice(model));
-    }
+    _commitParameters();
 
   // Cache values for data reading
   CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,PicamParameter_ReadoutStride,
@@ -259,6 +371,90 @@ void Interface::prepareAcq()
   CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,
 					     PicamParameter_FrameSize,
 					     &m_frame_size));
+
+  // Kinetics packs several frames in each readout, the frames of the
+  // last readout after the requested ones are dropped
+  m_sync->getNbHwFrames(m_nb_frames);
+  int accumulation = m_accumulation;
+  if(m_dark_capture)
+    m_nb_frames = m_dark_capture,accumulation = 1;
+  pi64s nb_hw_frames = pi64s(m_nb_frames) * accumulation;
+  pi64s readout_count = nb_hw_frames ?
+    (nb_hw_frames + m_frames_per_readout - 1) / m_frames_per_readout : 0;
+  if(m_parameters->getLargeIntegerValue(PicamParameter_ReadoutCount) != readout_count)
+    {
+      m_parameters->setLargeIntegerValue(PicamParameter_ReadoutCount,readout_count);
+      _commitParameters();
+    }
+
+  m_metadata_parser->prepare(m_cam,m_frame_size,m_frame_stride);
+
+  // dark frames are not given to Lima
+  if(m_dark_capture)
+    m_frame_processor = NULL;
+  else
+    _setupFrameProcessing();
+
+  // Zero copy, give directly Lima buffers to PICam
+  m_in_place = !m_dark_capture && !m_frame_processor &&
+    m_buffer_ctrl_obj->canUseInPlace(m_readout_stride,m_frames_per_readout);
+  if(m_in_place)
+    {
+      void* memory;
+      long memory_size;
+      m_buffer_ctrl_obj->getAcquisitionBuffer(memory,memory_size);
+      _setAcquisitionBuffer(memory,memory_size);
+      _freePixelBuffer();
+      m_buffer_readouts = memory_size / m_readout_stride;
+    }
+  else
+    {
+      if(m_buffer_ctrl_obj->getZeroCopy())
+	DEB_WARNING() << "Lima buffers can't be used by PICam, "
+		      << "fall back to copy " << DEB_VAR2(m_readout_stride,
+							   m_frames_per_readout);
+      // - get the current readout rate
+      // - note this accounts for rate increases in online scenarios
+      piflt onlineReadoutRate;
+      CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
+						       PicamParameter_OnlineReadoutRateCalculation,
+						       &onlineReadoutRate));
+      // - calculate the buffer size
+      pi64s readouts = m_buffer_policy->computeReadouts(onlineReadoutRate,
+							 m_readout_stride);
+      long exp_bytes = m_readout_stride * readouts;
+      if(exp_bytes != m_pixel_stream.memory_size)
+	{
+	  AcqMemory* buffer = m_buffer_pool->get(exp_bytes,*m_alloc_options);
+	  m_buffer_pool->pin(buffer);
+	  m_pixel_stream.memory = buffer->getMemory();
+	  m_pixel_stream.memory_size = exp_bytes;
+	}
+      _setAcquisitionBuffer(m_pixel_stream.memory,m_pixel_stream.memory_size);
+      m_buffer_readouts = readouts;
+    }
+  {
+    AutoMutex lock(m_metadata_mutex);
+    m_last_metadata_frame = -1;
+  }
+  if(m_in_place && m_data_loss_policy == InsertGapFrames)
+    DEB_WARNING() << "Gap frames can't be inserted in zero copy, "
+		  << "frames will be renumbered after a data loss";
+  m_next_frame_tracking = -1;
+  m_nb_lost_frames = 0;
+  m_nb_data_loss_events = 0;
+  m_readout_queue->resetHighWaterMark();
+  m_pending_readouts = 0;
+  m_peak_pending_readouts = 0;
+  m_nb_buffer_overruns = 0;
+  m_dispatched_readouts = 0;
+  m_dispatch_busy_time = 0.;
+  m_nb_acquired_frames = 0;
+  m_rate_start = 0;
+  m_rate_start_frames = 0;
+  m_rate_end = 0;
+  checkAcquisition();
+  _sampleSensorTemperature();
   m_status = Ready;
 }
 
@@ -266,7 +462,15 @@ void Interface::prepareAcq()
 void Interface::startAcq()
 {
   DEB_MEMBER_FUNCT();
-  m_buffer_ctrl_obj.getBuffer().setStartTimestamp(Timestamp::now());
+  {
+    // a stop of the previous acquisition must not hit this one
+    AutoMutex lock(m_control_cond.mutex());
+    while(m_stop_pending)
+      m_control_cond.wait();
+    m_stop_requested = false;
+    m_stop_start = 0;
+  }
+  m_buffer_ctrl_obj->getBuffer().setStartTimestamp(Timestamp::now());
   AutoMutex lock(m_cond.mutex());
   CHECK_PICAM(Picam_StartAcquisition(m_cam));
   // Change acquisition status.
@@ -277,12 +481,99 @@ void Interface::startAcq()
 void Interface::stopAcq()
 {
   DEB_MEMBER_FUNCT();
+  // later stop requests of this acquisition are ignored
+  m_stop_requested = true;
+  long long no_stop = 0;
+  m_stop_start.compare_exchange_strong(no_stop,LatencyHistogram::now());
+  _stopAcquisition();
+}
+
+/** @brief stop PICam and wait the end of the acquisition, at most the
+ *  stop timeout; on timeout the camera is put in fault.
+ */
+void Interface::_stopAcquisition()
+{
+  DEB_MEMBER_FUNCT();
+  {
+    AutoMutex lock(m_cond.mutex());
+    if(m_status != Running)
+      return;
+  }
   CHECK_PICAM(Picam_StopAcquisition(m_cam));
   // Wait acquisition stop
   AutoMutex lock(m_cond.mutex());
-  while(m_status != Ready &&
-	m_status != Fault)
-    m_cond.wait();
+  long long deadline = LatencyHistogram::now() + (long long)(m_stop_timeout * 1e9);
+  while(m_status == Running)
+    {
+      double remaining = (deadline - LatencyHistogram::now()) * 1e-9;
+      if(remaining <= 0. || (!m_cond.wait(remaining) && m_status == Running))
+	{
+	  m_status = Fault;
+	  m_cond.broadcast();
+	  THROW_HW_ERROR(Error) << "Acquisition not stopped after "
+				<< DEB_VAR1(m_stop_timeout);
+	}
+    }
+}
+
+/** @brief called by the acquisition threads when Lima wants no more
+ *  frames: no allocation, only the first request of an acquisition
+ *  wakes the control thread.
+ */
+void Interface::_requestStop()
+{
+  if(m_stop_requested.exchange(true))
+    return;
+  long long no_stop = 0;
+  m_stop_start.compare_exchange_strong(no_stop,LatencyHistogram::now());
+  AutoMutex lock(m_control_cond.mutex());
+  m_stop_pending = true;
+  m_control_cond.broadcast();
+}
+
+void Interface::_controlLoop()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_control_cond.mutex());
+  while(true)
+    {
+      while(!m_stop_pending && !m_quit_control)
+	m_control_cond.wait();
+      if(m_quit_control) break;
+
+      {
+	AutoMutexUnlock u(lock);
+	try
+	  {
+	    _stopAcquisition();
+	  }
+	catch(Exception& e)
+	  {
+	    DEB_ERROR() << "Acquisition stop failed: " << e.getErrMsg();
+	  }
+      }
+      m_stop_pending = false;
+      m_control_cond.broadcast();
+    }
+}
+
+void Interface::setStopTimeout(double timeout)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(timeout);
+  if(timeout <= 0.)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(timeout);
+  m_stop_timeout = timeout;
+}
+
+void Interface::getStopTimeout(double& timeout) const
+{
+  timeout = m_stop_timeout;
+}
+
+void Interface::getLastStopTime(double& stop_time) const
+{
+  stop_time = m_last_stop_time;
 }
 
 void Interface::getStatus(StatusType& status)
@@ -309,59 +600,1454 @@ int Interface::getNbHwAcquiredFrames()
   return m_acq_frames;
 }
 
-void Interface::newFrameReady(const PicamAvailableData* available,
-			      const PicamAcquisitionStatus* status)
+void Interface::setBufferTargetTime(double target_time)
+{
+  m_buffer_policy->setTargetTime(target_time);
+}
+
+void Interface::getBufferTargetTime(double& target_time) const
+{
+  target_time = m_buffer_policy->getTargetTime();
+}
+
+void Interface::setBufferMemoryCap(long long memory_cap)
+{
+  m_buffer_policy->setMemoryCap(memory_cap);
+}
+
+void Interface::getBufferMemoryCap(long long& memory_cap) const
+{
+  memory_cap = m_buffer_policy->getMemoryCap();
+}
+
+void Interface::setBufferAutoGrow(bool flag)
+{
+  m_buffer_policy->setAutoGrow(flag);
+}
+
+void Interface::getBufferAutoGrow(bool& flag) const
+{
+  flag = m_buffer_policy->getAutoGrow();
+}
+
+void Interface::getBufferReadouts(long long& nb_readouts) const
+{
+  nb_readouts = m_buffer_readouts;
+}
+
+void Interface::getBufferOccupancy(double& occupancy) const
+{
+  occupancy = m_buffer_readouts ?
+    double(m_pending_readouts) / m_buffer_readouts : 0.;
+}
+
+void Interface::getBufferPeakOccupancy(double& occupancy) const
+{
+  occupancy = m_buffer_readouts ?
+    double(m_peak_pending_readouts) / m_buffer_readouts : 0.;
+}
+
+void Interface::getBufferOverruns(long long& nb_overruns) const
+{
+  nb_overruns = m_nb_buffer_overruns;
+}
+
+void Interface::getBufferRecommendedReadouts(long long& nb_readouts) const
+{
+  nb_readouts = m_buffer_policy->getRecommendedReadouts();
+}
+
+void Interface::setBufferHugePages(HugePages huge_pages)
 {
   DEB_MEMBER_FUNCT();
-  // Read data if any
-  if(available && available->readout_count)
+  DEB_PARAM() << DEB_VAR1(huge_pages);
+  switch(huge_pages)
     {
-      StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
-      for(int i = 0;i < available->readout_count;++i)
-	{
-	  pibyte* first_framePt = (pibyte*)available->initial_readout;
-	  first_framePt += m_readout_stride * i;
-	  for(int fid = 0;fid < m_frames_per_readout;++fid)
-	    {
-	      pibyte *src_framePt = first_framePt + m_frame_stride * fid;
-	      void* framePt = buffer_mgr.getFrameBufferPtr(++m_acq_frames);
-	      memcpy(framePt,src_framePt,m_frame_size);
-	      HwFrameInfoType frame_info;
-	      frame_info.acq_frame_nb = m_acq_frames;
-	      bool continueAcq = buffer_mgr.newFrameReady(frame_info);
-	      if(!continueAcq)
-		{
-		  _StopAcq *aStopAcqPt = new _StopAcq(*this);
-		  TaskMgr *mgr = new TaskMgr();
-		  mgr->addSinkTask(0,aStopAcqPt);
-		  aStopAcqPt->unref();
+    case HugePages2MB:
+      m_alloc_options->huge_page_size = size_t(2) << 20; break;
+    case HugePages1GB:
+      m_alloc_options->huge_page_size = size_t(1) << 30; break;
+    default:
+      m_alloc_options->huge_page_size = 0; break;
+    }
+  _setAllocOptions();
+}
 
-		  PoolThreadMgr::get().addProcess(mgr);
-		}
-	    }
-	}
+void Interface::getBufferHugePages(HugePages& huge_pages) const
+{
+  switch(m_alloc_options->huge_page_size)
+    {
+    case size_t(2) << 20:
+      huge_pages = HugePages2MB; break;
+    case size_t(1) << 30:
+      huge_pages = HugePages1GB; break;
+    default:
+      huge_pages = NoHugePages; break;
     }
-  // Acquisition status
-  bool running = status->running;
-  bool errors = bool(status->errors);
-  AutoMutex lock(m_cond.mutex());
-  if(m_status != Fault)
+}
+
+void Interface::setBufferLocked(bool flag)
+{
+  m_alloc_options->lock = flag;
+  _setAllocOptions();
+}
+
+void Interface::getBufferLocked(bool& flag) const
+{
+  flag = m_alloc_options->lock;
+}
+
+void Interface::setBufferPrefault(bool flag)
+{
+  m_alloc_options->prefault = flag;
+  _setAllocOptions();
+}
+
+void Interface::getBufferPrefault(bool& flag) const
+{
+  flag = m_alloc_options->prefault;
+}
+
+void Interface::setBufferNumaNode(int numa_node)
+{
+  m_alloc_options->numa_node = numa_node < 0 ? -1 : numa_node;
+  _setAllocOptions();
+}
+
+void Interface::getBufferNumaNode(int& numa_node) const
+{
+  numa_node = m_alloc_options->numa_node;
+}
+
+void Interface::setBufferNumaNodeFromCpu(int cpu)
+{
+  setBufferNumaNode(AcqMemory::getNumaNodeOfCpu(cpu));
+}
+
+void Interface::setBufferNumaNodeFromDevice(const std::string& sysfs_path)
+{
+  setBufferNumaNode(AcqMemory::getNumaNodeOfDevice(sysfs_path));
+}
+
+/** @brief buffers are re-allocated with the new options
+ *  at the next prepareAcq.
+ */
+void Interface::_setAllocOptions()
+{
+  DEB_MEMBER_FUNCT();
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change buffer allocation while running";
+
+  // PICam must not keep a buffer about to be freed
+  _setAcquisitionBuffer(NULL,0);
+  _freePixelBuffer();
+  m_buffer_ctrl_obj->setAllocOptions(*m_alloc_options);
+  m_buffer_pool->clear();
+}
+
+void Interface::setBufferPoolMaxMemory(long long max_memory)
+{
+  m_buffer_pool->setMaxMemory(max_memory);
+}
+
+void Interface::getBufferPoolMaxMemory(long long& max_memory) const
+{
+  max_memory = m_buffer_pool->getMaxMemory();
+}
+
+void Interface::getBufferPoolMemory(long long& memory) const
+{
+  memory = m_buffer_pool->getMemory();
+}
+
+void Interface::getBufferPoolNbBuffers(int& nb_buffers) const
+{
+  nb_buffers = m_buffer_pool->getNbBuffers();
+}
+
+void Interface::getReadoutQueueDepth(int& depth) const
+{
+  depth = m_readout_queue->depth();
+}
+
+void Interface::getReadoutQueueHighWaterMark(int& high_water_mark) const
+{
+  high_water_mark = m_readout_queue->highWaterMark();
+}
+
+void Interface::getLatencyStats(LatencyStage stage,long long& count,double& mean,
+				double& p50,double& p99,double& max) const
+{
+  DEB_MEMBER_FUNCT();
+  if(int(stage) < 0 || int(stage) >= NB_LATENCY_STAGES)
+    THROW_HW_ERROR(InvalidValue) << "Invalid latency " << DEB_VAR1(stage);
+  LatencyStats stats;
+  m_latency[stage].getStats(stats);
+  count = stats.count;
+  mean = stats.mean;
+  p50 = stats.p50;
+  p99 = stats.p99;
+  max = stats.max;
+}
+
+void Interface::getLatencyHistogram(LatencyStage stage,
+				    std::vector<double>& upper_bounds,
+				    std::vector<int>& counts) const
+{
+  DEB_MEMBER_FUNCT();
+  if(int(stage) < 0 || int(stage) >= NB_LATENCY_STAGES)
+    THROW_HW_ERROR(InvalidValue) << "Invalid latency " << DEB_VAR1(stage);
+  m_latency[stage].getBuckets(upper_bounds,counts);
+}
+
+/** @brief clear the latency histograms, e.g. between scans; a readout
+ *  dispatched during the reset may be partly kept.
+ */
+void Interface::resetLatencyStats()
+{
+  DEB_MEMBER_FUNCT();
+  for(int i = 0;i < NB_LATENCY_STAGES;++i)
+    m_latency[i].reset();
+}
+
+void Interface::getNbAcquiredFrames(long long& nb_frames) const
+{
+  nb_frames = m_nb_acquired_frames;
+}
+
+void Interface::getAchievedFrameRate(double& frame_rate) const
+{
+  long long nb_frames = m_nb_acquired_frames - m_rate_start_frames;
+  long long elapsed = m_rate_end - m_rate_start;
+  frame_rate = (nb_frames > 0 && elapsed > 0) ? nb_frames * 1e9 / elapsed : 0.;
+}
+
+void Interface::getAcqReadoutTime(double& readout_time) const
+{
+  readout_time = m_acq_readout_time;
+}
+
+void Interface::getSensorTemperature(double& temperature) const
+{
+  temperature = m_sensor_temperature;
+}
+
+/** @brief layout of the PICam readouts, read by prepareAcq
+ */
+void Interface::getReadoutGeometry(int& frame_size,int& frame_stride,
+				   int& frames_per_readout,int& readout_stride) const
+{
+  frame_size = m_frame_size;
+  frame_stride = m_frame_stride;
+  frames_per_readout = m_frames_per_readout;
+  readout_stride = m_readout_stride;
+}
+
+/** @brief called from PICam acquisition thread.
+ *  Only queue the readout descriptor, frames are dispatched to Lima
+ *  by the dispatcher thread so a slow consumer never blocks PICam.
+ */
+void Interface::readoutAvailable(const PicamAvailableData* available,
+				 const PicamAcquisitionStatus* status)
+{
+  Readout readout;
+  readout.entry_time = LatencyHistogram::now();
+  readout.initial_readout = available ? available->initial_readout : NULL;
+  readout.readout_count = available ? available->readout_count : 0;
+  readout.running = status->running;
+  readout.errors = status->errors;
+
+  long long pending = m_pending_readouts += readout.readout_count;
+  if(pending > m_peak_pending_readouts)
+    m_peak_pending_readouts = pending;
+  // PICam takes the readouts as consumed when we return: once the buffer
+  // is full of undispatched readouts it overwrites the oldest one. In
+  // zero copy it also overwrites frames Lima has not released yet.
+  bool overrun = (readout.readout_count && m_buffer_readouts &&
+		  pending >= m_buffer_readouts);
+  if(m_in_place && !overrun)
+    for(pi64s i = 0;i < readout.readout_count && !overrun;++i)
+      overrun = m_buffer_ctrl_obj->isFrameHeld((pibyte*)readout.initial_readout +
+					       m_readout_stride * i);
+  if(overrun)
     {
-      if(errors)
-	m_status = Fault;
-      else
-	m_status = running ? Running : Ready;
+      ++m_nb_buffer_overruns;
+      readout.errors = PicamAcquisitionErrorsMask(readout.errors |
+						  PicamAcquisitionErrorsMask_DataLost);
     }
-  m_cond.broadcast();
+
+  while(!m_readout_queue->push(readout))
+    std::this_thread::yield();
+
+  // pairs with the fence of the dispatcher: either it sees the readout
+  // or we see it waiting
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(m_dispatcher_waiting.load(std::memory_order_relaxed))
+    {
+      AutoMutex lock(m_dispatch_cond.mutex());
+      m_dispatch_cond.signal();
+    }
+}
+
+void Interface::_dispatchReadouts()
+{
+  DEB_MEMBER_FUNCT();
+  Readout readout;
+  while(true)
+    {
+      if(!m_readout_queue->pop(readout))
+	{
+	  AutoMutex lock(m_dispatch_cond.mutex());
+	  if(m_quit_dispatcher) break;
+	  m_dispatcher_waiting.store(true,std::memory_order_relaxed);
+	  std::atomic_thread_fence(std::memory_order_seq_cst);
+	  if(m_readout_queue->empty())
+	    m_dispatch_cond.wait();
+	  m_dispatcher_waiting = false;
+	  continue;
+	}
+
+      PicamAvailableData available = {readout.initial_readout,readout.readout_count};
+      PicamAcquisitionStatus status = {readout.running,readout.errors,0.};
+      if(readout.readout_count)
+	m_latency[DeliveryLatency].record(LatencyHistogram::now() -
+					  readout.entry_time);
+      Timestamp start = Timestamp::now();
+      bool failed = false;
+      try
+	{
+	  _processFrames(&available);
+	}
+      catch(Exception& e)
+	{
+	  DEB_ERROR() << "Readout dispatch failed: " << e.getErrMsg();
+	  failed = true;
+	}
+      if(readout.readout_count)
+	m_latency[TotalLatency].record(LatencyHistogram::now() -
+				       readout.entry_time);
+      m_pending_readouts -= readout.readout_count;
+      m_dispatched_readouts += readout.readout_count;
+      m_dispatch_busy_time += Timestamp::now() - start;
+
+      // Lima may prepare the next acquisition as soon as it sees Ready:
+      // everything about this one is done before the status is published
+      if(!readout.running)
+	{
+	  m_buffer_policy->acquisitionDone(m_buffer_readouts,m_peak_pending_readouts,
+					   m_dispatched_readouts,m_dispatch_busy_time,
+					   m_nb_buffer_overruns);
+	  _sampleSensorTemperature();
+	}
+      _updateStatus(&status,failed);
+    }
+}
+
+void Interface::newFrameReady(const PicamAvailableData* available,
+			      const PicamAcquisitionStatus* status)
+{
+  DEB_MEMBER_FUNCT();
+  _processFrames(available);
+  _updateStatus(status,false);
+}
+
+/** @brief hand the frames of the readouts to Lima
+ */
+void Interface::_processFrames(const PicamAvailableData* available)
+{
+  DEB_MEMBER_FUNCT();
+  // Read data if any
+  if(available && available->readout_count)
+    {
+      m_batch_start = LatencyHistogram::now();
+      int first_frame_nb = m_acq_frames + 1;
+      for(int i = 0;i < available->readout_count;++i)
+	{
+	  pibyte* first_framePt = (pibyte*)available->initial_readout;
+	  first_framePt += m_readout_stride * i;
+	  for(int fid = 0;fid < m_frames_per_readout;++fid)
+	    {
+	      if(m_nb_frames && m_acq_frames + 1 >= m_nb_frames)
+		break;
+	      pibyte *src_framePt = first_framePt + m_frame_stride * fid;
+	      if(m_dark_capture)
+		{
+		  m_correction->addDark(src_framePt);
+		  ++m_acq_frames;
+		  continue;
+		}
+	      FrameMetadata metadata;
+	      if(m_metadata_parser->hasMetadata())
+		m_metadata_parser->parse(src_framePt,metadata);
+
+	      long long nb_lost = _checkFrameTracking(metadata);
+	      if(nb_lost)
+		{
+		  _dataLost(m_acq_frames + 1,nb_lost);
+		  if(m_data_loss_policy == InsertGapFrames && !m_in_place)
+		    {
+		      FrameMetadata gap;
+		      gap.lost = true;
+		      // a wrong tracking counter must not fill more than the
+		      // frames left (hardware frames in accumulation) before
+		      // the current one
+		      long long nb_gaps = nb_lost;
+		      if(m_nb_frames)
+			nb_gaps = std::min(nb_gaps,
+					   (long long)(m_nb_frames - m_acq_frames - 1) *
+					   m_accumulation - m_frame_in_sum - 1);
+		      for(long long lost = 0;lost < nb_gaps;++lost)
+			_addFrame(NULL,gap,first_frame_nb);
+		    }
+		}
+	      _addFrame(src_framePt,metadata,first_frame_nb);
+	    }
+	}
+      if(!m_dark_capture)
+	_flushFrames(first_frame_nb);
+    }
+}
+
+/** @brief publish the acquisition status, failed when the frames of
+ *  the readouts couldn't be handed to Lima.
+ */
+void Interface::_updateStatus(const PicamAcquisitionStatus* status,bool failed)
+{
+  DEB_MEMBER_FUNCT();
+  bool running = status->running;
+  int errors = status->errors;
+  if(errors)
+    {
+      ++m_nb_data_loss_events;
+      DEB_WARNING() << "Acquisition error " << DEB_VAR2(errors,m_acq_frames);
+      // without frame tracking, the number of lost frames is unknown
+      if(!m_metadata_parser->hasFrameTracking())
+	_dataLost(m_acq_frames + 1,-1);
+    }
+  const int recoverable_errors = (PicamAcquisitionErrorsMask_DataLost |
+				  PicamAcquisitionErrorsMask_ConnectionLost);
+  bool fault = errors && (m_data_loss_policy == FaultOnDataLoss || !running ||
+			  (errors & ~recoverable_errors));
+  AutoMutex lock(m_cond.mutex());
+  if(m_status != Fault)
+    {
+      if(fault || failed)
+	m_status = Fault;
+      else
+	m_status = running ? Running : Ready;
+    }
+  if(!running)
+    {
+      long long stop_start = m_stop_start.exchange(0);
+      if(stop_start)
+	m_last_stop_time = (LatencyHistogram::now() - stop_start) * 1e-9;
+    }
+  m_cond.broadcast();
+}
+
+/** @brief add one frame to the batch, src_framePt is NULL for a gap frame.
+ *  In accumulation, the Lima frame is added once its last hardware
+ *  frame is, its metadata are the ones of the first hardware frame.
+ */
+void Interface::_addFrame(void* src_framePt,const FrameMetadata& metadata,
+			  int& first_frame_nb)
+{
+  DEB_MEMBER_FUNCT();
+  StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj->getBuffer();
+  void* framePt = buffer_mgr.getFrameBufferPtr(m_acq_frames + 1);
+  const FrameProcessor* processor = m_frame_processor;
+  if(m_accumulation > 1)
+    {
+      processor = m_accumulator->getStage(m_frame_in_sum);
+      if(!m_frame_in_sum)
+	m_sum_metadata = metadata;
+      else if(metadata.lost)
+	m_sum_metadata.lost = true;
+    }
+  // a gap frame adds nothing to a sum
+  if(!src_framePt)
+    {
+      if(!m_frame_in_sum)
+	memset(framePt,0,m_lima_frame_size);
+    }
+  // In zero copy, PICam already wrote the readout in Lima buffer
+  else if(framePt != src_framePt)
+    {
+      if(m_in_place)
+	DEB_WARNING() << "PICam readout not in Lima buffer for "
+		      << DEB_VAR1(m_acq_frames + 1);
+      m_frame_copy->add(framePt,src_framePt,m_frame_size,processor);
+    }
+  if(m_accumulation > 1 && ++m_frame_in_sum < m_accumulation)
+    return;
+
+  m_frame_in_sum = 0;
+  ++m_acq_frames;
+  m_batch_metadata[m_acq_frames - first_frame_nb] =
+    m_accumulation > 1 ? m_sum_metadata : metadata;
+  if(m_acq_frames - first_frame_nb + 1 >= MAX_COPY_BATCH)
+    {
+      _flushFrames(first_frame_nb);
+      first_frame_nb = m_acq_frames + 1;
+    }
+}
+
+/** @brief number of frames missing before this one from the camera
+ *  frame tracking counter
+ */
+long long Interface::_checkFrameTracking(const FrameMetadata& metadata)
+{
+  if(metadata.frame_tracking < 0)
+    return 0;
+
+  long long nb_lost = 0;
+  if(m_next_frame_tracking >= 0 && metadata.frame_tracking > m_next_frame_tracking)
+    nb_lost = metadata.frame_tracking - m_next_frame_tracking;
+  m_next_frame_tracking = metadata.frame_tracking + 1;
+  return nb_lost;
+}
+
+void Interface::_dataLost(int frame_nb,long long nb_frames)
+{
+  DEB_MEMBER_FUNCT();
+  if(nb_frames > 0)
+    {
+      m_nb_lost_frames += nb_frames;
+      DEB_WARNING() << nb_frames << " frame(s) lost before " << DEB_VAR1(frame_nb);
+    }
+
+  AutoMutex lock(m_data_loss_mutex);
+  if(m_data_loss_cb)
+    {
+      try
+	{
+	  m_data_loss_cb->dataLost(frame_nb,nb_frames);
+	}
+      catch(...)
+	{
+	  DEB_ERROR() << "Data loss callback failed";
+	}
+    }
+}
+
+/** @brief copy pending frames (in parallel) then give them to Lima
+ */
+void Interface::_flushFrames(int first_frame_nb)
+{
+  DEB_MEMBER_FUNCT();
+  m_frame_copy->flush();
+  bool has_frames = first_frame_nb <= m_acq_frames;
+  long long copy_done = LatencyHistogram::now();
+  if(has_frames)
+    m_latency[CopyLatency].record(copy_done - m_batch_start);
+
+  StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj->getBuffer();
+  Timestamp start_timestamp;
+  buffer_mgr.getStartTimestamp(start_timestamp);
+  double host_timestamp = Timestamp::now() - start_timestamp;
+  {
+    AutoMutex lock(m_metadata_mutex);
+    for(int frame_nb = first_frame_nb;frame_nb <= m_acq_frames;++frame_nb)
+      {
+	FrameMetadata& metadata = m_batch_metadata[frame_nb - first_frame_nb];
+	metadata.host_timestamp = host_timestamp;
+	m_metadata_history[frame_nb % METADATA_HISTORY] = metadata;
+      }
+    m_last_metadata_frame = m_acq_frames;
+  }
+
+  for(int frame_nb = first_frame_nb;frame_nb <= m_acq_frames;++frame_nb)
+    {
+      HwFrameInfoType frame_info;
+      frame_info.acq_frame_nb = frame_nb;
+      // Exposure start from the camera clock, else Lima uses the host time
+      const FrameMetadata& metadata = m_batch_metadata[frame_nb - first_frame_nb];
+      if(metadata.exposure_started >= 0.)
+	frame_info.frame_timestamp = Timestamp(metadata.exposure_started);
+      else if(metadata.exposure_ended >= 0.)
+	frame_info.frame_timestamp = Timestamp(metadata.exposure_ended);
+      bool continueAcq = buffer_mgr.newFrameReady(frame_info);
+      if(!continueAcq)
+	_requestStop();
+    }
+  long long notified = LatencyHistogram::now();
+  if(has_frames)
+    {
+      m_latency[NotifyLatency].record(notified - copy_done);
+      // rate from the end of the first batch
+      if(!m_rate_start)
+	{
+	  m_rate_start_frames = m_acq_frames + 1;
+	  m_rate_start = notified;
+	}
+      m_rate_end = notified;
+      m_nb_acquired_frames = m_acq_frames + 1;
+    }
+  m_batch_start = notified;
+}
+
+void Interface::getParameterCacheHits(long long& nb_hits) const
+{
+  nb_hits = m_parameters->getNbHits();
+}
+
+void Interface::getParameterCacheMisses(long long& nb_misses) const
+{
+  nb_misses = m_parameters->getNbMisses();
+}
+
+void Interface::resetParameterCacheCounters()
+{
+  m_parameters->resetCounters();
+}
+
+void Interface::beginParameterTransaction()
+{
+  DEB_MEMBER_FUNCT();
+  m_parameters->beginTransaction();
+}
+
+void Interface::commitParameterTransaction()
+{
+  DEB_MEMBER_FUNCT();
+  if(!m_parameters->inTransaction())
+    THROW_HW_ERROR(Error) << "No parameter transaction to commit";
+
+  std::vector<std::string> errors;
+  m_parameters->endTransaction(errors);
+  _commitParameters(errors);
+}
+
+void Interface::getParameterTransaction(bool& flag) const
+{
+  flag = m_parameters->inTransaction();
+}
+
+void Interface::getCommitErrors(std::vector<std::string>& errors) const
+{
+  errors = m_commit_errors;
+}
+
+void Interface::getCommitTime(double& last_time,double& mean_time,
+			      double& max_time) const
+{
+  last_time = m_last_commit_time;
+  mean_time = m_nb_commits ? m_total_commit_time / m_nb_commits : 0.;
+  max_time = m_max_commit_time;
+}
+
+void Interface::getNbCommits(int& nb_commits) const
+{
+  nb_commits = m_nb_commits;
+}
+
+/** @brief one commit of all the changed parameters from the camera
+ *  model to the device, errors are the ones of the parameters
+ *  rejected when set followed by the one of the commit
+ */
+void Interface::_commitParameters(const std::vector<std::string>& errors)
+{
+  DEB_MEMBER_FUNCT();
+  m_commit_errors = errors;
+  Timestamp start = Timestamp::now();
+  PicamHandle model;
+  CHECK_PICAM(PicamAdvanced_GetCameraModel(m_cam,&model));
+  PicamError error = PicamAdvanced_CommitParametersToCameraDevice(model);
+  double commit_time = Timestamp::now() - start;
+  if(error != PicamError_None)
+    m_commit_errors.push_back("Commit: " + get_error_message(error));
+
+  ++m_nb_commits;
+  m_last_commit_time = commit_time;
+  m_total_commit_time += commit_time;
+  m_max_commit_time = std::max(m_max_commit_time,commit_time);
+  DEB_TRACE() << DEB_VAR2(commit_time,m_commit_errors.size());
+
+  if(!m_commit_errors.empty())
+    {
+      std::string msg;
+      for(auto i = m_commit_errors.begin();i != m_commit_errors.end();++i)
+	msg += (msg.empty() ? "" : ", ") + *i;
+      THROW_HW_ERROR(InvalidValue) << "Parameters commit failed: " << msg;
+    }
+}
+
+void Interface::saveProfile(const std::string& name)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(name);
+
+  pibln committed;
+  CHECK_PICAM(Picam_AreParametersCommitted(m_cam,&committed));
+  if(!committed)
+    _commitParameters();
+
+  Profile* profile = new Profile();
+  try
+    {
+      profile->capture(m_cam);
+    }
+  catch(...)
+    {
+      delete profile;
+      throw;
+    }
+  profile->setBufferSize(m_pixel_stream.memory_size);
+  profile->setAllocOptions(*m_alloc_options);
+
+  auto i = m_profiles.find(name);
+  if(i != m_profiles.end())
+    {
+      delete i->second;
+      i->second = profile;
+    }
+  else
+    m_profiles[name] = profile;
+}
+
+/** @brief set the parameters which differ from the profile with one
+ *  commit and get its acquisition buffer ready in the pool
+ */
+void Interface::activateProfile(const std::string& name)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(name);
+
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change profile while running";
+
+  Profile& profile = _getProfile(name);
+  Timestamp start = Timestamp::now();
+  std::vector<std::string> errors;
+  m_parameters->beginTransaction();
+  int nb_changed;
+  try
+    {
+      nb_changed = profile.apply(*m_parameters);
+    }
+  catch(...)
+    {
+      m_parameters->endTransaction(errors);
+      throw;
+    }
+  m_parameters->endTransaction(errors);
+
+  pibln committed;
+  CHECK_PICAM(Picam_AreParametersCommitted(m_cam,&committed));
+  if(!committed || !errors.empty())
+    _commitParameters(errors);
+  m_sync->readoutChanged();
+
+  const AcqMemoryOptions& options = profile.getAllocOptions();
+  if(options.huge_page_size != m_alloc_options->huge_page_size ||
+     options.lock != m_alloc_options->lock ||
+     options.prefault != m_alloc_options->prefault ||
+     options.numa_node != m_alloc_options->numa_node)
+    {
+      *m_alloc_options = options;
+      _setAllocOptions();
+    }
+  // the buffer PICam uses is pinned in the pool, pre-allocation only
+  // happens when it doesn't evict other buffers either
+  long long buffer_size = profile.getBufferSize();
+  if(buffer_size && !m_buffer_ctrl_obj->getZeroCopy())
+    {
+      if(m_buffer_pool->contains(buffer_size) ||
+	 m_buffer_pool->getMemory() + buffer_size <= m_buffer_pool->getMaxMemory())
+	m_buffer_pool->get(buffer_size,*m_alloc_options);
+      else
+	DEB_TRACE() << "Buffer pool full, profile buffer allocated by prepareAcq";
+    }
+
+  double activation_time = Timestamp::now() - start;
+  DEB_TRACE() << DEB_VAR3(name,nb_changed,activation_time);
+}
+
+void Interface::deleteProfile(const std::string& name)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(name);
+  Profile& profile = _getProfile(name);
+  delete &profile;
+  m_profiles.erase(name);
+}
+
+void Interface::getProfileList(std::vector<std::string>& names) const
+{
+  names.clear();
+  for(auto i = m_profiles.begin();i != m_profiles.end();++i)
+    names.push_back(i->first);
+}
+
+void Interface::writeProfile(const std::string& name,
+			     const std::string& filename)
+{
+  DEB_MEMBER_FUNCT();
+  _getProfile(name).save(filename);
+}
+
+void Interface::readProfile(const std::string& name,
+			    const std::string& filename)
+{
+  DEB_MEMBER_FUNCT();
+  Profile* profile = new Profile();
+  try
+    {
+      profile->load(filename);
+    }
+  catch(...)
+    {
+      delete profile;
+      throw;
+    }
+  auto i = m_profiles.find(name);
+  if(i != m_profiles.end())
+    {
+      delete i->second;
+      i->second = profile;
+    }
+  else
+    m_profiles[name] = profile;
+}
+
+Profile& Interface::_getProfile(const std::string& name)
+{
+  DEB_MEMBER_FUNCT();
+  auto i = m_profiles.find(name);
+  if(i == m_profiles.end())
+    THROW_HW_ERROR(InvalidValue) << "Unknown profile " << DEB_VAR1(name);
+  return *i->second;
+}
+
+void Interface::getFrameMetadata(int frame_nb,FrameMetadata& metadata) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(frame_nb);
+  AutoMutex lock(m_metadata_mutex);
+  if(frame_nb < 0 || frame_nb > m_last_metadata_frame ||
+     frame_nb <= m_last_metadata_frame - METADATA_HISTORY)
+    THROW_HW_ERROR(InvalidValue) << "No metadata for " << DEB_VAR1(frame_nb)
+				 << ", last frame is " << m_last_metadata_frame;
+  metadata = m_metadata_history[frame_nb % METADATA_HISTORY];
+}
+
+void Interface::setDataLossPolicy(DataLossPolicy policy)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(policy);
+  m_data_loss_policy = policy;
+}
+
+void Interface::getDataLossPolicy(DataLossPolicy& policy) const
+{
+  policy = m_data_loss_policy;
+}
+
+void Interface::getNbLostFrames(long long& nb_frames) const
+{
+  nb_frames = m_nb_lost_frames;
+}
+
+void Interface::getNbDataLossEvents(int& nb_events) const
+{
+  nb_events = m_nb_data_loss_events;
+}
+
+void Interface::registerDataLossCallback(DataLossCallback& cb)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_data_loss_mutex);
+  if(m_data_loss_cb)
+    THROW_HW_ERROR(InvalidValue) << "A data loss callback is already registered";
+  m_data_loss_cb = &cb;
+}
+
+void Interface::unregisterDataLossCallback(DataLossCallback& cb)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_data_loss_mutex);
+  if(m_data_loss_cb != &cb)
+    THROW_HW_ERROR(InvalidValue) << "Data loss callback is not registered";
+  m_data_loss_cb = NULL;
+}
+
+void Interface::setReadoutMode(ReadoutMode mode)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(mode);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change readout mode while running";
+
+  ReadoutMode previous_mode;
+  m_sync->getReadoutMode(previous_mode);
+  m_sync->setReadoutMode(mode);
+  try
+    {
+      _updateReadoutWindow();
+    }
+  catch(...)
+    {
+      m_sync->setReadoutMode(previous_mode);
+      throw;
+    }
+}
+
+void Interface::getReadoutMode(ReadoutMode& mode) const
+{
+  m_sync->getReadoutMode(mode);
+}
+
+void Interface::setKineticsWindowHeight(int height)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(height);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change kinetics window while running";
+
+  m_sync->setKineticsWindowHeight(height);
+  _updateReadoutWindow();
+}
+
+void Interface::getKineticsWindowHeight(int& height) const
+{
+  m_sync->getKineticsWindowHeight(height);
+}
+
+/** @brief in kinetics, a Lima frame is one kinetics window
+ */
+void Interface::_updateReadoutWindow()
+{
+  DEB_MEMBER_FUNCT();
+  ReadoutMode mode;
+  m_sync->getReadoutMode(mode);
+  int window_height = 0;
+  if(mode == Kinetics || mode == SpectraKinetics)
+    m_sync->getKineticsWindowHeight(window_height);
+  m_roi->setKineticsWindow(window_height,mode == SpectraKinetics);
+}
+
+void Interface::getPredictedTiming(double& readout_time,double& frame_rate,
+				   double& bandwidth)
+{
+  DEB_MEMBER_FUNCT();
+  Timing timing;
+  m_timing->predict(timing);
+  readout_time = timing.readout_time;
+  frame_rate = timing.frame_rate;
+  bandwidth = timing.bandwidth;
+}
+
+/** @brief the profile is set without commit for the PICam
+ *  calculations, then the current parameters are set back.
+ */
+void Interface::predictProfileTiming(const std::string& name,
+				     double& readout_time,double& frame_rate,
+				     double& bandwidth)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(name);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't predict a profile timing while running";
+  if(m_parameters->inTransaction())
+    THROW_HW_ERROR(Error) << "Can't predict a profile timing in a parameter transaction";
+
+  Profile& profile = _getProfile(name);
+  Profile current;
+  current.capture(m_cam);
+  try
+    {
+      _stageProfile(profile);
+      getPredictedTiming(readout_time,frame_rate,bandwidth);
+    }
+  catch(...)
+    {
+      _stageProfile(current);
+      throw;
+    }
+  _stageProfile(current);
+}
+
+void Interface::_stageProfile(const Profile& profile)
+{
+  DEB_MEMBER_FUNCT();
+  std::vector<std::string> errors;
+  m_parameters->beginTransaction();
+  try
+    {
+      profile.apply(*m_parameters);
+    }
+  catch(...)
+    {
+      m_parameters->endTransaction(errors);
+      throw;
+    }
+  m_parameters->endTransaction(errors);
+  if(!errors.empty())
+    THROW_HW_ERROR(InvalidValue) << "Profile can't be set: " << errors.front();
+}
+
+/** @brief the host speed is the one measured on the previous
+ *  acquisition, buffer overrun isn't checked before the first one.
+ */
+void Interface::checkAcquisition()
+{
+  DEB_MEMBER_FUNCT();
+  Timing timing;
+  m_timing->predict(timing);
+  m_acq_readout_time = timing.readout_time;
+
+  double exp_time = 0.,lat_time = 0.,min_lat_time = 0.;
+  TrigMode trig_mode;
+  m_sync->getTrigMode(trig_mode);
+  if(trig_mode == IntTrig)
+    {
+      m_sync->getExpTime(exp_time);
+      m_sync->getLatTime(lat_time);
+      min_lat_time = m_sync->getMinLatTime();
+    }
+  int nb_frames;
+  m_sync->getNbHwFrames(nb_frames);
+  nb_frames *= m_accumulation;
+  m_timing->check(timing,exp_time,lat_time,min_lat_time,nb_frames,
+		  m_buffer_readouts,m_buffer_policy->getDrainRate(),
+		  m_preflight_warnings);
+}
+
+void Interface::getPreflightWarnings(std::vector<std::string>& warnings) const
+{
+  warnings = m_preflight_warnings;
+}
+
+void Interface::setAdcSpeed(double speed)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(speed);
+  m_readout_speed->setAdcSpeed(speed);
+  m_sync->readoutChanged();
+}
+
+void Interface::getAdcSpeed(double& speed) const
+{
+  speed = m_readout_speed->getAdcSpeed();
+}
+
+void Interface::getAdcSpeedList(std::vector<double>& speeds) const
+{
+  speeds = m_readout_speed->getAdcSpeedList();
+}
+
+void Interface::setAdcQuality(AdcQuality quality)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(quality);
+  m_readout_speed->setAdcQuality(quality);
+  m_sync->readoutChanged();
+}
+
+void Interface::getAdcQuality(AdcQuality& quality) const
+{
+  quality = AdcQuality(m_readout_speed->getAdcQuality());
+}
+
+void Interface::getAdcQualityList(std::vector<int>& qualities) const
+{
+  const std::vector<piint>& values = m_readout_speed->getAdcQualityList();
+  qualities.assign(values.begin(),values.end());
+}
+
+void Interface::setAdcAnalogGain(AdcAnalogGain gain)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(gain);
+  m_readout_speed->setAdcAnalogGain(gain);
+  m_sync->readoutChanged();
+}
+
+void Interface::getAdcAnalogGain(AdcAnalogGain& gain) const
+{
+  gain = AdcAnalogGain(m_readout_speed->getAdcAnalogGain());
+}
+
+void Interface::getAdcAnalogGainList(std::vector<int>& gains) const
+{
+  const std::vector<piint>& values = m_readout_speed->getAdcAnalogGainList();
+  gains.assign(values.begin(),values.end());
+}
+
+void Interface::setReadoutPortCount(int nb_ports)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_ports);
+  m_readout_speed->setReadoutPortCount(nb_ports);
+  m_sync->readoutChanged();
+}
+
+void Interface::getReadoutPortCount(int& nb_ports) const
+{
+  nb_ports = m_readout_speed->getReadoutPortCount();
+}
+
+void Interface::getReadoutPortCountList(std::vector<int>& nb_ports) const
+{
+  const std::vector<piint>& values = m_readout_speed->getReadoutPortCountList();
+  nb_ports.assign(values.begin(),values.end());
+}
+
+/** @brief without low_noise, qualities are tried from the
+ *  least noisy one
+ */
+static std::vector<piint> _readoutQualities(bool low_noise)
+{
+  std::vector<piint> qualities;
+  qualities.push_back(PicamAdcQuality_LowNoise);
+  if(!low_noise)
+    {
+      qualities.push_back(PicamAdcQuality_HighCapacity);
+      qualities.push_back(PicamAdcQuality_HighSpeed);
+      qualities.push_back(PicamAdcQuality_ElectronMultiplied);
+    }
+  return qualities;
+}
+
+void Interface::selectFastestReadout(bool low_noise,double max_adc_speed)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(low_noise,max_adc_speed);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change readout speed while running";
+  double frame_rate = m_readout_speed->select(_readoutQualities(low_noise),
+					      max_adc_speed,0.);
+  DEB_TRACE() << DEB_VAR1(frame_rate);
+  m_sync->readoutChanged();
+}
+
+void Interface::selectReadoutForFrameRate(double frame_rate,bool low_noise)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(frame_rate,low_noise);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change readout speed while running";
+  if(frame_rate <= 0.)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(frame_rate);
+  m_readout_speed->select(_readoutQualities(low_noise),0.,frame_rate);
+  m_sync->readoutChanged();
+}
+
+void Interface::setTracks(const std::vector<int>& tracks)
+{
+  DEB_MEMBER_FUNCT();
+  m_roi->setTracks(tracks,m_track_layout == SpectrumPerTrack);
+}
+
+void Interface::getTracks(std::vector<int>& tracks) const
+{
+  m_roi->getTracks(tracks);
+}
+
+void Interface::setTrackLayout(TrackLayout layout)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(layout);
+  std::vector<int> tracks;
+  m_roi->getTracks(tracks);
+  m_roi->setTracks(tracks,layout == SpectrumPerTrack);
+  m_track_layout = layout;
+}
+
+void Interface::getTrackLayout(TrackLayout& layout) const
+{
+  layout = m_track_layout;
+}
+
+void Interface::setCopyThreads(int nb_threads)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_threads);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change copy threads while running";
+  m_frame_copy->setNbThreads(nb_threads);
+}
+
+void Interface::getCopyThreads(int& nb_threads) const
+{
+  nb_threads = m_frame_copy->getNbThreads();
+}
+
+void Interface::setCopyCpuList(const std::vector<int>& cpus)
+{
+  DEB_MEMBER_FUNCT();
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change copy CPUs while running";
+  m_frame_copy->setCpuList(cpus);
+}
+
+void Interface::getCopyCpuList(std::vector<int>& cpus) const
+{
+  m_frame_copy->getCpuList(cpus);
+}
+
+void Interface::setSpectrumRanges(const std::vector<int>& ranges)
+{
+  DEB_MEMBER_FUNCT();
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change spectrum ranges while running";
+  if(!ranges.empty() && m_accumulation > 1)
+    THROW_HW_ERROR(Error) << "Host spectra can't be used with accumulation";
+  m_roi->setSpectrumRanges(ranges);
+}
+
+void Interface::getSpectrumRanges(std::vector<int>& ranges) const
+{
+  m_roi->getSpectrumRanges(ranges);
+}
+
+void Interface::setAccumulation(int nb_frames)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_frames);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change accumulation while running";
+  if(nb_frames < 1)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+  std::vector<int> ranges;
+  m_roi->getSpectrumRanges(ranges);
+  if(nb_frames > 1 && !ranges.empty())
+    THROW_HW_ERROR(Error) << "Accumulation can't be used with host spectra";
+
+  m_accumulation = nb_frames;
+  m_det_info->setReadoutImageType(nb_frames > 1 ? Bpp32 : Bpp16);
+}
+
+void Interface::getAccumulation(int& nb_frames) const
+{
+  nb_frames = m_accumulation;
+}
+
+void Interface::setAccumulationSaturation(int level)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(level);
+  if(level < 0 || level > 0xffff)
+    THROW_HW_ERROR(InvalidValue) << "Invalid saturation " << DEB_VAR1(level);
+  m_accumulation_saturation = level;
+}
+
+void Interface::getAccumulationSaturation(int& level) const
+{
+  level = m_accumulation_saturation;
+}
+
+void Interface::setCorrection(bool flag)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(flag);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change correction while running";
+  m_correction_enabled = flag;
+}
+
+void Interface::getCorrection(bool& flag) const
+{
+  flag = m_correction_enabled;
+}
+
+void Interface::setDarkFrame(const std::vector<int>& dark)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(dark.size());
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change dark frame while running";
+  std::vector<uint16_t> values(dark.size());
+  for(size_t i = 0;i < dark.size();++i)
+    {
+      if(dark[i] < 0 || dark[i] > 0xffff)
+	THROW_HW_ERROR(InvalidValue) << "Invalid dark value " << DEB_VAR2(i,dark[i]);
+      values[i] = uint16_t(dark[i]);
+    }
+  m_correction->setDark(values);
+}
+
+void Interface::getDarkFrame(std::vector<int>& dark) const
+{
+  const std::vector<uint16_t>& values = m_correction->getDark();
+  dark.assign(values.begin(),values.end());
+}
+
+void Interface::setFlatField(const std::vector<double>& gain)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(gain.size());
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change flat field while running";
+  std::vector<float> values(gain.size());
+  for(size_t i = 0;i < gain.size();++i)
+    {
+      if(!(gain[i] >= 0. && gain[i] < 1e6))
+	THROW_HW_ERROR(InvalidValue) << "Invalid gain " << DEB_VAR2(i,gain[i]);
+      values[i] = float(gain[i]);
+    }
+  m_correction->setGain(values);
+}
+
+void Interface::getFlatField(std::vector<double>& gain) const
+{
+  const std::vector<float>& values = m_correction->getGain();
+  gain.assign(values.begin(),values.end());
+}
+
+void Interface::setBadPixels(const std::vector<int>& pixels)
+{
+  DEB_MEMBER_FUNCT();
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't change bad pixels while running";
+  m_correction->setBadPixels(pixels);
+}
+
+void Interface::getBadPixels(std::vector<int>& pixels) const
+{
+  m_correction->getBadPixels(pixels);
+}
+
+/** @brief acquire nb_frames readout frames with the shutter closed,
+ *  their mean becomes the dark frame. The current acquisition
+ *  settings are used, frames are not given to Lima.
+ */
+void Interface::captureDark(int nb_frames)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_frames);
+  if(nb_frames < 1)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+  if(m_status == Running)
+    THROW_HW_ERROR(Error) << "Can't capture dark frames while running";
+
+  piint shutter_timing =
+    m_parameters->getIntegerValue(PicamParameter_ShutterTimingMode);
+  m_shutter->setState(false);
+  m_dark_capture = nb_frames;
+  try
+    {
+      prepareAcq();
+      m_correction->startDark(m_frame_size / 2);
+
+      Timing timing;
+      m_timing->predict(timing);
+      double timeout = DARK_CAPTURE_MARGIN;
+      if(timing.frame_rate > 0.)
+	timeout += nb_frames / timing.frame_rate;
+
+      startAcq();
+      bool timed_out = false;
+      {
+	AutoMutex lock(m_cond.mutex());
+	long long deadline = LatencyHistogram::now() + (long long)(timeout * 1e9);
+	while(m_status == Running && !timed_out)
+	  {
+	    double remaining = (deadline - LatencyHistogram::now()) * 1e-9;
+	    timed_out = (remaining <= 0. ||
+			 (!m_cond.wait(remaining) && m_status == Running));
+	  }
+      }
+      if(timed_out)
+	{
+	  stopAcq();
+	  THROW_HW_ERROR(Error) << "Dark capture timeout " << DEB_VAR1(timeout);
+	}
+      if(m_status == Fault)
+	THROW_HW_ERROR(Error) << "Dark capture failed";
+      m_correction->endDark();
+    }
+  catch(...)
+    {
+      m_dark_capture = 0;
+      m_parameters->setIntegerValue(PicamParameter_ShutterTimingMode,
+				    shutter_timing);
+      throw;
+    }
+  m_dark_capture = 0;
+  m_parameters->setIntegerValue(PicamParameter_ShutterTimingMode,
+				shutter_timing);
+}
+
+/** @brief select what replaces the plain copy of the readout frames
+ */
+void Interface::_setupFrameProcessing()
+{
+  DEB_MEMBER_FUNCT();
+  FrameDim frame_dim;
+  m_buffer_ctrl_obj->getFrameDim(frame_dim);
+  m_lima_frame_size = frame_dim.getMemSize();
+  m_frame_processor = NULL;
+  m_frame_in_sum = 0;
+
+  std::vector<int> ranges;
+  m_roi->getSpectrumRanges(ranges);
+  if(m_correction_enabled && m_correction->hasReference())
+    {
+      if(m_accumulation > 1 || !ranges.empty())
+	THROW_HW_ERROR(Error) << "Correction can't be used with accumulation "
+			      << "or host spectra";
+      Roi hw_roi;
+      m_roi->getRoi(hw_roi);
+      m_correction->prepare(hw_roi.getSize().getWidth(),m_frame_size / 2);
+      m_frame_processor = m_correction;
+      return;
+    }
+
+  if(m_accumulation > 1)
+    {
+      if(m_lima_frame_size != 2 * long(m_frame_size))
+	THROW_HW_ERROR(Error) << "Readout frame doesn't match accumulation: "
+			      << DEB_VAR2(m_frame_size,m_lima_frame_size);
+      m_accumulator->setup(m_frame_size / 2,m_accumulation_saturation);
+      m_frame_processor = m_accumulator->getStage(0);
+      return;
+    }
+
+  if(!ranges.empty())
+    {
+      int first_row,nb_rows;
+      m_roi->getSpectrumRows(first_row,nb_rows);
+      int width = m_roi_solver->getSensorWidth();
+      if(m_frame_size != width * nb_rows * 2)
+	THROW_HW_ERROR(Error) << "Readout frame doesn't match spectrum rows: "
+			      << DEB_VAR3(m_frame_size,width,nb_rows);
+      for(size_t i = 0;i < ranges.size();i += 2)
+	ranges[i] -= first_row;
+      m_spectrum->setup(width,ranges);
+      m_frame_processor = m_spectrum;
+    }
+}
+
+void Interface::setZeroCopy(bool flag)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(flag);
+  m_buffer_ctrl_obj->setZeroCopy(flag);
+}
+
+void Interface::getZeroCopy(bool& flag) const
+{
+  flag = m_buffer_ctrl_obj->getZeroCopy();
+}
+
+void Interface::_setAcquisitionBuffer(void* memory,long memory_size)
+{
+  DEB_MEMBER_FUNCT();
+  if(memory == m_acq_buffer.memory &&
+     memory_size == m_acq_buffer.memory_size)
+    return;
+
+  PicamAcquisitionBuffer acq_buffer = {memory,memory_size};
+  CHECK_PICAM(PicamAdvanced_SetAcquisitionBuffer(m_cam,&acq_buffer));
+  m_acq_buffer = acq_buffer;
 }
 
+/** @brief stop using the copy buffer, it stays in the pool
+ *  but can be evicted.
+ */
 void Interface::_freePixelBuffer()
 {
-  if(m_pixel_stream.memory)
-#ifdef __unix
-    free(m_pixel_stream.memory);
-#else
-    _aligned_free(m_pixel_stream.memory);
-#endif
   m_pixel_stream = {NULL,0};
+  m_buffer_pool->pin(NULL);
 }
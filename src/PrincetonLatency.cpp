@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "PrincetonLatency.h"
+
+using namespace lima::Princeton;
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+void LatencyHistogram::reset()
+{
+  for(int i = 0;i < NB_BUCKETS;++i)
+    m_counts[i].store(0,std::memory_order_relaxed);
+  m_sum.store(0,std::memory_order_relaxed);
+  m_max.store(0,std::memory_order_relaxed);
+}
+
+long long LatencyHistogram::_lowerBound(int index)
+{
+  if(index < SUB_BUCKETS)
+    return index;
+  int shift = index / SUB_BUCKETS - 1;
+  return (long long)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+/** @brief middle of the bucket of the p quantile, in s
+ */
+double LatencyHistogram::_percentile(const std::vector<long long>& counts,
+				     long long total,double p) const
+{
+  long long rank = (long long)(p * total);
+  if(rank >= total) rank = total - 1;
+  long long seen = 0;
+  for(int i = 0;i < NB_BUCKETS;++i)
+    {
+      seen += counts[i];
+      if(seen > rank)
+	{
+	  long long lower = _lowerBound(i);
+	  long long upper = i + 1 < NB_BUCKETS ? _lowerBound(i + 1) : lower + 1;
+	  return (lower + upper - 1) / 2. * 1e-9;
+	}
+    }
+  return 0.;
+}
+
+void LatencyHistogram::getStats(LatencyStats& stats) const
+{
+  std::vector<long long> counts(NB_BUCKETS);
+  long long total = 0;
+  for(int i = 0;i < NB_BUCKETS;++i)
+    total += counts[i] = m_counts[i].load(std::memory_order_relaxed);
+
+  stats.count = total;
+  stats.mean = total ?
+    double(m_sum.load(std::memory_order_relaxed)) / total * 1e-9 : 0.;
+  stats.p50 = total ? _percentile(counts,total,0.50) : 0.;
+  stats.p99 = total ? _percentile(counts,total,0.99) : 0.;
+  stats.max = m_max.load(std::memory_order_relaxed) * 1e-9;
+}
+
+void LatencyHistogram::getBuckets(std::vector<double>& upper_bounds,
+				  std::vector<int>& counts) const
+{
+  upper_bounds.clear();
+  counts.clear();
+  for(int i = 0;i < NB_BUCKETS;++i)
+    {
+      long long count = m_counts[i].load(std::memory_order_relaxed);
+      if(!count)
+	continue;
+      long long upper = i + 1 < NB_BUCKETS ? _lowerBound(i + 1) : _lowerBound(i) + 1;
+      upper_bounds.push_back(upper * 1e-9);
+      counts.push_back(count > 0x7fffffff ? 0x7fffffff : int(count));
+    }
+}
@@ -0,0 +1,122 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONLATENCY_H
+#define PRINCETONLATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace lima
+{
+  namespace Princeton
+  {
+    struct LatencyStats
+    {
+      long long	count;
+      double	mean;		// s
+      double	p50;
+      double	p99;
+      double	max;
+    };
+
+    /** Log-linear (HDR like) histogram of durations in ns: exact
+     *	below 32 ns, then 32 buckets per power of two (3% precision)
+     *	up to 2^40 ns (18 min), longer ones go in the last bucket.
+     *	One writer at a time (the readout dispatcher), it only does
+     *	relaxed loads and stores. Readers walk the counters without
+     *	stopping the writer.
+     */
+    class LatencyHistogram
+    {
+    public:
+      LatencyHistogram();
+
+      /// monotonic clock in ns
+      static long long now()
+      {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>
+	  (std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      void record(long long duration)
+      {
+	if(duration < 0) duration = 0;
+	std::atomic<long long>& count = m_counts[_index(duration)];
+	count.store(count.load(std::memory_order_relaxed) + 1,
+		    std::memory_order_relaxed);
+	m_sum.store(m_sum.load(std::memory_order_relaxed) + duration,
+		    std::memory_order_relaxed);
+	if(duration > m_max.load(std::memory_order_relaxed))
+	  m_max.store(duration,std::memory_order_relaxed);
+      }
+
+      /// a duration recorded during the reset may be kept
+      void reset();
+      void getStats(LatencyStats& stats) const;
+      /// non empty buckets, bounds in s
+      void getBuckets(std::vector<double>& upper_bounds,
+		      std::vector<int>& counts) const;
+    private:
+      enum {SUB_BUCKET_BITS = 5,
+	    SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+	    MAX_BITS = 40,
+	    NB_BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS};
+
+      static int _index(long long duration)
+      {
+	if(duration < SUB_BUCKETS)
+	  return int(duration);
+	int bits = _highestBit((unsigned long long)duration);
+	if(bits >= MAX_BITS)
+	  return NB_BUCKETS - 1;
+	int shift = bits - SUB_BUCKET_BITS;
+	return (shift + 1) * SUB_BUCKETS +
+	  int((duration >> shift) & (SUB_BUCKETS - 1));
+      }
+      static int _highestBit(unsigned long long value)
+      {
+#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanReverse64(&bit,value);
+	return int(bit);
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+      }
+      static long long _lowerBound(int index);
+      double _percentile(const std::vector<long long>& counts,
+			 long long total,double p) const;
+
+      std::atomic<long long>	m_counts[NB_BUCKETS];
+      std::atomic<long long>	m_sum;
+      std::atomic<long long>	m_max;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONLATENCY_H
@@ -0,0 +1,218 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "PrincetonLibrary.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+Library& Library::get()
+{
+  static Library library;
+  return library;
+}
+
+Library::Library() :
+  m_nb_users(0),
+  m_initialized(false),
+  m_ids_valid(false)
+{
+  for(int i = 0;i < MAX_CAMERAS;++i)
+    {
+      m_registry[i].cam = NULL;
+      m_registry[i].interface = NULL;
+    }
+}
+
+/** @brief initialize PICam for the first user, a library already
+ *  initialized by someone else is used as is.
+ */
+void Library::acquire()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  if(m_nb_users++)
+    return;
+
+  try
+    {
+      piint major, minor, distribution, released;
+      CHECK_PICAM(Picam_GetVersion(&major, &minor, &distribution, &released));
+      DEB_ALWAYS() << "PICam version " << major << "." << minor << "."
+		   << distribution << " (" << released << ")";
+
+      pibln inited;
+      CHECK_PICAM(Picam_IsLibraryInitialized(&inited));
+      if(inited)
+	DEB_WARNING() << "PICam library already initialized outside the plugin";
+      else
+	{
+	  DEB_ALWAYS() << "Initialize PICam library";
+	  CHECK_PICAM(Picam_InitializeLibrary());
+	  m_initialized = true;
+	}
+    }
+  catch(...)
+    {
+      --m_nb_users;
+      throw;
+    }
+}
+
+void Library::release()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  if(!m_nb_users || --m_nb_users)
+    return;
+
+  m_cam_ids.clear();
+  m_ids_valid = false;
+  if(m_initialized)
+    {
+      DEB_ALWAYS() << "Uninitialize PICam library";
+      Picam_UninitializeLibrary();
+      m_initialized = false;
+    }
+}
+
+/** @brief open the camera with camera_serial, or the first camera not
+ *  already opened in this process if camera_serial is empty.
+ */
+void Library::openCamera(const std::string& camera_serial,PicamHandle& cam,
+			 PicamCameraID& cam_id)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(camera_serial);
+  AutoMutex lock(m_lock);
+  if(!m_nb_users)
+    THROW_HW_ERROR(Error) << "PICam library is not initialized";
+
+  const PicamCameraID* found = NULL;
+  for(int refresh = !m_ids_valid;!found && refresh < 2;++refresh)
+    {
+      if(refresh)
+	_refreshCameraIDs();
+      for(auto i = m_cam_ids.begin();i != m_cam_ids.end();++i)
+	{
+	  bool opened = false;
+	  for(auto j = m_opened.begin();j != m_opened.end();++j)
+	    if(j->second == i->serial_number)
+	      opened = true;
+	  if(camera_serial.empty() ? !opened : camera_serial == i->serial_number)
+	    {
+	      if(opened)
+		THROW_HW_ERROR(Error) << "Camera " << DEB_VAR1(camera_serial)
+				      << " is already opened";
+	      found = &*i;
+	      break;
+	    }
+	}
+    }
+
+  if(!found)
+    {
+      if(m_cam_ids.empty())
+	THROW_HW_ERROR(Error) << "No cameras found in the system";
+
+      DEB_ALWAYS() << "Cameras found:";
+      for(auto i = m_cam_ids.begin();i != m_cam_ids.end();++i)
+	{
+	  std::string model = get_human_cam_model(i->model);
+	  DEB_ALWAYS() << DEB_VAR1(model);
+
+	  std::string computer_interface = get_human_computer_interface(i->computer_interface);
+	  DEB_ALWAYS() << DEB_VAR1(computer_interface);
+
+	  const char* sensor_name = i->sensor_name;
+	  const char* serial_number = i->serial_number;
+	  DEB_ALWAYS() << DEB_VAR2(sensor_name,serial_number);
+	  DEB_ALWAYS() << "##############################";
+	}
+      THROW_HW_ERROR(Error) << "Camera with "
+			    << DEB_VAR1(camera_serial) << " is not found!";
+    }
+
+  CHECK_PICAM(PicamAdvanced_OpenCameraDevice(found,&cam));
+  cam_id = *found;
+  m_opened[cam] = found->serial_number;
+}
+
+void Library::closeCamera(PicamHandle cam)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  if(m_opened.erase(cam))
+    PicamAdvanced_CloseCameraDevice(cam);
+}
+
+void Library::getCameraIDs(std::vector<PicamCameraID>& cam_ids,bool refresh)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  if(!m_nb_users)
+    THROW_HW_ERROR(Error) << "PICam library is not initialized";
+  if(refresh || !m_ids_valid)
+    _refreshCameraIDs();
+  cam_ids = m_cam_ids;
+}
+
+void Library::_refreshCameraIDs()
+{
+  DEB_MEMBER_FUNCT();
+  const PicamCameraID* cam_ids;
+  piint nb_cam_ids;
+  CHECK_PICAM(Picam_GetAvailableCameraIDs(&cam_ids,&nb_cam_ids));
+  m_cam_ids.assign(cam_ids,cam_ids + nb_cam_ids);
+  Picam_DestroyCameraIDs(cam_ids);
+  m_ids_valid = true;
+  DEB_TRACE() << DEB_VAR1(nb_cam_ids);
+}
+
+/** @brief the Interface is stored before the handle, so a lookup which
+ *  finds the handle always gets the Interface.
+ */
+void Library::registerInterface(PicamHandle cam,Interface* interface)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  for(int i = 0;i < MAX_CAMERAS;++i)
+    {
+      Slot& slot = m_registry[i];
+      if(slot.cam.load(std::memory_order_relaxed))
+	continue;
+      slot.interface.store(interface,std::memory_order_relaxed);
+      slot.cam.store(cam,std::memory_order_release);
+      return;
+    }
+  THROW_HW_ERROR(Error) << "Too many cameras, maximum is " << int(MAX_CAMERAS);
+}
+
+void Library::unregisterInterface(PicamHandle cam)
+{
+  AutoMutex lock(m_lock);
+  for(int i = 0;i < MAX_CAMERAS;++i)
+    if(m_registry[i].cam.load(std::memory_order_relaxed) == cam)
+      m_registry[i].cam.store(NULL,std::memory_order_release);
+}
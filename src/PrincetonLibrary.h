@@ -0,0 +1,103 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONLIBRARY_H
+#define PRINCETONLIBRARY_H
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <picam.h>
+#include <picam_advanced.h>
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    class Interface;
+
+    /** Process-wide PICam library, shared by all the cameras.
+     *	The library is initialized by the first acquire and uninitialized
+     *	by the last release (only if it was initialized here). Camera IDs
+     *	are discovered once and cached, the cache is refreshed when a
+     *	requested camera isn't in it.
+     *	The handle to Interface registry is a fixed table of atomic slots,
+     *	so the acquisition callbacks of several cameras look up their
+     *	Interface without taking a lock.
+     */
+    class Library
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"Library","Princeton");
+    public:
+      static Library& get();
+
+      void acquire();
+      void release();
+
+      void openCamera(const std::string& camera_serial,PicamHandle& cam,
+		      PicamCameraID& cam_id);
+      void closeCamera(PicamHandle cam);
+      void getCameraIDs(std::vector<PicamCameraID>& cam_ids,
+			bool refresh = false);
+
+      void registerInterface(PicamHandle cam,Interface* interface);
+      void unregisterInterface(PicamHandle cam);
+      /// lock-free, called from PICam acquisition threads
+      Interface* getInterface(PicamHandle cam) const
+      {
+	for(int i = 0;i < MAX_CAMERAS;++i)
+	  if(m_registry[i].cam.load(std::memory_order_acquire) == cam)
+	    return m_registry[i].interface.load(std::memory_order_acquire);
+	return NULL;
+      }
+    private:
+      enum {MAX_CAMERAS = 16};
+      struct Slot
+      {
+	std::atomic<PicamHandle>	cam;
+	std::atomic<Interface*>		interface;
+      };
+
+      Library();
+      Library(const Library&);
+      Library& operator=(const Library&);
+
+      void _refreshCameraIDs();
+
+      Mutex			m_lock;
+      int			m_nb_users;
+      bool			m_initialized; // by this library manager
+      bool			m_ids_valid;
+      std::vector<PicamCameraID> m_cam_ids;
+      std::map<PicamHandle,std::string> m_opened; // serial numbers
+      Slot			m_registry[MAX_CAMERAS];
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONLIBRARY_H
@@ -0,0 +1,248 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#ifdef __unix
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#else
+#include <windows.h>
+#include <malloc.h>
+#endif
+
+#include "lima/Exceptions.h"
+#include "PrincetonMemory.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+static const size_t DEFAULT_ALIGNMENT = 4096;
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define MPOL_PREFERRED 1
+
+AcqMemory::AcqMemory() :
+  m_memory(NULL),
+  m_size(0),
+  m_mapped_size(0),
+  m_page_size(DEFAULT_ALIGNMENT),
+  m_mapped(false),
+  m_locked(false)
+{
+}
+
+AcqMemory::~AcqMemory()
+{
+  release();
+}
+
+void AcqMemory::allocate(size_t size,const AcqMemoryOptions& options)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR5(size,options.huge_page_size,options.lock,
+			  options.prefault,options.numa_node);
+  release();
+
+  if(options.huge_page_size)
+    {
+      if(!_mapHugePages(size,options.huge_page_size) &&
+	 options.huge_page_size > (2 << 20))
+	{
+	  DEB_WARNING() << "1GB huge pages not available, try 2MB";
+	  _mapHugePages(size,2 << 20);
+	}
+      if(!m_memory)
+	DEB_WARNING() << "Huge pages not available, use standard pages";
+    }
+
+  if(!m_memory)
+    {
+      m_page_size = DEFAULT_ALIGNMENT;
+#ifdef __unix
+      if(posix_memalign(&m_memory,DEFAULT_ALIGNMENT,size))
+	m_memory = NULL;
+#else
+      m_memory = _aligned_malloc(size,DEFAULT_ALIGNMENT);
+#endif
+      if(!m_memory)
+	THROW_HW_ERROR(Error) << "Can't allocate acquisition buffer "
+			      << DEB_VAR1(size);
+    }
+  m_size = size;
+
+  // Memory policy must be set before the first touch
+  if(options.numa_node >= 0)
+    _bindNumaNode(options.numa_node);
+
+  if(options.lock)
+    {
+#ifdef __unix
+      m_locked = !mlock(m_memory,m_size);
+#else
+      m_locked = VirtualLock(m_memory,m_size) != 0;
+#endif
+      if(!m_locked)
+	DEB_WARNING() << "Can't lock acquisition buffer in memory "
+		      << "(check memlock limit)";
+    }
+
+  if(options.prefault)
+    _prefault();
+}
+
+void AcqMemory::release()
+{
+  if(!m_memory) return;
+
+#ifdef __unix
+  if(m_locked)
+    munlock(m_memory,m_size);
+  if(m_mapped)
+    munmap(m_memory,m_mapped_size);
+  else
+    free(m_memory);
+#else
+  if(m_locked)
+    VirtualUnlock(m_memory,m_size);
+  _aligned_free(m_memory);
+#endif
+  m_memory = NULL;
+  m_size = m_mapped_size = 0;
+  m_mapped = m_locked = false;
+}
+
+bool AcqMemory::_mapHugePages(size_t size,size_t huge_page_size)
+{
+  DEB_MEMBER_FUNCT();
+#if defined(__linux__) && defined(MAP_HUGETLB)
+  int log2_page_size = 0;
+  while((size_t(1) << log2_page_size) < huge_page_size) ++log2_page_size;
+
+  size_t mapped_size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+  void* memory = mmap(NULL,mapped_size,PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+		      (log2_page_size << MAP_HUGE_SHIFT),-1,0);
+  if(memory == MAP_FAILED)
+    {
+      DEB_TRACE() << "mmap failed for " << DEB_VAR1(huge_page_size);
+      return false;
+    }
+  m_memory = memory;
+  m_mapped_size = mapped_size;
+  m_page_size = huge_page_size;
+  m_mapped = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void AcqMemory::_bindNumaNode(int numa_node)
+{
+  DEB_MEMBER_FUNCT();
+#if defined(__linux__) && defined(SYS_mbind)
+  unsigned long node_mask[16] = {0};
+  const unsigned long max_node = sizeof(node_mask) * 8;
+  if(size_t(numa_node) >= max_node)
+    {
+      DEB_WARNING() << "Invalid " << DEB_VAR1(numa_node);
+      return;
+    }
+  node_mask[numa_node / (sizeof(long) * 8)] |= 1UL << (numa_node % (sizeof(long) * 8));
+
+  // mbind works on whole pages
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  unsigned long start = (unsigned long)m_memory & ~(page_size - 1);
+  unsigned long length = (unsigned long)m_memory + m_size - start;
+  if(syscall(SYS_mbind,start,length,MPOL_PREFERRED,node_mask,max_node,0))
+    DEB_WARNING() << "Can't bind acquisition buffer on " << DEB_VAR1(numa_node);
+#else
+  DEB_WARNING() << "NUMA binding not supported on this system";
+#endif
+}
+
+void AcqMemory::_prefault()
+{
+  size_t page_size = DEFAULT_ALIGNMENT;
+#ifdef __unix
+  page_size = sysconf(_SC_PAGESIZE);
+#endif
+  volatile char* p = (volatile char*)m_memory;
+  for(size_t offset = 0;offset < m_size;offset += page_size)
+    p[offset] = 0;
+}
+
+int AcqMemory::getNumaNodeOfCpu(int cpu)
+{
+  DEB_STATIC_FUNCT();
+  int numa_node = -1;
+#ifdef __linux__
+  std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR* dir = opendir(path.c_str());
+  if(dir)
+    {
+      struct dirent* entry;
+      while(numa_node < 0 && (entry = readdir(dir)))
+	if(!strncmp(entry->d_name,"node",4))
+	  numa_node = atoi(entry->d_name + 4);
+      closedir(dir);
+    }
+#endif
+  if(numa_node < 0)
+    DEB_WARNING() << "Can't find NUMA node of " << DEB_VAR1(cpu);
+  return numa_node;
+}
+
+/** @brief NUMA node of a device (PCIe board or USB controller).
+ *  sysfs_path is the device directory, i.e /sys/bus/pci/devices/0000:3b:00.0
+ *  For devices without numa_node (USB), parent directories are tried.
+ */
+int AcqMemory::getNumaNodeOfDevice(const std::string& sysfs_path)
+{
+  DEB_STATIC_FUNCT();
+  int numa_node = -1;
+#ifdef __linux__
+  char* real_path = realpath(sysfs_path.c_str(),NULL);
+  std::string path = real_path ? real_path : sysfs_path;
+  free(real_path);
+  while(numa_node < 0 && path.size() > 1)
+    {
+      std::ifstream numa_file((path + "/numa_node").c_str());
+      if(numa_file && numa_file >> numa_node && numa_node >= 0)
+	break;
+      numa_node = -1;
+      path = path.substr(0,path.rfind('/'));
+    }
+#endif
+  if(numa_node < 0)
+    DEB_WARNING() << "Can't find NUMA node of " << DEB_VAR1(sysfs_path);
+  return numa_node;
+}
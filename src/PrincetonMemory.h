@@ -0,0 +1,90 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONMEMORY_H
+#define PRINCETONMEMORY_H
+
+#include <cstddef>
+#include <string>
+
+#include "lima/Debug.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    struct AcqMemoryOptions
+    {
+      AcqMemoryOptions() :
+	huge_page_size(0),
+	lock(false),
+	prefault(false),
+	numa_node(-1)
+      {}
+
+      size_t	huge_page_size;	///< 0, 2MB or 1GB
+      bool	lock;		///< mlock the pages
+      bool	prefault;	///< touch every page after allocation
+      int	numa_node;	///< -1 no binding
+    };
+
+    /** Memory block used as PICam acquisition buffer.
+     *	Every option falls back (with a warning) to the standard
+     *	allocation when it's not available on the system.
+     */
+    class AcqMemory
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"AcqMemory","Princeton");
+    public:
+      AcqMemory();
+      ~AcqMemory();
+
+      void allocate(size_t size,const AcqMemoryOptions& options);
+      void release();
+
+      void* getMemory() const {return m_memory;}
+      size_t getSize() const {return m_size;}
+      size_t getPageSize() const {return m_page_size;}
+      bool isLocked() const {return m_locked;}
+
+      static int getNumaNodeOfCpu(int cpu);
+      static int getNumaNodeOfDevice(const std::string& sysfs_path);
+    private:
+      AcqMemory(const AcqMemory&);
+      AcqMemory& operator=(const AcqMemory&);
+
+      bool _mapHugePages(size_t size,size_t huge_page_size);
+      void _bindNumaNode(int numa_node);
+      void _prefault();
+
+      void*	m_memory;
+      size_t	m_size;
+      size_t	m_mapped_size;
+      size_t	m_page_size;
+      bool	m_mapped;
+      bool	m_locked;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONMEMORY_H
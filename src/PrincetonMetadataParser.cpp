@@ -0,0 +1,151 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstring>
+#include <stdint.h>
+
+#include "PrincetonMetadataParser.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+MetadataParser::MetadataParser() :
+  m_frame_size(0),
+  m_metadata_size(0),
+  m_timestamp_resolution(1.)
+{
+}
+
+void MetadataParser::prepare(PicamHandle cam,int frame_size,int frame_stride)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(frame_size,frame_stride);
+
+  m_frame_size = frame_size;
+  m_metadata_size = 0;
+  m_exposure_started = m_exposure_ended = Field();
+  m_frame_tracking = m_gate_delay = m_gate_width = Field();
+
+  pibln exists;
+  piint value,bit_depth;
+  CHECK_PICAM(Picam_DoesParameterExist(cam,PicamParameter_TimeStamps,&exists));
+  if(exists)
+    {
+      CHECK_PICAM(Picam_GetParameterIntegerValue(cam,PicamParameter_TimeStamps,
+						 &value));
+      if(value != PicamTimeStampsMask_None)
+	{
+	  pi64s resolution;
+	  CHECK_PICAM(Picam_GetParameterLargeIntegerValue(cam,
+							  PicamParameter_TimeStampResolution,
+							  &resolution));
+	  m_timestamp_resolution = double(resolution);
+	  CHECK_PICAM(Picam_GetParameterIntegerValue(cam,
+						     PicamParameter_TimeStampBitDepth,
+						     &bit_depth));
+	  if(value & PicamTimeStampsMask_ExposureStarted)
+	    _addField(m_exposure_started,bit_depth);
+	  if(value & PicamTimeStampsMask_ExposureEnded)
+	    _addField(m_exposure_ended,bit_depth);
+	}
+    }
+
+  CHECK_PICAM(Picam_DoesParameterExist(cam,PicamParameter_TrackFrames,&exists));
+  if(exists)
+    {
+      CHECK_PICAM(Picam_GetParameterIntegerValue(cam,PicamParameter_TrackFrames,
+						 &value));
+      if(value)
+	{
+	  CHECK_PICAM(Picam_GetParameterIntegerValue(cam,
+						     PicamParameter_FrameTrackingBitDepth,
+						     &bit_depth));
+	  _addField(m_frame_tracking,bit_depth);
+	}
+    }
+
+  CHECK_PICAM(Picam_DoesParameterExist(cam,PicamParameter_GateTracking,&exists));
+  if(exists)
+    {
+      CHECK_PICAM(Picam_GetParameterIntegerValue(cam,PicamParameter_GateTracking,
+						 &value));
+      if(value != PicamGateTrackingMask_None)
+	{
+	  CHECK_PICAM(Picam_GetParameterIntegerValue(cam,
+						     PicamParameter_GateTrackingBitDepth,
+						     &bit_depth));
+	  if(value & PicamGateTrackingMask_Delay)
+	    _addField(m_gate_delay,bit_depth);
+	  if(value & PicamGateTrackingMask_Width)
+	    _addField(m_gate_width,bit_depth);
+	}
+    }
+
+  if(m_frame_size + m_metadata_size > frame_stride)
+    {
+      DEB_WARNING() << "Frame metadata doesn't fit in the frame stride, ignored "
+		    << DEB_VAR3(m_frame_size,m_metadata_size,frame_stride);
+      m_metadata_size = 0;
+      m_exposure_started = m_exposure_ended = Field();
+      m_frame_tracking = m_gate_delay = m_gate_width = Field();
+    }
+  DEB_TRACE() << DEB_VAR2(m_metadata_size,m_timestamp_resolution);
+}
+
+void MetadataParser::_addField(Field& field,int bit_depth)
+{
+  field.offset = m_metadata_size;
+  field.size = bit_depth / 8;
+  m_metadata_size += field.size;
+}
+
+/** @brief read a little endian unsigned counter
+ */
+long long MetadataParser::_read(const pibyte* metadata,const Field& field)
+{
+  const pibyte* data = metadata + field.offset;
+  switch(field.size)
+    {
+    case 1: return *data;
+    case 2: {uint16_t value; memcpy(&value,data,sizeof(value)); return value;}
+    case 4: {uint32_t value; memcpy(&value,data,sizeof(value)); return value;}
+    case 8: {uint64_t value; memcpy(&value,data,sizeof(value)); return (long long)value;}
+    default: return -1;
+    }
+}
+
+void MetadataParser::parse(const void* frame,FrameMetadata& metadata) const
+{
+  const pibyte* data = (const pibyte*)frame + m_frame_size;
+  if(m_exposure_started.size)
+    metadata.exposure_started = _read(data,m_exposure_started) / m_timestamp_resolution;
+  if(m_exposure_ended.size)
+    metadata.exposure_ended = _read(data,m_exposure_ended) / m_timestamp_resolution;
+  if(m_frame_tracking.size)
+    metadata.frame_tracking = _read(data,m_frame_tracking);
+  if(m_gate_delay.size)
+    metadata.gate_delay = _read(data,m_gate_delay);
+  if(m_gate_width.size)
+    metadata.gate_width = _read(data,m_gate_width);
+}
@@ -0,0 +1,75 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONMETADATAPARSER_H
+#define PRINCETONMETADATAPARSER_H
+
+#include <picam.h>
+
+#include "lima/Debug.h"
+#include "PrincetonFrameMetadata.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Decode the metadata block written by PICam after the pixels
+     *	of each frame. The layout (enabled fields and their bit depth)
+     *	is read from the committed parameters in prepare.
+     *	PICam order is: exposure started, exposure ended, frame tracking,
+     *	gate tracking delay and width.
+     */
+    class MetadataParser
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"MetadataParser","Princeton");
+    public:
+      MetadataParser();
+
+      void prepare(PicamHandle cam,int frame_size,int frame_stride);
+      bool hasMetadata() const {return m_metadata_size > 0;}
+      bool hasFrameTracking() const {return m_frame_tracking.size > 0;}
+
+      void parse(const void* frame,FrameMetadata&) const;
+    private:
+      struct Field
+      {
+	Field() : offset(0),size(0) {}
+	int offset;
+	int size;		// in bytes, 0 if not present
+      };
+      static long long _read(const pibyte* metadata,const Field&);
+      void _addField(Field&,int bit_depth);
+
+      int	m_frame_size;
+      int	m_metadata_size;
+      double	m_timestamp_resolution;
+      Field	m_exposure_started;
+      Field	m_exposure_ended;
+      Field	m_frame_tracking;
+      Field	m_gate_delay;
+      Field	m_gate_width;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONMETADATAPARSER_H
@@ -0,0 +1,328 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "PrincetonParameterCache.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+// PICam value changed callbacks only give the camera handle
+static Mutex cache_registry_lock;
+static std::map<PicamHandle,ParameterCache*> cache_registry;
+
+template<> struct ParameterCache::Traits<piint>
+{
+  static PicamError get(PicamHandle cam,PicamParameter parameter,piint* value)
+  {return Picam_GetParameterIntegerValue(cam,parameter,value);}
+  static PicamError set(PicamHandle cam,PicamParameter parameter,piint value)
+  {return Picam_SetParameterIntegerValue(cam,parameter,value);}
+  static PicamError listen(PicamHandle cam,PicamParameter parameter)
+  {return PicamAdvanced_RegisterForIntegerValueChanged(cam,parameter,
+						       ParameterCache::_integerChanged);}
+  static PicamValueType type() {return PicamValueType_Integer;}
+  static piint& pending(Pending& pending) {return pending.integer;}
+};
+
+template<> struct ParameterCache::Traits<pi64s>
+{
+  static PicamError get(PicamHandle cam,PicamParameter parameter,pi64s* value)
+  {return Picam_GetParameterLargeIntegerValue(cam,parameter,value);}
+  static PicamError set(PicamHandle cam,PicamParameter parameter,pi64s value)
+  {return Picam_SetParameterLargeIntegerValue(cam,parameter,value);}
+  static PicamError listen(PicamHandle cam,PicamParameter parameter)
+  {return PicamAdvanced_RegisterForLargeIntegerValueChanged(cam,parameter,
+							    ParameterCache::_largeIntegerChanged);}
+  static PicamValueType type() {return PicamValueType_LargeInteger;}
+  static pi64s& pending(Pending& pending) {return pending.large_integer;}
+};
+
+template<> struct ParameterCache::Traits<piflt>
+{
+  static PicamError get(PicamHandle cam,PicamParameter parameter,piflt* value)
+  {return Picam_GetParameterFloatingPointValue(cam,parameter,value);}
+  static PicamError set(PicamHandle cam,PicamParameter parameter,piflt value)
+  {return Picam_SetParameterFloatingPointValue(cam,parameter,value);}
+  static PicamError listen(PicamHandle cam,PicamParameter parameter)
+  {return PicamAdvanced_RegisterForFloatingPointValueChanged(cam,parameter,
+							     ParameterCache::_floatingPointChanged);}
+  static PicamValueType type() {return PicamValueType_FloatingPoint;}
+  static piflt& pending(Pending& pending) {return pending.floating_point;}
+};
+
+ParameterCache::ParameterCache(PicamHandle cam) :
+  m_cam(cam),
+  m_in_transaction(false),
+  m_nb_hits(0),
+  m_nb_misses(0)
+{
+  DEB_CONSTRUCTOR();
+  AutoMutex lock(cache_registry_lock);
+  cache_registry[m_cam] = this;
+}
+
+ParameterCache::~ParameterCache()
+{
+  DEB_DESTRUCTOR();
+  {
+    AutoMutex lock(cache_registry_lock);
+    cache_registry.erase(m_cam);
+  }
+  for(auto i = m_registered.begin();i != m_registered.end();++i)
+    {
+      switch(i->second)
+	{
+	case PicamValueType_Integer:
+	  PicamAdvanced_UnregisterForIntegerValueChanged(m_cam,i->first,
+							 _integerChanged);
+	  break;
+	case PicamValueType_LargeInteger:
+	  PicamAdvanced_UnregisterForLargeIntegerValueChanged(m_cam,i->first,
+							      _largeIntegerChanged);
+	  break;
+	default:
+	  PicamAdvanced_UnregisterForFloatingPointValueChanged(m_cam,i->first,
+							       _floatingPointChanged);
+	  break;
+	}
+    }
+}
+
+piint ParameterCache::getIntegerValue(PicamParameter parameter)
+{
+  return _get(m_integers,parameter);
+}
+
+void ParameterCache::setIntegerValue(PicamParameter parameter,piint value)
+{
+  _set(m_integers,parameter,value);
+}
+
+pi64s ParameterCache::getLargeIntegerValue(PicamParameter parameter)
+{
+  return _get(m_large_integers,parameter);
+}
+
+void ParameterCache::setLargeIntegerValue(PicamParameter parameter,pi64s value)
+{
+  _set(m_large_integers,parameter,value);
+}
+
+piflt ParameterCache::getFloatingPointValue(PicamParameter parameter)
+{
+  return _get(m_floating_points,parameter);
+}
+
+void ParameterCache::setFloatingPointValue(PicamParameter parameter,piflt value)
+{
+  _set(m_floating_points,parameter,value);
+}
+
+void ParameterCache::invalidate(PicamParameter parameter)
+{
+  AutoMutex lock(m_lock);
+  m_integers.erase(parameter);
+  m_large_integers.erase(parameter);
+  m_floating_points.erase(parameter);
+}
+
+void ParameterCache::invalidateAll()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  m_integers.clear();
+  m_large_integers.clear();
+  m_floating_points.clear();
+}
+
+void ParameterCache::beginTransaction()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_lock);
+  if(m_in_transaction)
+    THROW_HW_ERROR(Error) << "A parameter transaction is already open";
+  m_in_transaction = true;
+}
+
+/** @brief write the recorded sets to PICam.
+ *  A set can be refused because of the value of another staged
+ *  parameter, refused sets are retried as long as some succeed.
+ */
+void ParameterCache::endTransaction(std::vector<std::string>& errors)
+{
+  DEB_MEMBER_FUNCT();
+  std::vector<Pending> pending;
+  {
+    AutoMutex lock(m_lock);
+    pending.swap(m_pending);
+    m_in_transaction = false;
+  }
+  size_t nb_staged = pending.size();
+  std::vector<std::pair<Pending,PicamError> > failed;
+  while(!pending.empty())
+    {
+      failed.clear();
+      for(auto i = pending.begin();i != pending.end();++i)
+	{
+	  PicamError error;
+	  switch(i->type)
+	    {
+	    case PicamValueType_Integer:
+	      error = Traits<piint>::set(m_cam,i->parameter,i->integer);
+	      break;
+	    case PicamValueType_LargeInteger:
+	      error = Traits<pi64s>::set(m_cam,i->parameter,i->large_integer);
+	      break;
+	    default:
+	      error = Traits<piflt>::set(m_cam,i->parameter,i->floating_point);
+	      break;
+	    }
+	  invalidate(i->parameter);
+	  if(error != PicamError_None)
+	    failed.push_back(std::make_pair(*i,error));
+	}
+      if(failed.size() == pending.size())
+	break;
+      pending.clear();
+      for(auto i = failed.begin();i != failed.end();++i)
+	pending.push_back(i->first);
+    }
+  for(auto i = failed.begin();i != failed.end();++i)
+    errors.push_back(get_parameter_name(i->first.parameter) + ": " +
+		     get_error_message(i->second));
+  DEB_TRACE() << DEB_VAR2(nb_staged,errors.size());
+}
+
+ParameterCache::Pending* ParameterCache::_findPending(PicamParameter parameter)
+{
+  for(auto i = m_pending.begin();i != m_pending.end();++i)
+    if(i->parameter == parameter)
+      return &*i;
+  return NULL;
+}
+
+template<class T>
+T ParameterCache::_get(std::map<PicamParameter,T>& values,
+		       PicamParameter parameter)
+{
+  DEB_MEMBER_FUNCT();
+  bool registered;
+  {
+    AutoMutex lock(m_lock);
+    Pending* pending = m_in_transaction ? _findPending(parameter) : NULL;
+    if(pending)
+      {
+	++m_nb_hits;
+	return Traits<T>::pending(*pending);
+      }
+    auto i = values.find(parameter);
+    if(i != values.end())
+      {
+	++m_nb_hits;
+	return i->second;
+      }
+    registered = m_registered.find(parameter) != m_registered.end();
+  }
+  ++m_nb_misses;
+
+  if(!registered)
+    {
+      CHECK_PICAM(Traits<T>::listen(m_cam,parameter));
+      AutoMutex lock(m_lock);
+      m_registered[parameter] = Traits<T>::type();
+    }
+  T value;
+  CHECK_PICAM(Traits<T>::get(m_cam,parameter,&value));
+
+  // keep a value changed meanwhile by a callback
+  AutoMutex lock(m_lock);
+  return values.insert(std::make_pair(parameter,value)).first->second;
+}
+
+template<class T>
+void ParameterCache::_set(std::map<PicamParameter,T>& values,
+			  PicamParameter parameter,T value)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(parameter,value);
+  {
+    AutoMutex lock(m_lock);
+    if(m_in_transaction)
+      {
+	Pending* pending = _findPending(parameter);
+	if(!pending)
+	  {
+	    m_pending.push_back(Pending());
+	    pending = &m_pending.back();
+	    pending->parameter = parameter;
+	    pending->type = Traits<T>::type();
+	  }
+	Traits<T>::pending(*pending) = value;
+	return;
+      }
+  }
+  CHECK_PICAM(Traits<T>::set(m_cam,parameter,value));
+  AutoMutex lock(m_lock);
+  values.erase(parameter);
+}
+
+template<class T>
+void ParameterCache::_changed(std::map<PicamParameter,T>& values,
+			      PicamParameter parameter,T value)
+{
+  AutoMutex lock(m_lock);
+  values[parameter] = value;
+}
+
+PicamError ParameterCache::_integerChanged(PicamHandle cam,
+					   PicamParameter parameter,
+					   piint value)
+{
+  AutoMutex lock(cache_registry_lock);
+  auto i = cache_registry.find(cam);
+  if(i != cache_registry.end())
+    i->second->_changed(i->second->m_integers,parameter,value);
+  return PicamError_None;
+}
+
+PicamError ParameterCache::_largeIntegerChanged(PicamHandle cam,
+						PicamParameter parameter,
+						pi64s value)
+{
+  AutoMutex lock(cache_registry_lock);
+  auto i = cache_registry.find(cam);
+  if(i != cache_registry.end())
+    i->second->_changed(i->second->m_large_integers,parameter,value);
+  return PicamError_None;
+}
+
+PicamError ParameterCache::_floatingPointChanged(PicamHandle cam,
+						 PicamParameter parameter,
+						 piflt value)
+{
+  AutoMutex lock(cache_registry_lock);
+  auto i = cache_registry.find(cam);
+  if(i != cache_registry.end())
+    i->second->_changed(i->second->m_floating_points,parameter,value);
+  return PicamError_None;
+}
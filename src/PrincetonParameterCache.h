@@ -0,0 +1,109 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONPARAMETERCACHE_H
+#define PRINCETONPARAMETERCACHE_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <atomic>
+
+#include <picam.h>
+#include <picam_advanced.h>
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Typed cache of PICam parameter values.
+     *	A value is read from the camera handle on the first access, then
+     *	kept up to date by the PICam value changed callbacks. Setters write
+     *	through to PICam and invalidate the cached value, PICam may round it.
+     *	PICam is never called with the cache lock held, its callbacks can
+     *	come from any thread.
+     *	In a transaction, sets are only recorded (getters see them) and
+     *	written to PICam in their order by endTransaction, which collects
+     *	the errors per parameter instead of stopping at the first one.
+     */
+    class ParameterCache
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"ParameterCache","Princeton");
+    public:
+      ParameterCache(PicamHandle cam);
+      ~ParameterCache();
+
+      piint getIntegerValue(PicamParameter);
+      void setIntegerValue(PicamParameter,piint);
+      pi64s getLargeIntegerValue(PicamParameter);
+      void setLargeIntegerValue(PicamParameter,pi64s);
+      piflt getFloatingPointValue(PicamParameter);
+      void setFloatingPointValue(PicamParameter,piflt);
+
+      void invalidate(PicamParameter);
+      void invalidateAll();
+
+      void beginTransaction();
+      bool inTransaction() const {return m_in_transaction;}
+      void endTransaction(std::vector<std::string>& errors);
+
+      long long getNbHits() const {return m_nb_hits;}
+      long long getNbMisses() const {return m_nb_misses;}
+      void resetCounters() {m_nb_hits = m_nb_misses = 0;}
+    private:
+      template<class T> struct Traits;
+      struct Pending
+      {
+	PicamParameter	parameter;
+	PicamValueType	type;
+	piint		integer;
+	pi64s		large_integer;
+	piflt		floating_point;
+      };
+      Pending* _findPending(PicamParameter);
+      template<class T> T _get(std::map<PicamParameter,T>&,PicamParameter);
+      template<class T> void _set(std::map<PicamParameter,T>&,PicamParameter,T);
+      template<class T> void _changed(std::map<PicamParameter,T>&,PicamParameter,T);
+
+      static PicamError _integerChanged(PicamHandle,PicamParameter,piint);
+      static PicamError _largeIntegerChanged(PicamHandle,PicamParameter,pi64s);
+      static PicamError _floatingPointChanged(PicamHandle,PicamParameter,piflt);
+
+      PicamHandle			m_cam;
+      Mutex				m_lock;
+      std::map<PicamParameter,piint>	m_integers;
+      std::map<PicamParameter,pi64s>	m_large_integers;
+      std::map<PicamParameter,piflt>	m_floating_points;
+      std::map<PicamParameter,PicamValueType> m_registered;
+      std::atomic<bool>			m_in_transaction;
+      std::vector<Pending>		m_pending;
+      std::atomic<long long>		m_nb_hits;
+      std::atomic<long long>		m_nb_misses;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONPARAMETERCACHE_H
@@ -0,0 +1,378 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include <cmath>
+
+#include "PrincetonPixelKernels.h"
+#include "PrincetonFrameCopy.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PRINCETON_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+using namespace lima;
+using namespace lima::Princeton;
+
+static void _widen_store(uint32_t* dst,const uint16_t* src,size_t nb_pixels)
+{
+  for(size_t i = 0;i < nb_pixels;++i)
+    dst[i] = src[i];
+}
+
+static void _widen_add(uint32_t* dst,const uint16_t* src,size_t nb_pixels)
+{
+  for(size_t i = 0;i < nb_pixels;++i)
+    dst[i] += src[i];
+}
+
+static void _widen_store_masked(uint32_t* dst,const uint16_t* src,
+				size_t nb_pixels,uint16_t saturation)
+{
+  for(size_t i = 0;i < nb_pixels;++i)
+    dst[i] = src[i] >= saturation ? SATURATED_SUM : src[i];
+}
+
+static void _widen_add_masked(uint32_t* dst,const uint16_t* src,
+			      size_t nb_pixels,uint16_t saturation)
+{
+  for(size_t i = 0;i < nb_pixels;++i)
+    if(src[i] >= saturation || dst[i] == SATURATED_SUM)
+      dst[i] = SATURATED_SUM;
+    else
+      dst[i] += src[i];
+}
+
+static void _subtract_dark(uint16_t* dst,const uint16_t* src,
+			   const uint16_t* dark,size_t nb_pixels)
+{
+  for(size_t i = 0;i < nb_pixels;++i)
+    dst[i] = src[i] > dark[i] ? src[i] - dark[i] : 0;
+}
+
+// rounded to nearest even like the SIMD conversions
+static void _correct_flat(uint16_t* dst,const uint16_t* src,
+			  const uint16_t* dark,const float* gain,
+			  size_t nb_pixels)
+{
+  for(size_t i = 0;i < nb_pixels;++i)
+    {
+      float v = float(int(src[i]) - int(dark[i])) * gain[i];
+      v = std::min(std::max(v,0.f),65535.f);
+      dst[i] = uint16_t(std::lrint(v));
+    }
+}
+
+#ifdef PRINCETON_X86
+TARGET_SSE2
+static void _widen_store_sse2(uint32_t* dst,const uint16_t* src,size_t nb_pixels)
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for(;i + 8 <= nb_pixels;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      _mm_storeu_si128((__m128i*)(dst + i),_mm_unpacklo_epi16(v,zero));
+      _mm_storeu_si128((__m128i*)(dst + i + 4),_mm_unpackhi_epi16(v,zero));
+    }
+  _widen_store(dst + i,src + i,nb_pixels - i);
+}
+
+TARGET_SSE2
+static void _widen_add_sse2(uint32_t* dst,const uint16_t* src,size_t nb_pixels)
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for(;i + 8 <= nb_pixels;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i lo = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(dst + i + 4));
+      lo = _mm_add_epi32(lo,_mm_unpacklo_epi16(v,zero));
+      hi = _mm_add_epi32(hi,_mm_unpackhi_epi16(v,zero));
+      _mm_storeu_si128((__m128i*)(dst + i),lo);
+      _mm_storeu_si128((__m128i*)(dst + i + 4),hi);
+    }
+  _widen_add(dst + i,src + i,nb_pixels - i);
+}
+
+// Widened pixels are below 2^16, a signed compare with saturation - 1
+// gives the mask which is or'ed in the result to saturate it
+TARGET_SSE2
+static void _widen_store_masked_sse2(uint32_t* dst,const uint16_t* src,
+				     size_t nb_pixels,uint16_t saturation)
+{
+  if(!saturation)
+    return _widen_store_masked(dst,src,nb_pixels,saturation);
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi32(saturation - 1);
+  size_t i = 0;
+  for(;i + 8 <= nb_pixels;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i lo = _mm_unpacklo_epi16(v,zero);
+      __m128i hi = _mm_unpackhi_epi16(v,zero);
+      lo = _mm_or_si128(lo,_mm_cmpgt_epi32(lo,limit));
+      hi = _mm_or_si128(hi,_mm_cmpgt_epi32(hi,limit));
+      _mm_storeu_si128((__m128i*)(dst + i),lo);
+      _mm_storeu_si128((__m128i*)(dst + i + 4),hi);
+    }
+  _widen_store_masked(dst + i,src + i,nb_pixels - i,saturation);
+}
+
+TARGET_SSE2
+static void _widen_add_masked_sse2(uint32_t* dst,const uint16_t* src,
+				   size_t nb_pixels,uint16_t saturation)
+{
+  if(!saturation)
+    return _widen_add_masked(dst,src,nb_pixels,saturation);
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi32(saturation - 1);
+  const __m128i saturated = _mm_set1_epi32(-1);
+  size_t i = 0;
+  for(;i + 8 <= nb_pixels;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i v_lo = _mm_unpacklo_epi16(v,zero);
+      __m128i v_hi = _mm_unpackhi_epi16(v,zero);
+      __m128i lo = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(dst + i + 4));
+      __m128i mask_lo = _mm_or_si128(_mm_cmpgt_epi32(v_lo,limit),
+				     _mm_cmpeq_epi32(lo,saturated));
+      __m128i mask_hi = _mm_or_si128(_mm_cmpgt_epi32(v_hi,limit),
+				     _mm_cmpeq_epi32(hi,saturated));
+      lo = _mm_or_si128(_mm_add_epi32(lo,v_lo),mask_lo);
+      hi = _mm_or_si128(_mm_add_epi32(hi,v_hi),mask_hi);
+      _mm_storeu_si128((__m128i*)(dst + i),lo);
+      _mm_storeu_si128((__m128i*)(dst + i + 4),hi);
+    }
+  _widen_add_masked(dst + i,src + i,nb_pixels - i,saturation);
+}
+
+TARGET_SSE2
+static void _subtract_dark_sse2(uint16_t* dst,const uint16_t* src,
+				const uint16_t* dark,size_t nb_pixels)
+{
+  size_t i = 0;
+  for(;i + 8 <= nb_pixels;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dark + i));
+      _mm_storeu_si128((__m128i*)(dst + i),_mm_subs_epu16(v,d));
+    }
+  _subtract_dark(dst + i,src + i,dark + i,nb_pixels - i);
+}
+
+// SSE2 has no unsigned 32 to 16 bits pack, values are shifted by
+// 32768 around a signed pack
+TARGET_SSE2
+static void _correct_flat_sse2(uint16_t* dst,const uint16_t* src,
+			       const uint16_t* dark,const float* gain,
+			       size_t nb_pixels)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 min = _mm_setzero_ps();
+  const __m128 max = _mm_set1_ps(65535.f);
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+  size_t i = 0;
+  for(;i + 8 <= nb_pixels;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dark + i));
+      __m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(v,zero),
+				 _mm_unpacklo_epi16(d,zero));
+      __m128i hi = _mm_sub_epi32(_mm_unpackhi_epi16(v,zero),
+				 _mm_unpackhi_epi16(d,zero));
+      __m128 f_lo = _mm_mul_ps(_mm_cvtepi32_ps(lo),_mm_loadu_ps(gain + i));
+      __m128 f_hi = _mm_mul_ps(_mm_cvtepi32_ps(hi),_mm_loadu_ps(gain + i + 4));
+      f_lo = _mm_min_ps(_mm_max_ps(f_lo,min),max);
+      f_hi = _mm_min_ps(_mm_max_ps(f_hi,min),max);
+      lo = _mm_sub_epi32(_mm_cvtps_epi32(f_lo),bias32);
+      hi = _mm_sub_epi32(_mm_cvtps_epi32(f_hi),bias32);
+      __m128i r = _mm_xor_si128(_mm_packs_epi32(lo,hi),bias16);
+      _mm_storeu_si128((__m128i*)(dst + i),r);
+    }
+  _correct_flat(dst + i,src + i,dark + i,gain + i,nb_pixels - i);
+}
+
+TARGET_AVX2
+static void _widen_store_avx2(uint32_t* dst,const uint16_t* src,size_t nb_pixels)
+{
+  size_t i = 0;
+  for(;i + 16 <= nb_pixels;i += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      _mm256_storeu_si256((__m256i*)(dst + i),
+			  _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+      _mm256_storeu_si256((__m256i*)(dst + i + 8),
+			  _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v,1)));
+    }
+  _widen_store(dst + i,src + i,nb_pixels - i);
+}
+
+TARGET_AVX2
+static void _widen_add_avx2(uint32_t* dst,const uint16_t* src,size_t nb_pixels)
+{
+  size_t i = 0;
+  for(;i + 16 <= nb_pixels;i += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i lo = _mm256_loadu_si256((const __m256i*)(dst + i));
+      __m256i hi = _mm256_loadu_si256((const __m256i*)(dst + i + 8));
+      lo = _mm256_add_epi32(lo,_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+      hi = _mm256_add_epi32(hi,_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v,1)));
+      _mm256_storeu_si256((__m256i*)(dst + i),lo);
+      _mm256_storeu_si256((__m256i*)(dst + i + 8),hi);
+    }
+  _widen_add(dst + i,src + i,nb_pixels - i);
+}
+
+TARGET_AVX2
+static void _widen_store_masked_avx2(uint32_t* dst,const uint16_t* src,
+				     size_t nb_pixels,uint16_t saturation)
+{
+  if(!saturation)
+    return _widen_store_masked(dst,src,nb_pixels,saturation);
+
+  const __m256i limit = _mm256_set1_epi32(saturation - 1);
+  size_t i = 0;
+  for(;i + 16 <= nb_pixels;i += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v));
+      __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v,1));
+      lo = _mm256_or_si256(lo,_mm256_cmpgt_epi32(lo,limit));
+      hi = _mm256_or_si256(hi,_mm256_cmpgt_epi32(hi,limit));
+      _mm256_storeu_si256((__m256i*)(dst + i),lo);
+      _mm256_storeu_si256((__m256i*)(dst + i + 8),hi);
+    }
+  _widen_store_masked(dst + i,src + i,nb_pixels - i,saturation);
+}
+
+TARGET_AVX2
+static void _widen_add_masked_avx2(uint32_t* dst,const uint16_t* src,
+				   size_t nb_pixels,uint16_t saturation)
+{
+  if(!saturation)
+    return _widen_add_masked(dst,src,nb_pixels,saturation);
+
+  const __m256i limit = _mm256_set1_epi32(saturation - 1);
+  const __m256i saturated = _mm256_set1_epi32(-1);
+  size_t i = 0;
+  for(;i + 16 <= nb_pixels;i += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i v_lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v));
+      __m256i v_hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v,1));
+      __m256i lo = _mm256_loadu_si256((const __m256i*)(dst + i));
+      __m256i hi = _mm256_loadu_si256((const __m256i*)(dst + i + 8));
+      __m256i mask_lo = _mm256_or_si256(_mm256_cmpgt_epi32(v_lo,limit),
+					_mm256_cmpeq_epi32(lo,saturated));
+      __m256i mask_hi = _mm256_or_si256(_mm256_cmpgt_epi32(v_hi,limit),
+					_mm256_cmpeq_epi32(hi,saturated));
+      lo = _mm256_or_si256(_mm256_add_epi32(lo,v_lo),mask_lo);
+      hi = _mm256_or_si256(_mm256_add_epi32(hi,v_hi),mask_hi);
+      _mm256_storeu_si256((__m256i*)(dst + i),lo);
+      _mm256_storeu_si256((__m256i*)(dst + i + 8),hi);
+    }
+  _widen_add_masked(dst + i,src + i,nb_pixels - i,saturation);
+}
+
+TARGET_AVX2
+static void _subtract_dark_avx2(uint16_t* dst,const uint16_t* src,
+				const uint16_t* dark,size_t nb_pixels)
+{
+  size_t i = 0;
+  for(;i + 16 <= nb_pixels;i += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i d = _mm256_loadu_si256((const __m256i*)(dark + i));
+      _mm256_storeu_si256((__m256i*)(dst + i),_mm256_subs_epu16(v,d));
+    }
+  _subtract_dark(dst + i,src + i,dark + i,nb_pixels - i);
+}
+
+// the pack works in 128 bits lanes, a permute puts the pixels back in order
+TARGET_AVX2
+static void _correct_flat_avx2(uint16_t* dst,const uint16_t* src,
+			       const uint16_t* dark,const float* gain,
+			       size_t nb_pixels)
+{
+  const __m256 min = _mm256_setzero_ps();
+  const __m256 max = _mm256_set1_ps(65535.f);
+  size_t i = 0;
+  for(;i + 16 <= nb_pixels;i += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i d = _mm256_loadu_si256((const __m256i*)(dark + i));
+      __m256i lo = _mm256_sub_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)),
+				    _mm256_cvtepu16_epi32(_mm256_castsi256_si128(d)));
+      __m256i hi = _mm256_sub_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v,1)),
+				    _mm256_cvtepu16_epi32(_mm256_extracti128_si256(d,1)));
+      __m256 f_lo = _mm256_mul_ps(_mm256_cvtepi32_ps(lo),_mm256_loadu_ps(gain + i));
+      __m256 f_hi = _mm256_mul_ps(_mm256_cvtepi32_ps(hi),_mm256_loadu_ps(gain + i + 8));
+      f_lo = _mm256_min_ps(_mm256_max_ps(f_lo,min),max);
+      f_hi = _mm256_min_ps(_mm256_max_ps(f_hi,min),max);
+      __m256i r = _mm256_packus_epi32(_mm256_cvtps_epi32(f_lo),
+				      _mm256_cvtps_epi32(f_hi));
+      r = _mm256_permute4x64_epi64(r,0xd8);
+      _mm256_storeu_si256((__m256i*)(dst + i),r);
+    }
+  _correct_flat(dst + i,src + i,dark + i,gain + i,nb_pixels - i);
+}
+#endif
+
+static PixelKernels _selectPixelKernels()
+{
+#ifdef PRINCETON_X86
+  if(cpuHasAvx2())
+    return {_widen_store_avx2,_widen_add_avx2,
+	    _widen_store_masked_avx2,_widen_add_masked_avx2,
+	    _subtract_dark_avx2,_correct_flat_avx2,"avx2"};
+  if(cpuHasSse2())
+    return {_widen_store_sse2,_widen_add_sse2,
+	    _widen_store_masked_sse2,_widen_add_masked_sse2,
+	    _subtract_dark_sse2,_correct_flat_sse2,"sse2"};
+#endif
+  return {_widen_store,_widen_add,
+	  _widen_store_masked,_widen_add_masked,
+	  _subtract_dark,_correct_flat,"c++"};
+}
+
+const PixelKernels& Princeton::getPixelKernels()
+{
+  static const PixelKernels kernels = _selectPixelKernels();
+  return kernels;
+}
@@ -0,0 +1,68 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONPIXELKERNELS_H
+#define PRINCETONPIXELKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /// dst[i] = src[i] (store) or dst[i] += src[i] (add), 16 to 32 bits
+    typedef void (*WidenFunction)(uint32_t* dst,const uint16_t* src,
+				  size_t nb_pixels);
+    /// same with saturation masking: a source pixel >= saturation
+    /// gives SATURATED_SUM, which then stays through the next adds
+    typedef void (*WidenMaskFunction)(uint32_t* dst,const uint16_t* src,
+				      size_t nb_pixels,uint16_t saturation);
+    static const uint32_t SATURATED_SUM = 0xffffffff;
+
+    /// dst[i] = max(src[i] - dark[i],0)
+    typedef void (*DarkFunction)(uint16_t* dst,const uint16_t* src,
+				 const uint16_t* dark,size_t nb_pixels);
+    /// dst[i] = (src[i] - dark[i]) * gain[i] rounded in [0,65535]
+    typedef void (*FlatFunction)(uint16_t* dst,const uint16_t* src,
+				 const uint16_t* dark,const float* gain,
+				 size_t nb_pixels);
+
+    /** @brief 16 to 32 bits and correction pixel kernels, the fastest
+     *	ones supported by the running CPU (AVX2, SSE2 or plain C++).
+     */
+    struct PixelKernels
+    {
+      WidenFunction	widen_store;
+      WidenFunction	widen_add;
+      WidenMaskFunction	widen_store_masked;
+      WidenMaskFunction	widen_add_masked;
+      DarkFunction	subtract_dark;
+      FlatFunction	correct_flat;
+      const char*	name;
+    };
+    const PixelKernels& getPixelKernels();
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONPIXELKERNELS_H
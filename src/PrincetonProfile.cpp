@@ -0,0 +1,250 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <fstream>
+#include <sstream>
+#include <limits>
+
+#include "PrincetonProfile.h"
+#include "PrincetonParameterCache.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+// first line of a profile file
+static const char PROFILE_HEADER[] = "# Princeton profile v1";
+
+/** @brief parameters owned by Lima and the plugin: the frame geometry,
+ *  and the exposure, trigger and shutter that Lima keeps and writes
+ *  back on each acquisition through the control objects.
+ */
+static bool _isExcluded(PicamParameter parameter)
+{
+  switch(parameter)
+    {
+    case PicamParameter_ReadoutCount:
+    case PicamParameter_ReadoutControlMode:
+    case PicamParameter_KineticsWindowHeight:
+    case PicamParameter_ExposureTime:
+    case PicamParameter_TriggerResponse:
+    case PicamParameter_TriggerDetermination:
+    case PicamParameter_TriggerSource:
+    case PicamParameter_ShutterTimingMode:
+    case PicamParameter_ShutterOpeningDelay:
+    case PicamParameter_ShutterClosingDelay:
+      return true;
+    default:
+      return false;
+    }
+}
+
+Profile::Profile() :
+  m_buffer_size(0)
+{
+}
+
+void Profile::capture(PicamHandle cam)
+{
+  DEB_MEMBER_FUNCT();
+  m_values.clear();
+
+  const PicamParameter* parameters;
+  piint parameters_count;
+  CHECK_PICAM(Picam_GetParameters(cam,&parameters,&parameters_count));
+  try
+    {
+      for(piint i = 0;i < parameters_count;++i)
+	{
+	  PicamParameter parameter = parameters[i];
+	  if(_isExcluded(parameter))
+	    continue;
+
+	  PicamValueAccess access;
+	  CHECK_PICAM(Picam_GetParameterValueAccess(cam,parameter,&access));
+	  if(access == PicamValueAccess_ReadOnly)
+	    continue;
+
+	  Value value;
+	  value.parameter = parameter;
+	  value.integer = 0;
+	  value.floating_point = 0.;
+	  CHECK_PICAM(Picam_GetParameterValueType(cam,parameter,&value.type));
+	  switch(value.type)
+	    {
+	    case PicamValueType_Integer:
+	    case PicamValueType_Boolean:
+	    case PicamValueType_Enumeration:
+	      {
+		piint integer;
+		CHECK_PICAM(Picam_GetParameterIntegerValue(cam,parameter,&integer));
+		value.type = PicamValueType_Integer;
+		value.integer = integer;
+	      }
+	      break;
+	    case PicamValueType_LargeInteger:
+	      CHECK_PICAM(Picam_GetParameterLargeIntegerValue(cam,parameter,
+							      &value.integer));
+	      break;
+	    case PicamValueType_FloatingPoint:
+	      CHECK_PICAM(Picam_GetParameterFloatingPointValue(cam,parameter,
+							       &value.floating_point));
+	      break;
+	    default:		// rois, pulse, modulations
+	      continue;
+	    }
+	  m_values.push_back(value);
+	}
+    }
+  catch(...)
+    {
+      Picam_DestroyParameters(parameters);
+      throw;
+    }
+  Picam_DestroyParameters(parameters);
+  DEB_TRACE() << DEB_VAR1(m_values.size());
+}
+
+int Profile::apply(ParameterCache& parameters) const
+{
+  DEB_MEMBER_FUNCT();
+  int nb_changed = 0;
+  for(auto i = m_values.begin();i != m_values.end();++i)
+    {
+      switch(i->type)
+	{
+	case PicamValueType_Integer:
+	  if(parameters.getIntegerValue(i->parameter) == piint(i->integer))
+	    continue;
+	  parameters.setIntegerValue(i->parameter,piint(i->integer));
+	  break;
+	case PicamValueType_LargeInteger:
+	  if(parameters.getLargeIntegerValue(i->parameter) == i->integer)
+	    continue;
+	  parameters.setLargeIntegerValue(i->parameter,i->integer);
+	  break;
+	default:
+	  if(parameters.getFloatingPointValue(i->parameter) == i->floating_point)
+	    continue;
+	  parameters.setFloatingPointValue(i->parameter,i->floating_point);
+	  break;
+	}
+      DEB_TRACE() << "Change " << get_parameter_name(i->parameter);
+      ++nb_changed;
+    }
+  DEB_RETURN() << DEB_VAR1(nb_changed);
+  return nb_changed;
+}
+
+/** @brief text file, one parameter per line:
+ *  parameter <id> <type> <value> <name>
+ */
+void Profile::save(const std::string& filename) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(filename);
+
+  std::ofstream file(filename.c_str());
+  if(!file)
+    THROW_HW_ERROR(Error) << "Can't create profile file " << filename;
+
+  file.precision(std::numeric_limits<double>::digits10 + 2);
+  file << PROFILE_HEADER << std::endl;
+  file << "buffer " << m_buffer_size << " "
+       << m_alloc_options.huge_page_size << " "
+       << m_alloc_options.lock << " "
+       << m_alloc_options.prefault << " "
+       << m_alloc_options.numa_node << std::endl;
+  for(auto i = m_values.begin();i != m_values.end();++i)
+    {
+      file << "parameter " << int(i->parameter) << " " << int(i->type) << " ";
+      if(i->type == PicamValueType_FloatingPoint)
+	file << i->floating_point;
+      else
+	file << i->integer;
+      file << " " << get_parameter_name(i->parameter) << std::endl;
+    }
+  if(!file)
+    THROW_HW_ERROR(Error) << "Failed to write profile file " << filename;
+}
+
+void Profile::load(const std::string& filename)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(filename);
+
+  std::ifstream file(filename.c_str());
+  if(!file)
+    THROW_HW_ERROR(Error) << "Can't open profile file " << filename;
+
+  std::string line;
+  if(!std::getline(file,line) || line != PROFILE_HEADER)
+    THROW_HW_ERROR(Error) << filename << " is not a profile file";
+
+  std::vector<Value> values;
+  long long buffer_size = 0;
+  AcqMemoryOptions alloc_options;
+  for(int line_nb = 2;std::getline(file,line);++line_nb)
+    {
+      std::istringstream fields(line);
+      std::string keyword;
+      if(!(fields >> keyword) || keyword[0] == '#')
+	continue;
+
+      bool valid;
+      if(keyword == "buffer")
+	valid = bool(fields >> buffer_size >> alloc_options.huge_page_size
+		     >> alloc_options.lock >> alloc_options.prefault
+		     >> alloc_options.numa_node);
+      else if(keyword == "parameter")
+	{
+	  int parameter,type;
+	  Value value;
+	  value.integer = 0;
+	  value.floating_point = 0.;
+	  valid = bool(fields >> parameter >> type);
+	  value.parameter = PicamParameter(parameter);
+	  value.type = PicamValueType(type);
+	  if(valid && value.type == PicamValueType_FloatingPoint)
+	    valid = bool(fields >> value.floating_point);
+	  else if(valid && (value.type == PicamValueType_Integer ||
+			    value.type == PicamValueType_LargeInteger))
+	    valid = bool(fields >> value.integer);
+	  else
+	    valid = false;
+	  // files written before these were excluded
+	  if(valid && !_isExcluded(value.parameter))
+	    values.push_back(value);
+	}
+      else
+	valid = false;
+
+      if(!valid)
+	THROW_HW_ERROR(Error) << "Invalid profile line " << line_nb
+			      << " in " << filename;
+    }
+
+  m_values.swap(values);
+  m_buffer_size = buffer_size;
+  m_alloc_options = alloc_options;
+}
@@ -0,0 +1,82 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONPROFILE_H
+#define PRINCETONPROFILE_H
+
+#include <string>
+#include <vector>
+
+#include <picam.h>
+
+#include "lima/Debug.h"
+#include "PrincetonMemory.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    class ParameterCache;
+
+    /** Snapshot of the settable PICam parameters with the acquisition
+     *	buffer allocation that goes with them.
+     *	The readout count, readout mode, rois, exposure, trigger and
+     *	shutter are not part of a profile, they follow Lima acquisition,
+     *	image and shutter settings. Pulse and modulation parameters are
+     *	not handled.
+     */
+    class Profile
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"Profile","Princeton");
+    public:
+      Profile();
+
+      void capture(PicamHandle cam);
+      /// stage the parameters which differ from the current values,
+      /// returns the number of staged parameters
+      int apply(ParameterCache&) const;
+
+      void save(const std::string& filename) const;
+      void load(const std::string& filename);
+
+      void setBufferSize(long long size) {m_buffer_size = size;}
+      long long getBufferSize() const {return m_buffer_size;}
+      void setAllocOptions(const AcqMemoryOptions& options) {m_alloc_options = options;}
+      const AcqMemoryOptions& getAllocOptions() const {return m_alloc_options;}
+    private:
+      struct Value
+      {
+	PicamParameter	parameter;
+	PicamValueType	type;
+	pi64s		integer;
+	piflt		floating_point;
+      };
+
+      std::vector<Value>	m_values;
+      long long			m_buffer_size;
+      AcqMemoryOptions		m_alloc_options;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONPROFILE_H
@@ -0,0 +1,121 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONREADOUTQUEUE_H
+#define PRINCETONREADOUTQUEUE_H
+
+#include <atomic>
+#include <vector>
+
+#include <picam.h>
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Readout descriptor, as given by PICam acquisition callback.
+     *	It only points in the PICam acquisition buffer, no data is copied.
+     */
+    struct Readout
+    {
+      void*				initial_readout;
+      pi64s				readout_count;
+      pibln				running;
+      PicamAcquisitionErrorsMask	errors;
+      long long				entry_time; // ns, callback entry
+    };
+
+    /** Single producer (PICam callback) / single consumer (dispatcher)
+     *	lock-free ring of readout descriptors.
+     */
+    class ReadoutQueue
+    {
+    public:
+      explicit ReadoutQueue(unsigned int capacity = 1024) :
+	m_ring(_roundUp(capacity)),
+	m_mask(m_ring.size() - 1),
+	m_head(0),
+	m_tail(0),
+	m_high_water_mark(0)
+      {}
+
+      /// producer side, return false if the queue is full
+      bool push(const Readout& readout)
+      {
+	unsigned int tail = m_tail.load(std::memory_order_relaxed);
+	unsigned int head = m_head.load(std::memory_order_acquire);
+	unsigned int depth = tail - head;
+	if(depth > m_mask)
+	  return false;
+	m_ring[tail & m_mask] = readout;
+	m_tail.store(tail + 1,std::memory_order_release);
+
+	if(++depth > m_high_water_mark.load(std::memory_order_relaxed))
+	  m_high_water_mark.store(depth,std::memory_order_relaxed);
+	return true;
+      }
+
+      /// consumer side, return false if the queue is empty
+      bool pop(Readout& readout)
+      {
+	unsigned int head = m_head.load(std::memory_order_relaxed);
+	if(head == m_tail.load(std::memory_order_acquire))
+	  return false;
+	readout = m_ring[head & m_mask];
+	m_head.store(head + 1,std::memory_order_release);
+	return true;
+      }
+
+      bool empty() const
+      {
+	return m_head.load(std::memory_order_acquire) ==
+	  m_tail.load(std::memory_order_acquire);
+      }
+
+      int depth() const
+      {
+	return int(m_tail.load(std::memory_order_acquire) -
+		   m_head.load(std::memory_order_acquire));
+      }
+      int highWaterMark() const {return int(m_high_water_mark.load());}
+      int capacity() const {return int(m_ring.size());}
+      /// only call when the producer is idle
+      void resetHighWaterMark() {m_high_water_mark.store(depth());}
+    private:
+      static unsigned int _roundUp(unsigned int value)
+      {
+	unsigned int size = 2;
+	while(size < value) size <<= 1;
+	return size;
+      }
+
+      std::vector<Readout>	m_ring;
+      unsigned int		m_mask;
+      std::atomic<unsigned int>	m_head;
+      std::atomic<unsigned int>	m_tail;
+      std::atomic<unsigned int>	m_high_water_mark;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONREADOUTQUEUE_H
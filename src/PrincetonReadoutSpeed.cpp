@@ -0,0 +1,232 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include <cmath>
+
+#include "PrincetonReadoutSpeed.h"
+#include "PrincetonParameterCache.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+ReadoutSpeed::ReadoutSpeed(PicamHandle cam,ParameterCache& parameters) :
+  m_cam(cam),
+  m_parameters(parameters)
+{
+  DEB_CONSTRUCTOR();
+  _getCapable(PicamParameter_AdcSpeed,m_speeds);
+  _getCapable(PicamParameter_AdcQuality,m_qualities);
+  _getCapable(PicamParameter_AdcAnalogGain,m_gains);
+  _getCapable(PicamParameter_ReadoutPortCount,m_ports);
+  std::sort(m_speeds.begin(),m_speeds.end());
+  std::sort(m_ports.begin(),m_ports.end());
+  DEB_TRACE() << DEB_VAR4(m_speeds.size(),m_qualities.size(),
+			  m_gains.size(),m_ports.size());
+}
+
+template<class T>
+void ReadoutSpeed::_getCapable(PicamParameter parameter,std::vector<T>& values)
+{
+  DEB_MEMBER_FUNCT();
+  if(!_exists(parameter))
+    return;
+
+  const PicamCollectionConstraint* capability;
+  CHECK_PICAM(Picam_GetParameterCollectionConstraint(m_cam,parameter,
+						     PicamConstraintCategory_Capable,
+						     &capability));
+  for(int i = 0;i < capability->values_count;++i)
+    values.push_back(T(capability->values_array[i]));
+  CHECK_PICAM(Picam_DestroyCollectionConstraints(capability));
+}
+
+bool ReadoutSpeed::_exists(PicamParameter parameter)
+{
+  DEB_MEMBER_FUNCT();
+  pibln exists;
+  CHECK_PICAM(Picam_DoesParameterExist(m_cam,parameter,&exists));
+  return exists;
+}
+
+void ReadoutSpeed::setAdcSpeed(double speed)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(speed);
+  if(m_speeds.empty())
+    THROW_HW_ERROR(NotSupported) << "Camera has no ADC speed setting";
+  // speeds are MHz floating point values, match the nearest one
+  auto nearest = m_speeds.begin();
+  for(auto i = m_speeds.begin();i != m_speeds.end();++i)
+    if(std::abs(*i - speed) < std::abs(*nearest - speed))
+      nearest = i;
+  if(std::abs(*nearest - speed) > 1e-3 * *nearest)
+    THROW_HW_ERROR(InvalidValue) << "ADC speed " << DEB_VAR1(speed)
+				 << " MHz not supported";
+  m_parameters.setFloatingPointValue(PicamParameter_AdcSpeed,*nearest);
+}
+
+double ReadoutSpeed::getAdcSpeed()
+{
+  return m_speeds.empty() ? 0. :
+    m_parameters.getFloatingPointValue(PicamParameter_AdcSpeed);
+}
+
+void ReadoutSpeed::setAdcQuality(piint quality)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(quality);
+  if(std::find(m_qualities.begin(),m_qualities.end(),quality) == m_qualities.end())
+    THROW_HW_ERROR(NotSupported) << "ADC quality " << DEB_VAR1(quality)
+				 << " not supported by the camera";
+  m_parameters.setIntegerValue(PicamParameter_AdcQuality,quality);
+}
+
+piint ReadoutSpeed::getAdcQuality()
+{
+  return m_qualities.empty() ? 0 :
+    m_parameters.getIntegerValue(PicamParameter_AdcQuality);
+}
+
+void ReadoutSpeed::setAdcAnalogGain(piint gain)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(gain);
+  if(std::find(m_gains.begin(),m_gains.end(),gain) == m_gains.end())
+    THROW_HW_ERROR(NotSupported) << "ADC analog gain " << DEB_VAR1(gain)
+				 << " not supported by the camera";
+  m_parameters.setIntegerValue(PicamParameter_AdcAnalogGain,gain);
+}
+
+piint ReadoutSpeed::getAdcAnalogGain()
+{
+  return m_gains.empty() ? 0 :
+    m_parameters.getIntegerValue(PicamParameter_AdcAnalogGain);
+}
+
+void ReadoutSpeed::setReadoutPortCount(piint nb_ports)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_ports);
+  if(std::find(m_ports.begin(),m_ports.end(),nb_ports) == m_ports.end())
+    THROW_HW_ERROR(NotSupported) << "Readout port count " << DEB_VAR1(nb_ports)
+				 << " not supported by the camera";
+  m_parameters.setIntegerValue(PicamParameter_ReadoutPortCount,nb_ports);
+}
+
+piint ReadoutSpeed::getReadoutPortCount()
+{
+  return m_ports.empty() ? 1 :
+    m_parameters.getIntegerValue(PicamParameter_ReadoutPortCount);
+}
+
+/** @brief the frame rate of each combination is the PICam
+ *  FrameRateCalculation with the combination set (not committed).
+ *  Combinations refused by PICam are skipped.
+ */
+double ReadoutSpeed::select(const std::vector<piint>& qualities,double max_speed,
+			    double min_frame_rate)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR3(qualities.size(),max_speed,min_frame_rate);
+
+  if(m_parameters.inTransaction())
+    THROW_HW_ERROR(Error) << "Can't select readout speed in a parameter transaction";
+
+  Setting current = {getAdcQuality(),getAdcSpeed(),getReadoutPortCount()};
+  std::vector<double> speeds = m_speeds;
+  if(speeds.empty())
+    speeds.push_back(current.speed);
+  std::vector<piint> ports = m_ports;
+  if(ports.empty())
+    ports.push_back(current.nb_ports);
+  std::vector<piint> tried_qualities;
+  for(auto quality = qualities.begin();quality != qualities.end();++quality)
+    if(std::find(m_qualities.begin(),m_qualities.end(),*quality) != m_qualities.end())
+      tried_qualities.push_back(*quality);
+  if(m_qualities.empty())
+    tried_qualities.push_back(current.quality);
+  else if(tried_qualities.empty())
+    THROW_HW_ERROR(NotSupported) << "None of the ADC qualities is supported";
+
+  bool found = false;
+  Setting best = current;
+  double best_frame_rate = 0.;
+  for(auto quality = tried_qualities.begin();quality != tried_qualities.end();++quality)
+    for(auto speed = speeds.begin();speed != speeds.end();++speed)
+      {
+	if(max_speed > 0. && *speed > max_speed)
+	  continue;
+	for(auto nb_ports = ports.begin();nb_ports != ports.end();++nb_ports)
+	  {
+	    Setting setting = {*quality,*speed,*nb_ports};
+	    double frame_rate;
+	    try
+	      {
+		_apply(setting);
+		m_parameters.invalidate(PicamParameter_FrameRateCalculation);
+		frame_rate = m_parameters.getFloatingPointValue(PicamParameter_FrameRateCalculation);
+	      }
+	    catch(Exception&)
+	      {
+		DEB_TRACE() << "Skip " << DEB_VAR3(*quality,*speed,*nb_ports);
+		continue;
+	      }
+	    DEB_TRACE() << DEB_VAR4(*quality,*speed,*nb_ports,frame_rate);
+
+	    bool better;
+	    if(min_frame_rate <= 0.)
+	      better = frame_rate > best_frame_rate;
+	    // qualities are in preference order, speeds and ports ascending
+	    else
+	      better = !found && frame_rate >= min_frame_rate;
+	    if(better)
+	      {
+		found = true;
+		best = setting;
+		best_frame_rate = frame_rate;
+	      }
+	  }
+      }
+
+  if(!found)
+    {
+      _apply(current);
+      THROW_HW_ERROR(InvalidValue) << "No readout speed reaches "
+				   << DEB_VAR1(min_frame_rate);
+    }
+  _apply(best);
+  DEB_RETURN() << DEB_VAR4(best.quality,best.speed,best.nb_ports,best_frame_rate);
+  return best_frame_rate;
+}
+
+void ReadoutSpeed::_apply(const Setting& setting)
+{
+  if(!m_qualities.empty())
+    m_parameters.setIntegerValue(PicamParameter_AdcQuality,setting.quality);
+  if(!m_speeds.empty())
+    m_parameters.setFloatingPointValue(PicamParameter_AdcSpeed,setting.speed);
+  if(!m_ports.empty())
+    m_parameters.setIntegerValue(PicamParameter_ReadoutPortCount,setting.nb_ports);
+}
@@ -0,0 +1,96 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONREADOUTSPEED_H
+#define PRINCETONREADOUTSPEED_H
+
+#include <vector>
+
+#include <picam.h>
+
+#include "lima/Debug.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    class ParameterCache;
+
+    /** ADC speed, quality, analog gain and readout port count with the
+     *	values the camera is capable of.
+     *	PICam already unscrambles multi-port readouts, frames are
+     *	delivered in sensor order whatever the port count.
+     */
+    class ReadoutSpeed
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"ReadoutSpeed","Princeton");
+    public:
+      ReadoutSpeed(PicamHandle cam,ParameterCache&);
+
+      void setAdcSpeed(double speed);
+      double getAdcSpeed();
+      const std::vector<double>& getAdcSpeedList() const {return m_speeds;}
+
+      void setAdcQuality(piint quality);
+      piint getAdcQuality();
+      const std::vector<piint>& getAdcQualityList() const {return m_qualities;}
+
+      void setAdcAnalogGain(piint gain);
+      piint getAdcAnalogGain();
+      const std::vector<piint>& getAdcAnalogGainList() const {return m_gains;}
+
+      void setReadoutPortCount(piint nb_ports);
+      piint getReadoutPortCount();
+      const std::vector<piint>& getReadoutPortCountList() const {return m_ports;}
+
+      /** Try the quality/speed/port combinations, with ADC speed up to
+       *	max_speed (0 for no limit). If min_frame_rate is 0, set the one
+       *	with the highest frame rate, otherwise the slowest (least noisy)
+       *	one which reaches min_frame_rate. Return the frame rate.
+       */
+      double select(const std::vector<piint>& qualities,double max_speed,
+		    double min_frame_rate);
+    private:
+      struct Setting
+      {
+	piint	quality;
+	double	speed;
+	piint	nb_ports;
+      };
+
+      template<class T>
+      void _getCapable(PicamParameter,std::vector<T>&);
+      bool _exists(PicamParameter);
+      void _apply(const Setting&);
+
+      PicamHandle		m_cam;
+      ParameterCache&		m_parameters;
+      std::vector<double>	m_speeds;
+      std::vector<piint>	m_qualities;
+      std::vector<piint>	m_gains;
+      std::vector<piint>	m_ports;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONREADOUTSPEED_H
@@ -20,28 +20,29 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
 
+#include <algorithm>
+
 #include "PrincetonRoiCtrlObj.h"
 #include "PrincetonException.h"
+#include "PrincetonRoiSolver.h"
+#include "PrincetonSyncCtrlObj.h"
 
 using namespace lima;
 using namespace lima::Princeton;
 
-RoiCtrlObj::RoiCtrlObj(PicamHandle cam, BinCtrlObj& bin) :
+RoiCtrlObj::RoiCtrlObj(PicamHandle cam, DetInfoCtrlObj& det_info,
+		       BinCtrlObj& bin, RoiSolver& solver,
+		       SyncCtrlObj& sync) :
   m_cam(cam),
-  m_bin(bin)
+  m_det_info(det_info),
+  m_bin(bin),
+  m_solver(solver),
+  m_sync(sync),
+  m_full_vertical_binning(false),
+  m_kinetics_window(0),
+  m_spectra_kinetics(false)
 {
   DEB_CONSTRUCTOR();
-  const PicamRoisConstraint  *constraint;
-  CHECK_PICAM(Picam_GetParameterRoisConstraint(m_cam, 
-					       PicamParameter_Rois, 
-					       PicamConstraintCategory_Required, 
-					       &constraint));
-  /* Get width and height from constraints */
-  m_rows  = (piint)constraint->width_constraint.maximum;
-  m_columns = (piint)constraint->height_constraint.maximum;
-  m_rules = constraint->rules;
-  Picam_DestroyRoisConstraints(constraint);
-
   //Init roi to full frame
   setRoi({0,0,0,0});
 }
@@ -53,26 +54,37 @@ RoiCtrlObj::~RoiCtrlObj()
 void RoiCtrlObj::setRoi(const Roi& set_roi)
 {
   DEB_MEMBER_FUNCT();
-  if(set_roi.isActive())
+  DEB_PARAM() << DEB_VAR1(set_roi);
+
+  // Lima roi is done in software on top of the tracks
+  if(!m_tracks.empty())
+    {
+      _writeTracks();
+      return;
+    }
+  else if(m_kinetics_window)
     {
-      Bin bin;
-      m_bin.getBin(bin);
-      Point top_left = set_roi.getTopLeft();
-      Size size = set_roi.getSize();
-      top_left *= bin;
-      size *= bin;
-
-      //Set Bin and roi
-      PicamRois rois;
-      PicamRoi roi{top_left.x,size.getWidth(),bin.getX(),
-		   top_left.y,size.getHeight(),bin.getY()};
-      rois.roi_count = 1;
-      rois.roi_array = &roi;
-      CHECK_PICAM(Picam_SetParameterRoisValue(m_cam, PicamParameter_Rois, &rois));
-      m_roi = set_roi;
+      _writeKineticsWindow();
+      return;
     }
-  else				// full frame
-    m_roi = Roi(0,0,m_rows,m_columns);
+  else if(!m_spectrum_ranges.empty())
+    {
+      _writeSpectrumRows();
+      return;
+    }
+
+  Bin bin;
+  m_bin.getBin(bin);
+  Roi hw_roi;
+  m_solver.checkRoi(bin,set_roi,hw_roi);
+
+  //Set Bin and roi
+  PicamRoi roi = m_solver.toPicamRoi(bin,hw_roi);
+  PicamRois rois;
+  rois.roi_count = 1;
+  rois.roi_array = &roi;
+  _writeRois(rois);
+  m_roi = hw_roi;
 }
 
 void RoiCtrlObj::getRoi(Roi &hw_roi)
@@ -82,15 +94,224 @@ void RoiCtrlObj::getRoi(Roi &hw_roi)
 
 void RoiCtrlObj::checkRoi(const Roi& set_roi, Roi& hw_roi)
 {
-  if((m_rules &  PicamRoisConstraintRulesMask_HorizontalSymmetry) ||
-     (m_rules & PicamRoisConstraintRulesMask_VerticalSymmetry))
+  if(!m_tracks.empty() || m_kinetics_window || !m_spectrum_ranges.empty())
+    {
+      Size size;
+      m_det_info.getMaxImageSize(size);
+      hw_roi = Roi(Point(0,0),size);
+      return;
+    }
+
+  Bin bin;
+  m_bin.getBin(bin);
+  m_solver.checkRoi(bin,set_roi,hw_roi);
+}
+
+void RoiCtrlObj::setTracks(const std::vector<int>& tracks,
+			   bool full_vertical_binning)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(tracks.size(),full_vertical_binning);
+
+  if(tracks.size() % 2)
+    THROW_HW_ERROR(InvalidValue) << "Tracks must be (y,height) pairs";
+  if(!tracks.empty() && m_kinetics_window)
+    THROW_HW_ERROR(Error) << "Tracks can't be used in kinetics";
+  if(!tracks.empty() && !m_spectrum_ranges.empty())
+    THROW_HW_ERROR(Error) << "Tracks can't be used with host spectra";
+
+  int nb_tracks = int(tracks.size() / 2);
+  if(nb_tracks > m_solver.getMaxRoiCount())
+    THROW_HW_ERROR(InvalidValue) << "Camera only supports "
+				 << m_solver.getMaxRoiCount() << " rois";
+
+  // Sort tracks by y, PICam requires non-overlapping rois
+  std::vector<std::pair<int,int> > sorted;
+  for(int i = 0;i < nb_tracks;++i)
+    sorted.push_back(std::make_pair(tracks[2 * i],tracks[2 * i + 1]));
+  std::sort(sorted.begin(),sorted.end());
+
+  int height = m_solver.getSensorHeight();
+  int nb_rows = 0;
+  int previous_end = 0;
+  std::vector<int> checked_tracks;
+  for(auto track = sorted.begin();track != sorted.end();++track)
+    {
+      int y = track->first,track_height = track->second;
+      if(y < 0 || track_height <= 0 || y + track_height > height)
+	THROW_HW_ERROR(InvalidValue) << "Track " << DEB_VAR2(y,track_height)
+				     << " is out of the sensor";
+      if(y < previous_end)
+	THROW_HW_ERROR(InvalidValue) << "Track " << DEB_VAR2(y,track_height)
+				     << " overlaps the previous one";
+      if(full_vertical_binning && !m_solver.isYBinningAllowed(track_height))
+	THROW_HW_ERROR(InvalidValue) << "Sensor can't bin " << track_height
+				     << " rows in hardware";
+      previous_end = y + track_height;
+      nb_rows += full_vertical_binning ? 1 : track_height;
+      checked_tracks.push_back(y);
+      checked_tracks.push_back(track_height);
+    }
+
+  m_tracks = checked_tracks;
+  m_full_vertical_binning = full_vertical_binning;
+  m_bin.setTrackMode(!m_tracks.empty());
+  if(m_tracks.empty())
+    {
+      m_det_info.setReadoutImageSize(Size());
+      setRoi(Roi());
+    }
+  else
+    {
+      m_det_info.setReadoutImageSize(Size(m_solver.getSensorWidth(),nb_rows));
+      _writeTracks();
+    }
+}
+
+/** @brief PICam reads rois one after the other, all tracks have
+ *  the sensor width so the readout is directly a Lima image with
+ *  the tracks stacked (or one spectrum per row).
+ */
+void RoiCtrlObj::_writeTracks()
+{
+  DEB_MEMBER_FUNCT();
+  int width = m_solver.getSensorWidth();
+  std::vector<PicamRoi> roi_array;
+  for(size_t i = 0;i < m_tracks.size();i += 2)
+    {
+      int y = m_tracks[i],height = m_tracks[i + 1];
+      PicamRoi roi{0,width,1,
+		   y,height,m_full_vertical_binning ? height : 1};
+      roi_array.push_back(roi);
+    }
+  PicamRois rois;
+  rois.roi_count = piint(roi_array.size());
+  rois.roi_array = roi_array.data();
+  _writeRois(rois);
+
+  Size size;
+  m_det_info.getMaxImageSize(size);
+  m_roi = Roi(Point(0,0),size);
+}
+
+void RoiCtrlObj::setKineticsWindow(int window_height,bool spectra)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(window_height,spectra);
+
+  if(window_height && !m_tracks.empty())
+    THROW_HW_ERROR(Error) << "Kinetics can't be used with tracks";
+  if(window_height && !m_spectrum_ranges.empty())
+    THROW_HW_ERROR(Error) << "Kinetics can't be used with host spectra";
+
+  m_kinetics_window = window_height;
+  m_spectra_kinetics = spectra;
+  m_bin.setTrackMode(m_kinetics_window != 0);
+  if(!m_kinetics_window)
     {
-      // Not managed
-      hw_roi = Roi(0,0,m_rows,m_columns);
+      m_det_info.setReadoutImageSize(Size());
+      setRoi(Roi());
     }
   else
     {
-      // not limit ;)
-      hw_roi = set_roi;
+      m_det_info.setReadoutImageSize(Size(m_solver.getSensorWidth(),
+					  m_spectra_kinetics ? 1 : m_kinetics_window));
+      _writeKineticsWindow();
     }
 }
+
+/** @brief in kinetics the exposed rows are shifted under the mask
+ *  window after window, a frame is one window on the full width.
+ */
+void RoiCtrlObj::_writeKineticsWindow()
+{
+  DEB_MEMBER_FUNCT();
+  int height = m_kinetics_window;
+  PicamRoi roi{0,m_solver.getSensorWidth(),1,
+	       0,height,m_spectra_kinetics ? height : 1};
+  PicamRois rois;
+  rois.roi_count = 1;
+  rois.roi_array = &roi;
+  _writeRois(rois);
+
+  Size size;
+  m_det_info.getMaxImageSize(size);
+  m_roi = Roi(Point(0,0),size);
+}
+
+void RoiCtrlObj::setSpectrumRanges(const std::vector<int>& ranges)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(ranges.size());
+
+  if(ranges.size() % 2)
+    THROW_HW_ERROR(InvalidValue) << "Spectrum ranges must be (y,height) pairs";
+  if(!ranges.empty() && !m_tracks.empty())
+    THROW_HW_ERROR(Error) << "Host spectra can't be used with tracks";
+  if(!ranges.empty() && m_kinetics_window)
+    THROW_HW_ERROR(Error) << "Host spectra can't be used in kinetics";
+
+  int height = m_solver.getSensorHeight();
+  for(size_t i = 0;i < ranges.size();i += 2)
+    {
+      int y = ranges[i],range_height = ranges[i + 1];
+      if(y < 0 || range_height <= 0 || y + range_height > height)
+	THROW_HW_ERROR(InvalidValue) << "Spectrum range " << DEB_VAR2(y,range_height)
+				     << " is out of the sensor";
+    }
+
+  bool was_set = !m_spectrum_ranges.empty();
+  m_spectrum_ranges = ranges;
+  m_bin.setTrackMode(!m_spectrum_ranges.empty());
+  if(m_spectrum_ranges.empty())
+    {
+      if(was_set)
+	m_det_info.setReadoutImageType(Bpp16);
+      m_det_info.setReadoutImageSize(Size());
+      setRoi(Roi());
+    }
+  else
+    {
+      int nb_spectra = int(m_spectrum_ranges.size() / 2);
+      m_det_info.setReadoutImageType(Bpp32);
+      m_det_info.setReadoutImageSize(Size(m_solver.getSensorWidth(),nb_spectra));
+      _writeSpectrumRows();
+    }
+}
+
+void RoiCtrlObj::getSpectrumRows(int& y,int& height) const
+{
+  int first = m_solver.getSensorHeight(),last = 0;
+  for(size_t i = 0;i < m_spectrum_ranges.size();i += 2)
+    {
+      first = std::min(first,m_spectrum_ranges[i]);
+      last = std::max(last,m_spectrum_ranges[i] + m_spectrum_ranges[i + 1]);
+    }
+  y = first;
+  height = std::max(last - first,0);
+}
+
+void RoiCtrlObj::_writeSpectrumRows()
+{
+  DEB_MEMBER_FUNCT();
+  int y,height;
+  getSpectrumRows(y,height);
+  PicamRoi roi{0,m_solver.getSensorWidth(),1,y,height,1};
+  PicamRois rois;
+  rois.roi_count = 1;
+  rois.roi_array = &roi;
+  _writeRois(rois);
+
+  Size size;
+  m_det_info.getMaxImageSize(size);
+  m_roi = Roi(Point(0,0),size);
+}
+
+/** @brief the readout time follows the rois
+ */
+void RoiCtrlObj::_writeRois(const PicamRois& rois)
+{
+  DEB_MEMBER_FUNCT();
+  CHECK_PICAM(Picam_SetParameterRoisValue(m_cam, PicamParameter_Rois, &rois));
+  m_sync.readoutChanged();
+}
@@ -0,0 +1,192 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+
+#include "PrincetonRoiSolver.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+static int _increment(const PicamRangeConstraint& range)
+{
+  return std::max(int(range.increment),1);
+}
+
+static int _gcd(int a,int b)
+{
+  while(b) {int t = a % b;a = b;b = t;}
+  return a;
+}
+
+RoiSolver::RoiSolver(PicamHandle cam)
+{
+  DEB_CONSTRUCTOR();
+  const PicamRoisConstraint  *constraint;
+  CHECK_PICAM(Picam_GetParameterRoisConstraint(cam,
+					       PicamParameter_Rois,
+					       PicamConstraintCategory_Required,
+					       &constraint));
+  m_x.size = (int)constraint->width_constraint.maximum;
+  m_x.start = constraint->x_constraint;
+  m_x.length = constraint->width_constraint;
+  m_x.binning_limits.assign(constraint->x_binning_limits_array,
+			    constraint->x_binning_limits_array +
+			    constraint->x_binning_limits_count);
+  m_x.binning_alignment = constraint->rules & PicamRoisConstraintRulesMask_XBinningAlignment;
+  m_x.symmetry = constraint->rules & PicamRoisConstraintRulesMask_HorizontalSymmetry;
+
+  m_y.size = (int)constraint->height_constraint.maximum;
+  m_y.start = constraint->y_constraint;
+  m_y.length = constraint->height_constraint;
+  m_y.binning_limits.assign(constraint->y_binning_limits_array,
+			    constraint->y_binning_limits_array +
+			    constraint->y_binning_limits_count);
+  m_y.binning_alignment = constraint->rules & PicamRoisConstraintRulesMask_YBinningAlignment;
+  m_y.symmetry = constraint->rules & PicamRoisConstraintRulesMask_VerticalSymmetry;
+
+  m_max_roi_count = constraint->maximum_roi_count;
+  Picam_DestroyRoisConstraints(constraint);
+
+  DEB_TRACE() << DEB_VAR4(m_x.size,m_y.size,m_x.symmetry,m_y.symmetry);
+}
+
+void RoiSolver::checkBin(Bin& bin) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(bin);
+  bin = Bin(_checkBin(m_x,bin.getX()),_checkBin(m_y,bin.getY()));
+  DEB_RETURN() << DEB_VAR1(bin);
+}
+
+int RoiSolver::_checkBin(const Axis& axis,int request_bin)
+{
+  request_bin = std::max(std::min(request_bin,axis.size),1);
+  if(axis.binning_limits.empty())
+    return request_bin;
+
+  // Lima can only finish a binning which is a multiple of the hardware one
+  int bin = 1;
+  for(auto limit = axis.binning_limits.begin();
+      limit != axis.binning_limits.end();++limit)
+    if(*limit > bin && !(request_bin % *limit))
+      bin = *limit;
+  return bin;
+}
+
+bool RoiSolver::isYBinningAllowed(int y_bin) const
+{
+  if(y_bin < 1 || y_bin > m_y.size)
+    return false;
+  if(m_y.binning_limits.empty())
+    return true;
+  return std::find(m_y.binning_limits.begin(),m_y.binning_limits.end(),
+		   y_bin) != m_y.binning_limits.end();
+}
+
+void RoiSolver::checkRoi(const Bin& bin,const Roi& set_roi,Roi& hw_roi) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(bin,set_roi);
+
+  int x_start = 0,x_end = m_x.size;
+  int y_start = 0,y_end = m_y.size;
+  if(set_roi.isActive())
+    {
+      Point top_left = set_roi.getTopLeft();
+      Size size = set_roi.getSize();
+      x_start = top_left.x * bin.getX();
+      x_end = x_start + size.getWidth() * bin.getX();
+      y_start = top_left.y * bin.getY();
+      y_end = y_start + size.getHeight() * bin.getY();
+    }
+  _solveAxis(m_x,bin.getX(),x_start,x_end);
+  _solveAxis(m_y,bin.getY(),y_start,y_end);
+
+  hw_roi = Roi(x_start / bin.getX(),y_start / bin.getY(),
+	       (x_end - x_start) / bin.getX(),(y_end - y_start) / bin.getY());
+  DEB_RETURN() << DEB_VAR1(hw_roi);
+}
+
+PicamRoi RoiSolver::toPicamRoi(const Bin& bin,const Roi& hw_roi) const
+{
+  Point top_left = hw_roi.getTopLeft();
+  Size size = hw_roi.getSize();
+  PicamRoi roi{top_left.x * bin.getX(),size.getWidth() * bin.getX(),bin.getX(),
+	       top_left.y * bin.getY(),size.getHeight() * bin.getY(),bin.getY()};
+  return roi;
+}
+
+/** @brief grow [start,end[ (unbinned) to the smallest legal range.
+ *  Starts are tried from the requested one down to 0; for each start
+ *  the smallest legal length covering end is searched within one
+ *  period of the length increment and the binning.
+ */
+void RoiSolver::_solveAxis(const Axis& axis,int bin,int& start,int& end) const
+{
+  DEB_MEMBER_FUNCT();
+  int start_min = std::max(int(axis.start.minimum),0);
+  int start_inc = _increment(axis.start);
+  int length_min = std::max(int(axis.length.minimum),bin);
+  int length_max = std::min(int(axis.length.maximum),axis.size);
+  int length_inc = _increment(axis.length);
+  int length_period = length_inc / _gcd(length_inc,bin) * bin;
+
+  int request_start = std::max(std::min(start,axis.size - 1),0);
+  int request_end = std::max(std::min(end,axis.size),request_start + 1);
+
+  for(int s = request_start;s >= start_min;--s)
+    {
+      // start on a binning boundary, which also meets SymmetryBoundsBinning
+      if((s - start_min) % start_inc || s % bin)
+	continue;
+
+      if(axis.symmetry)
+	{
+	  int length = axis.size - 2 * s;
+	  if(length >= request_end - s && length >= length_min &&
+	     length <= length_max && !((length - int(axis.length.minimum)) % length_inc) &&
+	     !(length % bin))
+	    {
+	      start = s,end = s + length;
+	      return;
+	    }
+	  continue;
+	}
+
+      int length = std::max(request_end - s,length_min);
+      for(int l = length;l < length + length_period && s + l <= axis.size &&
+	    l <= length_max;++l)
+	{
+	  if(l % bin || (l - int(axis.length.minimum)) % length_inc)
+	    continue;
+	  start = s,end = s + l;
+	  return;
+	}
+    }
+
+  DEB_WARNING() << "No hardware roi found, use full sensor";
+  start = 0;
+  end = axis.size / bin * bin;
+}
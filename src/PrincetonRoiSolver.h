@@ -0,0 +1,81 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONROISOLVER_H
+#define PRINCETONROISOLVER_H
+
+#include <vector>
+
+#include <picam.h>
+
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Find the smallest hardware ROI/binning allowed by the
+     *	PicamRoisConstraint which covers a requested ROI/binning.
+     *	Lima does the remaining crop/binning in software.
+     */
+    class RoiSolver
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"RoiSolver","Princeton");
+    public:
+      RoiSolver(PicamHandle cam);
+
+      /// largest allowed binning which divides the requested one
+      void checkBin(Bin& bin) const;
+      /// roi are in binned coordinates, as given by Lima
+      void checkRoi(const Bin& bin,const Roi& set_roi,Roi& hw_roi) const;
+      /// PICam roi (unbinned sensor coordinates) of a checked hw_roi
+      PicamRoi toPicamRoi(const Bin& bin,const Roi& hw_roi) const;
+
+      bool isYBinningAllowed(int y_bin) const;
+
+      int getSensorWidth() const {return m_x.size;}
+      int getSensorHeight() const {return m_y.size;}
+      int getMaxRoiCount() const {return m_max_roi_count;}
+    private:
+      struct Axis
+      {
+	int			size;		// sensor size
+	PicamRangeConstraint	start;
+	PicamRangeConstraint	length;
+	std::vector<int>	binning_limits;
+	bool			binning_alignment;
+	bool			symmetry;
+      };
+
+      static int _checkBin(const Axis&,int request_bin);
+      void _solveAxis(const Axis&,int bin,int& start,int& end) const;
+
+      Axis	m_x;
+      Axis	m_y;
+      int	m_max_roi_count;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONROISOLVER_H
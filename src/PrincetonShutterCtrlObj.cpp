@@ -22,13 +22,15 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
 #include "PrincetonShutterCtrlObj.h"
+#include "PrincetonParameterCache.h"
 #include "PrincetonException.h"
 
 using namespace lima;
 using namespace lima::Princeton;
 
-ShutterCtrlObj::ShutterCtrlObj(PicamHandle cam):
-  m_cam(cam)
+ShutterCtrlObj::ShutterCtrlObj(PicamHandle cam,ParameterCache& parameters):
+  m_cam(cam),
+  m_parameters(parameters)
 {
 }
 
@@ -54,14 +56,14 @@ void ShutterCtrlObj::setMode(ShutterMode  shut_mode)
   switch(shut_mode)
     {
     case ShutterManual:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_ShutterTimingMode,
-						 PicamShutterTimingMode_AlwaysClosed));
+      m_parameters.setIntegerValue(PicamParameter_ShutterTimingMode,
+				   PicamShutterTimingMode_AlwaysClosed);
       break;
       
     default:
     case ShutterAutoFrame:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_ShutterTimingMode,
-						 PicamShutterTimingMode_Normal));
+      m_parameters.setIntegerValue(PicamParameter_ShutterTimingMode,
+				   PicamShutterTimingMode_Normal);
       break;
     }
 }
@@ -74,13 +76,13 @@ void ShutterCtrlObj::setState(bool  shut_open)
   
   if(shut_open)
     {
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_ShutterTimingMode,
-						 PicamShutterTimingMode_AlwaysOpen));
+      m_parameters.setIntegerValue(PicamParameter_ShutterTimingMode,
+				   PicamShutterTimingMode_AlwaysOpen);
     }
   else
     {
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_ShutterTimingMode,
-						 PicamShutterTimingMode_AlwaysClosed));
+      m_parameters.setIntegerValue(PicamParameter_ShutterTimingMode,
+				   PicamShutterTimingMode_AlwaysClosed);
     }
 }
 
@@ -88,10 +90,8 @@ void ShutterCtrlObj::getState(bool& shut_open) const
 {
   DEB_MEMBER_FUNCT();
   
-  piint shut_timing_mode;
-  CHECK_PICAM(Picam_GetParameterIntegerValue(m_cam,
-					     PicamParameter_ShutterTimingMode,
-					     &shut_timing_mode));
+  piint shut_timing_mode =
+    m_parameters.getIntegerValue(PicamParameter_ShutterTimingMode);
   shut_open = shut_timing_mode == PicamShutterTimingMode_AlwaysOpen ? true : false;
 }
 
@@ -99,29 +99,24 @@ void ShutterCtrlObj::setOpenTime(double shut_open_time)
 {
   DEB_MEMBER_FUNCT();
   
-  piflt shutter_delay_resolution;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_ShutterDelayResolution,
-						   &shutter_delay_resolution));
+  piflt shutter_delay_resolution =
+    m_parameters.getFloatingPointValue(PicamParameter_ShutterDelayResolution);
   shut_open_time *= 1e6 / shutter_delay_resolution;
-  CHECK_PICAM(Picam_SetParameterFloatingPointValue(m_cam,PicamParameter_ShutterOpeningDelay,
-						   shut_open_time));
+  m_parameters.setFloatingPointValue(PicamParameter_ShutterOpeningDelay,
+				     shut_open_time);
 }
 
 void ShutterCtrlObj::getOpenTime(double& shut_open_time) const
 {
   DEB_MEMBER_FUNCT();
   
-  piflt shutter_delay_resolution;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_ShutterDelayResolution,
-						   &shutter_delay_resolution));
+  piflt shutter_delay_resolution =
+    m_parameters.getFloatingPointValue(PicamParameter_ShutterDelayResolution);
   piflt raw_shutter_open_time;
   try
     {
-      CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						       PicamParameter_ShutterOpeningDelay,
-						       &raw_shutter_open_time));
+      raw_shutter_open_time =
+	m_parameters.getFloatingPointValue(PicamParameter_ShutterOpeningDelay);
     }
   catch(Exception)
     {
@@ -134,29 +129,24 @@ void ShutterCtrlObj::setCloseTime(double shut_close_time)
 {
   DEB_MEMBER_FUNCT();
   
-  piflt shutter_delay_resolution;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_ShutterDelayResolution,
-						   &shutter_delay_resolution));
+  piflt shutter_delay_resolution =
+    m_parameters.getFloatingPointValue(PicamParameter_ShutterDelayResolution);
   shut_close_time *= 1e6 / shutter_delay_resolution;
-  CHECK_PICAM(Picam_SetParameterFloatingPointValue(m_cam,PicamParameter_ShutterClosingDelay,
-						   shut_close_time));
+  m_parameters.setFloatingPointValue(PicamParameter_ShutterClosingDelay,
+				     shut_close_time);
 }
 
 void ShutterCtrlObj::getCloseTime(double& shut_close_time) const
 {
   DEB_MEMBER_FUNCT();
   
-  piflt shutter_delay_resolution;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_ShutterDelayResolution,
-						   &shutter_delay_resolution));
+  piflt shutter_delay_resolution =
+    m_parameters.getFloatingPointValue(PicamParameter_ShutterDelayResolution);
   piflt raw_shutter_close_time;
   try
     {
-      CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						       PicamParameter_ShutterOpeningDelay,
-						       &raw_shutter_close_time));
+      raw_shutter_close_time =
+	m_parameters.getFloatingPointValue(PicamParameter_ShutterClosingDelay);
     }
   catch(Exception)
     {
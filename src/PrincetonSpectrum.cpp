@@ -0,0 +1,70 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "lima/Exceptions.h"
+#include "PrincetonSpectrum.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+SpectrumExtractor::SpectrumExtractor() :
+  m_width(0),
+  m_kernels(getPixelKernels())
+{
+  DEB_CONSTRUCTOR();
+  DEB_TRACE() << "Spectrum kernel: " << m_kernels.name;
+}
+
+void SpectrumExtractor::setup(int width,const std::vector<int>& ranges)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(width,ranges.size());
+  if(width <= 0 || ranges.size() % 2)
+    THROW_HW_ERROR(InvalidValue) << "Invalid spectrum setup "
+				 << DEB_VAR2(width,ranges.size());
+  for(size_t i = 0;i < ranges.size();i += 2)
+    if(ranges[i] < 0 || ranges[i + 1] <= 0)
+      THROW_HW_ERROR(InvalidValue) << "Invalid spectrum range "
+				   << DEB_VAR2(ranges[i],ranges[i + 1]);
+  m_width = width;
+  m_ranges = ranges;
+}
+
+/** @brief rows are added one after the other, the spectrum row
+ *  being summed stays in cache.
+ */
+void SpectrumExtractor::process(void* dst,const void* src) const
+{
+  uint32_t* spectrum = (uint32_t*)dst;
+  const uint16_t* frame = (const uint16_t*)src;
+  for(size_t i = 0;i < m_ranges.size();i += 2,spectrum += m_width)
+    {
+      const uint16_t* row = frame + size_t(m_ranges[i]) * m_width;
+      m_kernels.widen_store(spectrum,row,m_width);
+      for(int y = 1;y < m_ranges[i + 1];++y)
+	{
+	  row += m_width;
+	  m_kernels.widen_add(spectrum,row,m_width);
+	}
+    }
+}
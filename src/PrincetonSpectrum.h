@@ -0,0 +1,60 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONSPECTRUM_H
+#define PRINCETONSPECTRUM_H
+
+#include <vector>
+
+#include "lima/Debug.h"
+#include "PrincetonFrameCopy.h"
+#include "PrincetonPixelKernels.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    /** Host full vertical binning: each row range of a 16 bits
+     *	readout frame is summed in one 32 bits spectrum, the spectra
+     *	are the rows of the Lima frame.
+     */
+    class SpectrumExtractor : public FrameProcessor
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"SpectrumExtractor","Princeton");
+    public:
+      SpectrumExtractor();
+
+      /// ranges are (y,height) pairs in the readout frame rows
+      void setup(int width,const std::vector<int>& ranges);
+      int getNbSpectra() const {return int(m_ranges.size() / 2);}
+
+      virtual void process(void* dst,const void* src) const;
+    private:
+      int		m_width;
+      std::vector<int>	m_ranges;
+      PixelKernels	m_kernels;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONSPECTRUM_H
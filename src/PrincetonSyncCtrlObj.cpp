@@ -20,15 +20,20 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
 
+#include <algorithm>
+#include <limits>
+
 #include "PrincetonSyncCtrlObj.h"
+#include "PrincetonParameterCache.h"
 #include "PrincetonException.h"
 
 using namespace lima;
 using namespace lima::Princeton;
 
 
-SyncCtrlObj::SyncCtrlObj(PicamHandle cam) :
-  m_cam(cam),m_trig_mode(IntTrig)
+SyncCtrlObj::SyncCtrlObj(PicamHandle cam,ParameterCache& parameters) :
+  m_cam(cam),m_parameters(parameters),m_trig_mode(IntTrig),
+  m_lat_time(0.),m_min_lat_time(0.),m_readout_mode(Interface::FullFrame)
 {
   DEB_CONSTRUCTOR();
   //Get trigger source capability
@@ -60,10 +65,59 @@ SyncCtrlObj::SyncCtrlObj(PicamHandle cam) :
 	}
     }
   CHECK_PICAM(Picam_DestroyCollectionConstraints(trigger_capability));
+
+  //Get readout control mode capability
+  pibln exists;
+  CHECK_PICAM(Picam_DoesParameterExist(m_cam,
+				       PicamParameter_ReadoutControlMode,
+				       &exists));
+  if(exists)
+    {
+      const PicamCollectionConstraint* readout_capability;
+      CHECK_PICAM(Picam_GetParameterCollectionConstraint(m_cam,
+							 PicamParameter_ReadoutControlMode,
+							 PicamConstraintCategory_Capable,
+							 &readout_capability));
+      for(int i = 0;i < readout_capability->values_count;++i)
+	{
+	  piint value = piint(readout_capability->values_array[i]);
+	  switch(value)
+	    {
+	    case PicamReadoutControlMode_FullFrame:
+	      m_readout_mode_capability.push_back(Interface::FullFrame);
+	      break;
+	    case PicamReadoutControlMode_FrameTransfer:
+	      m_readout_mode_capability.push_back(Interface::FrameTransfer);
+	      break;
+	    case PicamReadoutControlMode_Kinetics:
+	      m_readout_mode_capability.push_back(Interface::Kinetics);
+	      break;
+	    case PicamReadoutControlMode_SpectraKinetics:
+	      m_readout_mode_capability.push_back(Interface::SpectraKinetics);
+	      break;
+	    default:
+	      break;
+	    }
+	}
+      CHECK_PICAM(Picam_DestroyCollectionConstraints(readout_capability));
+
+      switch(m_parameters.getIntegerValue(PicamParameter_ReadoutControlMode))
+	{
+	case PicamReadoutControlMode_FrameTransfer:
+	  m_readout_mode = Interface::FrameTransfer;break;
+	case PicamReadoutControlMode_Kinetics:
+	  m_readout_mode = Interface::Kinetics;break;
+	case PicamReadoutControlMode_SpectraKinetics:
+	  m_readout_mode = Interface::SpectraKinetics;break;
+	default:
+	  m_readout_mode = Interface::FullFrame;break;
+	}
+    }
   // Initialization.
   setTrigMode(IntTrig);		
   setNbHwFrames(1);
   setExpTime(1);
+  m_min_lat_time = getMinLatTime();
 }
 
 SyncCtrlObj::~SyncCtrlObj()
@@ -99,38 +153,38 @@ void SyncCtrlObj::setTrigMode(TrigMode trig_mode)
     {
     case IntTrig:
     case IntTrigMult:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerResponse,
-						 PicamTriggerResponse_NoResponse));
+      m_parameters.setIntegerValue(PicamParameter_TriggerResponse,
+				   PicamTriggerResponse_NoResponse);
       break;
     case ExtGate:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerResponse,
-						 PicamTriggerResponse_ExposeDuringTriggerPulse));
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerDetermination,
-						 PicamTriggerDetermination_PositivePolarity));
+      m_parameters.setIntegerValue(PicamParameter_TriggerResponse,
+				   PicamTriggerResponse_ExposeDuringTriggerPulse);
+      m_parameters.setIntegerValue(PicamParameter_TriggerDetermination,
+				   PicamTriggerDetermination_PositivePolarity);
       break;
     case ExtStartStop:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerResponse,
-						 PicamTriggerResponse_ExposeDuringTriggerPulse));
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerDetermination,
-						 PicamTriggerDetermination_RisingEdge));
+      m_parameters.setIntegerValue(PicamParameter_TriggerResponse,
+				   PicamTriggerResponse_ExposeDuringTriggerPulse);
+      m_parameters.setIntegerValue(PicamParameter_TriggerDetermination,
+				   PicamTriggerDetermination_RisingEdge);
       break;
     case ExtTrigReadout:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerResponse,
-						 PicamTriggerResponse_ReadoutPerTrigger));
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerDetermination,
-						 PicamTriggerDetermination_RisingEdge));
+      m_parameters.setIntegerValue(PicamParameter_TriggerResponse,
+				   PicamTriggerResponse_ReadoutPerTrigger);
+      m_parameters.setIntegerValue(PicamParameter_TriggerDetermination,
+				   PicamTriggerDetermination_RisingEdge);
       break;
     case ExtTrigSingle:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerResponse,
-						 PicamTriggerResponse_StartOnSingleTrigger));
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerDetermination,
-						 PicamTriggerDetermination_RisingEdge));
+      m_parameters.setIntegerValue(PicamParameter_TriggerResponse,
+				   PicamTriggerResponse_StartOnSingleTrigger);
+      m_parameters.setIntegerValue(PicamParameter_TriggerDetermination,
+				   PicamTriggerDetermination_RisingEdge);
       break;
     case ExtTrigMult:
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerResponse,
-						 PicamTriggerResponse_GatePerTrigger));
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerDetermination,
-						 PicamTriggerDetermination_RisingEdge));
+      m_parameters.setIntegerValue(PicamParameter_TriggerResponse,
+				   PicamTriggerResponse_GatePerTrigger);
+      m_parameters.setIntegerValue(PicamParameter_TriggerDetermination,
+				   PicamTriggerDetermination_RisingEdge);
       break;
     default:
       THROW_HW_ERROR(Error) << "Trigger: " << trig_mode << " not managed!";
@@ -145,7 +199,7 @@ void SyncCtrlObj::setTrigMode(TrigMode trig_mode)
     {
       PicamTriggerSource source =  (trig_mode == IntTrig || trig_mode == IntTrigMult) ?
 	PicamTriggerSource_Internal : PicamTriggerSource_External;
-      CHECK_PICAM(Picam_SetParameterIntegerValue(m_cam,PicamParameter_TriggerSource,source));
+      m_parameters.setIntegerValue(PicamParameter_TriggerSource,source);
     }
   m_trig_mode = trig_mode;
 }
@@ -159,36 +213,96 @@ void SyncCtrlObj::setExpTime(double exp_time)
 {
   DEB_MEMBER_FUNCT();
   exp_time *= 1e3;		// ms
-  CHECK_PICAM(Picam_SetParameterFloatingPointValue(m_cam,
-						   PicamParameter_ExposureTime,
-						   exp_time));
+  m_parameters.setFloatingPointValue(PicamParameter_ExposureTime,exp_time);
+  // the exposure overlaps the readout in frame transfer
+  if(m_readout_mode == Interface::FrameTransfer)
+    readoutChanged();
 }
 
 void SyncCtrlObj::getExpTime(double &exp_time)
 {
   DEB_MEMBER_FUNCT();
-  piflt float_exp_time;
-  CHECK_PICAM(Picam_GetParameterFloatingPointValue(m_cam,
-						   PicamParameter_ExposureTime,
-						   &float_exp_time));
+  piflt float_exp_time =
+    m_parameters.getFloatingPointValue(PicamParameter_ExposureTime);
   exp_time = float_exp_time / 1e3;
 }
 
+/** @brief PICam has no latency setting, the latency is the
+ *  one of the readout mode. The request is just recorded, a longer
+ *  one is reported by the acquisition pre-flight check.
+ */
 void SyncCtrlObj::setLatTime(double lat_time)
 {
-  //Not managed
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(lat_time);
+  if(lat_time < 0.)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(lat_time);
+  m_lat_time = lat_time;
 }
 
 void SyncCtrlObj::getLatTime(double& lat_time)
 {
-  lat_time = 0;
+  lat_time = std::max(m_lat_time,getMinLatTime());
+}
+
+/** @brief time between the end of an exposure and the start of the
+ *  next one: the readout in full frame, only the part of the readout
+ *  which isn't overlapped by the exposure in frame transfer and the
+ *  readout shared by all the frames of a readout in kinetics.
+ */
+double SyncCtrlObj::getMinLatTime()
+{
+  DEB_MEMBER_FUNCT();
+  // calculations follow parameters not committed yet
+  m_parameters.invalidate(PicamParameter_ReadoutTimeCalculation);
+  m_parameters.invalidate(PicamParameter_FramesPerReadout);
+  double readout_time =
+    m_parameters.getFloatingPointValue(PicamParameter_ReadoutTimeCalculation) / 1e3;
+  double min_lat_time;
+  switch(m_readout_mode)
+    {
+    case Interface::FrameTransfer:
+      {
+	double exp_time;
+	getExpTime(exp_time);
+	min_lat_time = std::max(readout_time - exp_time,0.);
+      }
+      break;
+    case Interface::Kinetics:
+    case Interface::SpectraKinetics:
+      {
+	piint frames_per_readout =
+	  m_parameters.getIntegerValue(PicamParameter_FramesPerReadout);
+	min_lat_time = readout_time / std::max(frames_per_readout,1);
+      }
+      break;
+    default:
+      min_lat_time = readout_time;
+      break;
+    }
+  DEB_RETURN() << DEB_VAR1(min_lat_time);
+  return min_lat_time;
+}
+
+/** @brief Lima keeps the valid ranges it read, they are sent again
+ *  when the minimum latency moves.
+ */
+void SyncCtrlObj::readoutChanged()
+{
+  DEB_MEMBER_FUNCT();
+  double min_lat_time = getMinLatTime();
+  if(min_lat_time == m_min_lat_time)
+    return;
+  m_min_lat_time = min_lat_time;
+  ValidRangesType valid_ranges;
+  getValidRanges(valid_ranges);
+  validRangesChanged(valid_ranges);
 }
 
 void SyncCtrlObj::setNbHwFrames(int nb_frames)
 {
   DEB_MEMBER_FUNCT();
-  CHECK_PICAM(Picam_SetParameterLargeIntegerValue(m_cam,PicamParameter_ReadoutCount,
-						  nb_frames));
+  m_parameters.setLargeIntegerValue(PicamParameter_ReadoutCount,nb_frames);
   m_acq_nb_frames = nb_frames;
 }
 
@@ -210,7 +324,85 @@ void SyncCtrlObj::getValidRanges(ValidRangesType& valid_ranges)
   
   valid_ranges.min_exp_time = min_expo;
   valid_ranges.max_exp_time = max_expo;
-  valid_ranges.min_lat_time = 0.;
-  valid_ranges.max_lat_time = 0.;
+  valid_ranges.min_lat_time = getMinLatTime();
+  // a longer latency is accepted but not applied
+  valid_ranges.max_lat_time = std::numeric_limits<double>::max();
+}
+
+bool SyncCtrlObj::checkReadoutMode(Interface::ReadoutMode mode) const
+{
+  if(m_readout_mode_capability.empty())
+    return mode == Interface::FullFrame;
+  return std::find(m_readout_mode_capability.begin(),
+		   m_readout_mode_capability.end(),
+		   mode) != m_readout_mode_capability.end();
+}
+
+void SyncCtrlObj::setReadoutMode(Interface::ReadoutMode mode)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(mode);
+  if(!checkReadoutMode(mode))
+    THROW_HW_ERROR(NotSupported) << "Readout mode " << DEB_VAR1(mode)
+				 << " not supported by the camera";
+  if(mode == m_readout_mode)
+    return;
+
+  PicamReadoutControlMode picam_mode;
+  switch(mode)
+    {
+    case Interface::FrameTransfer:
+      picam_mode = PicamReadoutControlMode_FrameTransfer;break;
+    case Interface::Kinetics:
+      picam_mode = PicamReadoutControlMode_Kinetics;break;
+    case Interface::SpectraKinetics:
+      picam_mode = PicamReadoutControlMode_SpectraKinetics;break;
+    default:
+      picam_mode = PicamReadoutControlMode_FullFrame;break;
+    }
+  m_parameters.setIntegerValue(PicamParameter_ReadoutControlMode,picam_mode);
+  m_readout_mode = mode;
+  readoutChanged();
+}
+
+void SyncCtrlObj::getReadoutMode(Interface::ReadoutMode& mode) const
+{
+  mode = m_readout_mode;
+}
+
+void SyncCtrlObj::setKineticsWindowHeight(int height)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(height);
+  pibln exists;
+  CHECK_PICAM(Picam_DoesParameterExist(m_cam,
+				       PicamParameter_KineticsWindowHeight,
+				       &exists));
+  if(!exists)
+    THROW_HW_ERROR(NotSupported) << "Camera has no kinetics window";
+
+  const PicamRangeConstraint* constraint;
+  CHECK_PICAM(Picam_GetParameterRangeConstraint(m_cam,
+						PicamParameter_KineticsWindowHeight,
+						PicamConstraintCategory_Capable,
+						&constraint));
+  bool valid = height >= constraint->minimum && height <= constraint->maximum;
+  double minimum = constraint->minimum,maximum = constraint->maximum;
+  CHECK_PICAM(Picam_DestroyRangeConstraints(constraint));
+  if(!valid)
+    THROW_HW_ERROR(InvalidValue) << "Kinetics window " << DEB_VAR1(height)
+				 << " not in " << DEB_VAR2(minimum,maximum);
+  m_parameters.setIntegerValue(PicamParameter_KineticsWindowHeight,height);
+  readoutChanged();
+}
+
+void SyncCtrlObj::getKineticsWindowHeight(int& height)
+{
+  pibln exists;
+  CHECK_PICAM(Picam_DoesParameterExist(m_cam,
+				       PicamParameter_KineticsWindowHeight,
+				       &exists));
+  height = exists ?
+    m_parameters.getIntegerValue(PicamParameter_KineticsWindowHeight) : 0;
 }
 
@@ -0,0 +1,121 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include <sstream>
+
+#include "PrincetonTiming.h"
+#include "PrincetonParameterCache.h"
+#include "PrincetonException.h"
+
+using namespace lima;
+using namespace lima::Princeton;
+
+// relative tolerance on the requested frame period
+static const double PERIOD_TOLERANCE = 1e-3;
+
+TimingChecker::TimingChecker(ParameterCache& parameters) :
+  m_parameters(parameters)
+{
+}
+
+/** @brief calculations are read from PICam, they follow
+ *  parameters not committed yet
+ */
+void TimingChecker::predict(Timing& timing)
+{
+  DEB_MEMBER_FUNCT();
+  static const PicamParameter calculations[] =
+    {PicamParameter_ReadoutTimeCalculation,
+     PicamParameter_FrameRateCalculation,
+     PicamParameter_OnlineReadoutRateCalculation,
+     PicamParameter_FramesPerReadout,
+     PicamParameter_ReadoutStride};
+  for(auto parameter : calculations)
+    m_parameters.invalidate(parameter);
+
+  timing.frames_per_readout =
+    std::max(m_parameters.getIntegerValue(PicamParameter_FramesPerReadout),1);
+  timing.readout_stride = m_parameters.getIntegerValue(PicamParameter_ReadoutStride);
+  timing.readout_time =
+    m_parameters.getFloatingPointValue(PicamParameter_ReadoutTimeCalculation) /
+    1e3 / timing.frames_per_readout;
+  timing.frame_rate =
+    m_parameters.getFloatingPointValue(PicamParameter_FrameRateCalculation);
+  timing.readout_rate =
+    m_parameters.getFloatingPointValue(PicamParameter_OnlineReadoutRateCalculation);
+  timing.bandwidth = timing.readout_rate * timing.readout_stride;
+  DEB_RETURN() << DEB_VAR4(timing.readout_time,timing.frame_rate,
+			   timing.readout_rate,timing.bandwidth);
+}
+
+void TimingChecker::check(const Timing& timing,double exp_time,double lat_time,
+			  double min_lat_time,int nb_frames,
+			  long long buffer_readouts,double drain_rate,
+			  std::vector<std::string>& warnings)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR3(exp_time,lat_time,min_lat_time) << ", "
+	      << DEB_VAR3(nb_frames,buffer_readouts,drain_rate);
+  warnings.clear();
+
+  // PICam has no latency setting, frames come at the camera rate
+  if(lat_time > min_lat_time * (1. + PERIOD_TOLERANCE) + 1e-6)
+    {
+      std::ostringstream msg;
+      msg << "Latency " << lat_time << " s is not applied, "
+	  << "camera latency is " << min_lat_time << " s";
+      warnings.push_back(msg.str());
+    }
+
+  // the camera can't go faster than its frame rate
+  double period = exp_time + lat_time;
+  if(period > 0. && timing.frame_rate > 0. &&
+     1. / timing.frame_rate > period * (1. + PERIOD_TOLERANCE))
+    {
+      std::ostringstream msg;
+      msg << "Frame period " << period << " s can't be sustained, "
+	  << "camera frame rate is " << timing.frame_rate << " frames/s";
+      warnings.push_back(msg.str());
+    }
+
+  // a host slower than the camera fills the buffer until an overrun
+  if(drain_rate > 0. && timing.readout_rate > drain_rate && buffer_readouts > 0)
+    {
+      double fill_time = buffer_readouts / (timing.readout_rate - drain_rate);
+      double nb_readouts = double(nb_frames) / timing.frames_per_readout;
+      double acq_time = nb_readouts / timing.readout_rate;
+      if(!nb_frames || acq_time > fill_time)
+	{
+	  std::ostringstream msg;
+	  msg << "Buffer overrun expected after " << fill_time << " s: "
+	      << "camera readout rate " << timing.readout_rate
+	      << " readouts/s, host " << drain_rate << " readouts/s ("
+	      << timing.bandwidth / 1e6 << " MB/s requested)";
+	  warnings.push_back(msg.str());
+	}
+    }
+
+  for(auto i = warnings.begin();i != warnings.end();++i)
+    DEB_WARNING() << *i;
+}
@@ -0,0 +1,78 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2020
+// European Synchrotron Radiation Facility
+// CS40220 38043 Grenoble Cedex 9 
+// FRANCE
+//
+// Contact: lima@esrf.fr
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef PRINCETONTIMING_H
+#define PRINCETONTIMING_H
+
+#include <string>
+#include <vector>
+
+#include <picam.h>
+
+#include "lima/Debug.h"
+
+namespace lima
+{
+  namespace Princeton
+  {
+    class ParameterCache;
+
+    /** Readout timing calculated by PICam for the current
+     *	(possibly not committed) parameters.
+     */
+    struct Timing
+    {
+      double	readout_time;	// per frame, s
+      double	frame_rate;	// frames/s
+      double	readout_rate;	// readouts/s
+      double	bandwidth;	// bytes/s to the host
+      int	frames_per_readout;
+      long long	readout_stride;
+    };
+
+    /** Pre-flight check of an acquisition against the camera timing
+     *	and the host consumer speed measured on the previous acquisition.
+     */
+    class TimingChecker
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"TimingChecker","Princeton");
+    public:
+      TimingChecker(ParameterCache&);
+
+      void predict(Timing&);
+      /** exp_time + lat_time is the requested frame period (0 if
+       *	externally triggered), min_lat_time the latency the camera
+       *	applies, nb_frames 0 is a continuous acquisition,
+       *	drain_rate is the host readouts/s (0 if unknown).
+       */
+      void check(const Timing&,double exp_time,double lat_time,
+		 double min_lat_time,int nb_frames,
+		 long long buffer_readouts,double drain_rate,
+		 std::vector<std::string>& warnings);
+    private:
+      ParameterCache&	m_parameters;
+    };
+  } // namespace Princeton
+} // namespace lima
+
+#endif // PRINCETONTIMING_H
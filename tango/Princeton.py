@@ -58,6 +58,26 @@ class Princeton(PyTango.Device_4Impl):
 
         self.__Attribute2FunctionBase = {
         }
+        self.__TrackLayout = {'STACKED': PrincetonAcq.Interface.StackedTracks,
+                              'SPECTRUM_PER_TRACK': PrincetonAcq.Interface.SpectrumPerTrack}
+        self.__ReadoutMode = {'FULL_FRAME': PrincetonAcq.Interface.FullFrame,
+                              'FRAME_TRANSFER': PrincetonAcq.Interface.FrameTransfer,
+                              'KINETICS': PrincetonAcq.Interface.Kinetics,
+                              'SPECTRA_KINETICS': PrincetonAcq.Interface.SpectraKinetics}
+        self.__AdcQuality = {'LOW_NOISE': PrincetonAcq.Interface.LowNoise,
+                             'HIGH_CAPACITY': PrincetonAcq.Interface.HighCapacity,
+                             'HIGH_SPEED': PrincetonAcq.Interface.HighSpeed,
+                             'ELECTRON_MULTIPLIED': PrincetonAcq.Interface.ElectronMultiplied}
+        self.__AdcAnalogGain = {'LOW': PrincetonAcq.Interface.LowGain,
+                                'MEDIUM': PrincetonAcq.Interface.MediumGain,
+                                'HIGH': PrincetonAcq.Interface.HighGain}
+        self.__DataLossPolicy = {'FAULT': PrincetonAcq.Interface.FaultOnDataLoss,
+                                 'RENUMBER': PrincetonAcq.Interface.RenumberFrames,
+                                 'GAP_FRAMES': PrincetonAcq.Interface.InsertGapFrames}
+        self.__LatencyStage = {'DELIVERY': PrincetonAcq.Interface.DeliveryLatency,
+                               'COPY': PrincetonAcq.Interface.CopyLatency,
+                               'NOTIFY': PrincetonAcq.Interface.NotifyLatency,
+                               'TOTAL': PrincetonAcq.Interface.TotalLatency}
         
         self.init_device()
 
@@ -85,11 +105,90 @@ class Princeton(PyTango.Device_4Impl):
     def getAttrStringValueList(self, attr_name):
         #use AttrHelper
         return AttrHelper.get_attr_string_value_list(self, attr_name)
+#------------------------------------------------------------------
+#    checkAcquisition command:
+#
+#    Description: pre-flight check of the acquisition
+#    argout: DevVarStringArray, the warnings
+#------------------------------------------------------------------
+    @Core.DEB_MEMBER_FUNCT
+    def checkAcquisition(self):
+        _PrincetonInterface.checkAcquisition()
+        return _PrincetonInterface.getPreflightWarnings()
+#------------------------------------------------------------------
+#    captureDark command:
+#
+#    Description: dark frame of the correction, mean of frames taken
+#                 with the shutter closed
+#    argin: DevLong, number of frames
+#------------------------------------------------------------------
+    @Core.DEB_MEMBER_FUNCT
+    def captureDark(self, nb_frames):
+        _PrincetonInterface.captureDark(nb_frames)
+
+#------------------------------------------------------------------
+#    resetLatencyStats command:
+#
+#    Description: clear the acquisition path latency histograms
+#------------------------------------------------------------------
+    @Core.DEB_MEMBER_FUNCT
+    def resetLatencyStats(self):
+        _PrincetonInterface.resetLatencyStats()
+#------------------------------------------------------------------
+#    getLatencyHistogram command:
+#
+#    Description: non empty buckets of a latency histogram
+#    argin: DevString, DELIVERY, COPY, NOTIFY or TOTAL
+#    argout: DevVarDoubleArray, bucket upper bound (s) and count pairs
+#------------------------------------------------------------------
+    @Core.DEB_MEMBER_FUNCT
+    def getLatencyHistogram(self, stage):
+        upper_bounds,counts = _PrincetonInterface.getLatencyHistogram(self.__LatencyStage[stage.upper()])
+        histogram = []
+        for upper_bound,count in zip(upper_bounds,counts):
+            histogram += [upper_bound,count]
+        return histogram
+
 #==================================================================
 #
 #    Princeton read/write attribute methods
 #
 #==================================================================
+    def __read_latency(self,attr,stage) :
+        attr.set_value(list(_PrincetonInterface.getLatencyStats(stage)))
+
+    def read_delivery_latency(self,attr) :
+        self.__read_latency(attr,PrincetonAcq.Interface.DeliveryLatency)
+
+    def read_copy_latency(self,attr) :
+        self.__read_latency(attr,PrincetonAcq.Interface.CopyLatency)
+
+    def read_notify_latency(self,attr) :
+        self.__read_latency(attr,PrincetonAcq.Interface.NotifyLatency)
+
+    def read_total_latency(self,attr) :
+        self.__read_latency(attr,PrincetonAcq.Interface.TotalLatency)
+
+    def read_callback_latency_mean(self,attr) :
+        count,mean,p50,p99,max = _PrincetonInterface.getLatencyStats(PrincetonAcq.Interface.TotalLatency)
+        attr.set_value(mean)
+
+    def read_callback_latency_p99(self,attr) :
+        count,mean,p50,p99,max = _PrincetonInterface.getLatencyStats(PrincetonAcq.Interface.TotalLatency)
+        attr.set_value(p99)
+
+    def read_predicted_readout_time(self,attr) :
+        readout_time,frame_rate,bandwidth = _PrincetonInterface.getPredictedTiming()
+        attr.set_value(readout_time)
+
+    def read_predicted_frame_rate(self,attr) :
+        readout_time,frame_rate,bandwidth = _PrincetonInterface.getPredictedTiming()
+        attr.set_value(frame_rate)
+
+    def read_predicted_bandwidth(self,attr) :
+        readout_time,frame_rate,bandwidth = _PrincetonInterface.getPredictedTiming()
+        attr.set_value(bandwidth)
+
     def __getattr__(self,name) :
         #use AttrHelper
         return AttrHelper.get_attr_4u(self,name,_PrincetonInterface)
@@ -114,9 +213,169 @@ class PrincetonClass(PyTango.DeviceClass):
         'getAttrStringValueList':
         [[PyTango.DevString, "Attribute name"],
          [PyTango.DevVarStringArray, "Authorized String value list"]],
+        'checkAcquisition':
+        [[PyTango.DevVoid, ""],
+         [PyTango.DevVarStringArray, "Pre-flight warnings"]],
+        'captureDark':
+        [[PyTango.DevLong, "Number of frames"],
+         [PyTango.DevVoid, ""]],
+        'resetLatencyStats':
+        [[PyTango.DevVoid, ""],
+         [PyTango.DevVoid, ""]],
+        'getLatencyHistogram':
+        [[PyTango.DevString, "DELIVERY, COPY, NOTIFY or TOTAL"],
+         [PyTango.DevVarDoubleArray, "Bucket upper bound (s) and count pairs"]],
         }
 
     attr_list = {
+        'tracks':
+        [[PyTango.DevLong,
+          PyTango.SPECTRUM,
+          PyTango.READ_WRITE, 16]],
+        'track_layout':
+        [[PyTango.DevString,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'spectrum_ranges':
+        [[PyTango.DevLong,
+          PyTango.SPECTRUM,
+          PyTango.READ_WRITE, 16]],
+        'accumulation':
+        [[PyTango.DevLong,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'accumulation_saturation':
+        [[PyTango.DevLong,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'correction':
+        [[PyTango.DevBoolean,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'bad_pixels':
+        [[PyTango.DevLong,
+          PyTango.SPECTRUM,
+          PyTango.READ_WRITE, 65536]],
+        'readout_mode':
+        [[PyTango.DevString,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'kinetics_window_height':
+        [[PyTango.DevLong,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'adc_speed':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'adc_quality':
+        [[PyTango.DevString,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'adc_analog_gain':
+        [[PyTango.DevString,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'readout_port_count':
+        [[PyTango.DevLong,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'predicted_readout_time':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'predicted_frame_rate':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'predicted_bandwidth':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'preflight_warnings':
+        [[PyTango.DevString,
+          PyTango.SPECTRUM,
+          PyTango.READ, 16]],
+        'data_loss_policy':
+        [[PyTango.DevString,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'nb_lost_frames':
+        [[PyTango.DevLong64,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'parameter_cache_hits':
+        [[PyTango.DevLong64,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'parameter_cache_misses':
+        [[PyTango.DevLong64,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'nb_data_loss_events':
+        [[PyTango.DevLong,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'delivery_latency':
+        [[PyTango.DevDouble,
+          PyTango.SPECTRUM,
+          PyTango.READ, 5]],
+        'copy_latency':
+        [[PyTango.DevDouble,
+          PyTango.SPECTRUM,
+          PyTango.READ, 5]],
+        'notify_latency':
+        [[PyTango.DevDouble,
+          PyTango.SPECTRUM,
+          PyTango.READ, 5]],
+        'total_latency':
+        [[PyTango.DevDouble,
+          PyTango.SPECTRUM,
+          PyTango.READ, 5]],
+        'nb_acquired_frames':
+        [[PyTango.DevLong64,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'buffer_occupancy':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'buffer_peak_occupancy':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'buffer_overruns':
+        [[PyTango.DevLong64,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'achieved_frame_rate':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'acq_readout_time':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'callback_latency_mean':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'callback_latency_p99':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'sensor_temperature':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
+        'stop_timeout':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ_WRITE]],
+        'last_stop_time':
+        [[PyTango.DevDouble,
+          PyTango.SCALAR,
+          PyTango.READ]],
     }
 
     def __init__(self,name) :